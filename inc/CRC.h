@@ -17,10 +17,14 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
+void CRCInit(void);
 void CRCReset(uint16_t in_checksum_start);
 uint16_t CRCGet(void);
 uint16_t CRCAddByte(uint8_t in_data);
 uint16_t CRCAddBlock(uint8_t* in_buffer, int in_buffer_length);
+uint16_t CRCUpdateByte(uint16_t in_crc, uint8_t in_data);
+uint16_t CRCUpdateBlock(uint16_t in_crc, const uint8_t* in_buffer, int in_buffer_length);
+bool CRCSelfTest(void);
 
 
 #endif
\ No newline at end of file
@@ -18,12 +18,41 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Constants
 #define DDS_TABLE_LENGTH 256
+#define DDS_MAX_BIT_SAMPLE_COUNT 256				// max. length of one bit waveform (samples)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Sine table interpolation method
+typedef enum
+{
+	DDSI_None,
+	DDSI_Linear,
+	DDSI_Polynomial
+} DDSInterpolationType;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
 void InitDDS(void);
+bool SetDDSFormat(uint32_t in_sample_rate, uint8_t in_bits_per_sample, DDSInterpolationType in_interpolation);
 bool GenerateDDSSignal(uint32_t in_frequency, uint32_t in_cycle_count);
 bool GenerateDDSSilence(uint16_t in_length_in_ms);
+bool InitDDSBitCache(uint32_t in_zero_frequency, uint32_t in_one_frequency);
+void FreeDDSBitCache(void);
+bool GenerateDDSByte(uint8_t in_data);
+
+uint32_t GetDDSAccumulator(void);
+void SetDDSAccumulator(uint32_t in_accumulator);
+size_t GetDDSSampleSize(void);
+uint32_t GetDDSSampleRate(void);
+uint32_t GetDDSIncrement(uint32_t in_frequency);
+uint32_t GetDDSSignalLength(uint32_t* inout_accumulator, uint32_t in_increment, uint32_t in_cycle_count);
+uint32_t GetDDSByteLength(uint32_t* inout_accumulator, uint8_t in_data);
+uint32_t GetDDSSilenceLength(uint16_t in_length_in_ms);
+size_t RenderDDSSignal(uint32_t* inout_accumulator, uint32_t in_increment, uint32_t* inout_cycle_count, uint8_t* out_samples, size_t in_max_sample_count);
+size_t RenderDDSByte(uint32_t* inout_accumulator, uint8_t in_data, uint8_t* out_samples);
+void RenderDDSSilence(uint8_t* out_samples, size_t in_sample_count);
+bool WriteDDSSamples(const uint8_t* in_samples, size_t in_sample_count);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Polyphase decimator (low pass filter and sample rate reduction)           */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __Decimator_h
+#define __Decimator_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "Types.h"
+#include "Main.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define DM_MAX_FACTOR 4
+#define DM_TAPS_PER_PHASE 12																// number of filter taps used for one output sample per input phase
+#define DM_MAX_TAP_COUNT (DM_MAX_FACTOR * DM_TAPS_PER_PHASE)
+#define DM_COEFFICIENT_SHIFT 15
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Decimator instance
+typedef struct
+{
+	int Factor;																					// 1 - no decimation
+	int TapCount;
+	int32_t Coefficients[DM_MAX_TAP_COUNT];							// low pass filter coefficients (Q15)
+	int32_t History[DM_MAX_TAP_COUNT - 1 + WAVE_SAMPLE_BLOCK_LENGTH];	// history followed by the current block
+	int SkipCount;																			// number of input samples before the next output sample
+} DMDecimatorType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool DMInit(DMDecimatorType* out_decimator, int in_factor);
+size_t DMProcessSamples(DMDecimatorType* in_decimator, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+size_t DMGetLatency(const DMDecimatorType* in_decimator);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Real FFT (radix-2) for fast convolution                                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __FFT_h
+#define __FFT_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define FFT_MIN_LENGTH 4
+#define FFT_MAX_LENGTH 8192		// maximum length of the real transform (power of two)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	double Re;
+	double Im;
+} FFTComplexType;
+
+// Transform tables and work buffer for one transform length
+typedef struct
+{
+	int Length;																			// length of the real transform (N)
+	int ComplexLength;															// length of the complex transform used internally (N/2)
+	FFTComplexType Twiddle[FFT_MAX_LENGTH / 2];			// exp(-pi*i*k/h) for every butterfly size (h), stored from index h-1
+	FFTComplexType RealTwiddle[FFT_MAX_LENGTH / 2];	// exp(-2*pi*i*k/N) for splitting the real spectrum
+	uint16_t BitReverse[FFT_MAX_LENGTH / 2];
+	FFTComplexType Buffer[FFT_MAX_LENGTH / 2];
+} FFTType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool FFTInit(FFTType* out_fft, int in_length);
+void FFTForwardReal(FFTType* in_fft, const double* in_samples, FFTComplexType* out_spectrum);
+void FFTInverseReal(FFTType* in_fft, const FFTComplexType* in_spectrum, double* out_samples);
+
+#endif
@@ -0,0 +1,82 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Digital filter designer (IIR and FIR band pass filters)                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __FilterDesign_h
+#define __FilterDesign_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define FD_MAX_IIR_ORDER 8													// maximum order of the low pass prototype (number of second order sections)
+#define FD_MAX_FIR_TAP_COUNT 2048
+#define FD_CHEBYSHEV_RIPPLE 1.0											// pass band ripple of the Chebyshev filters (dB)
+#define FD_KAISER_ATTENUATION 60.0									// stop band attenuation of the Kaiser window (dB)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef enum
+{
+	FDM_Butterworth,
+	FDM_Chebyshev
+} FDIIRModelType;
+
+typedef enum
+{
+	FDW_Blackman,
+	FDW_Kaiser
+} FDWindowType;
+
+// Second order section: (B0 + B1*z^-1 + B2*z^-2) / (1 + A1*z^-1 + A2*z^-2)
+typedef struct
+{
+	double B0;
+	double B1;
+	double B2;
+	double A1;
+	double A2;
+} FDSectionType;
+
+// IIR band pass filter design
+typedef struct
+{
+	FDIIRModelType Model;
+	uint32_t SampleRate;
+	uint16_t LowCutoffFrequency;
+	uint16_t HighCutoffFrequency;
+	uint8_t Order;																		// order of the low pass prototype
+
+	FDSectionType Sections[FD_MAX_IIR_ORDER];					// cascade of Order sections (gain is distributed evenly)
+} FDIIRDesignType;
+
+// FIR band pass filter design
+typedef struct
+{
+	FDWindowType Window;
+	uint32_t SampleRate;
+	uint16_t LowCutoffFrequency;
+	uint16_t HighCutoffFrequency;
+	uint16_t TapCount;
+
+	double Coefficients[FD_MAX_FIR_TAP_COUNT];
+
+	// coefficients quantized to 16 bit: y = sum(QuantizedCoefficients[n]*x[n]) >> QuantizedDCGainShift
+	int16_t QuantizedCoefficients[FD_MAX_FIR_TAP_COUNT];
+	int QuantizedDCGainShift;
+} FDFIRDesignType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+const FDIIRDesignType* FDDesignIIRBandPass(FDIIRModelType in_model, uint32_t in_sample_rate, uint16_t in_low_cutoff_frequency, uint16_t in_high_cutoff_frequency, uint8_t in_order);
+const FDFIRDesignType* FDDesignFIRBandPass(FDWindowType in_window, uint32_t in_sample_rate, uint16_t in_low_cutoff_frequency, uint16_t in_high_cutoff_frequency, uint16_t in_tap_count);
+
+#endif
@@ -0,0 +1,77 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* IIR filter engine (cascade of second order sections)                      */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __IIRFilter_h
+#define __IIRFilter_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+#include "FilterDesign.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define IIR_MAX_SECTION_COUNT FD_MAX_IIR_ORDER
+#define IIR_COEFFICIENT_SHIFT 28				// fixed point coefficients are Q28 numbers
+#define IIR_STATE_FRACTION_BITS 8				// fractional bits of the fixed point signal between the sections
+#define IIR_BLOCK_LENGTH 256						// number of samples processed by one section at once
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef enum
+{
+	IIRA_FixedPoint,
+	IIRA_FloatingPoint
+} IIRArithmeticType;
+
+// Fixed point section (direct form I)
+typedef struct
+{
+	int32_t B0;
+	int32_t B1;
+	int32_t B2;
+	int32_t A1;
+	int32_t A2;
+
+	int64_t X1;
+	int64_t X2;
+	int64_t Y1;
+	int64_t Y2;
+} IIRFixedPointSectionType;
+
+// Floating point section (transposed direct form II)
+typedef struct
+{
+	double B0;
+	double B1;
+	double B2;
+	double A1;
+	double A2;
+
+	double Z1;
+	double Z2;
+} IIRFloatingPointSectionType;
+
+// Filter instance (coefficients and state)
+typedef struct
+{
+	IIRArithmeticType Arithmetic;
+	int SectionCount;
+	IIRFixedPointSectionType FixedPointSections[IIR_MAX_SECTION_COUNT];
+	IIRFloatingPointSectionType FloatingPointSections[IIR_MAX_SECTION_COUNT];
+} IIRFilterType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool IIRInit(IIRFilterType* out_filter, const FDSectionType* in_sections, int in_section_count, IIRArithmeticType in_arithmetic);
+void IIRReset(IIRFilterType* in_filter);
+void IIRProcessSamples(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+
+#endif
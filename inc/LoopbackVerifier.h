@@ -0,0 +1,32 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Loopback verifier (decodes the rendered tape signal on a worker thread)   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __LoopbackVerifier_h
+#define __LoopbackVerifier_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "Types.h"
+#include "Main.h"
+#include "WaveFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define LV_BLOCK_SAMPLE_COUNT 8192			// number of samples in one queued block
+#define LV_QUEUE_LENGTH 32							// number of blocks waiting for the decoder (~6s of signal)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+bool LVStart(FilterTypes in_filter_type, uint32_t in_sample_rate, uint8_t in_bits_per_sample, bool in_one_bit);
+void LVFeedSamples(const uint8_t* in_samples, size_t in_sample_count);
+bool LVStop(const char* in_file_name, bool in_header_block, const uint8_t* in_data, int in_data_length);
+
+#endif
\ No newline at end of file
@@ -28,6 +28,7 @@
 #define WAVEOUT_BUFFER_COUNT 4
 #define WAVEIN_BUFFER_LENGTH 8192
 #define WAVEIN_BUFFER_COUNT 16
+#define WAVE_SAMPLE_BLOCK_LENGTH 1024
 #define MAX_BINARY_DIVIDE_POSITION 16
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -54,7 +55,7 @@
 // Global variables
 extern wchar_t g_wave_output_file[MAX_PATH_LENGTH];
 
-extern wchar_t g_input_file_name_name[MAX_PATH_LENGTH];
+extern wchar_t g_input_file_name[MAX_PATH_LENGTH];
 extern FileTypes g_input_file_type;
 extern wchar_t g_output_file_name[MAX_PATH_LENGTH];
 extern FileTypes g_output_file_type;
@@ -68,6 +69,9 @@ extern bool g_overwrite_output_file;
 extern bool g_exclude_basic_program;
 extern uint16_t g_lomem_address;
 extern bool g_one_bit_wave_file;
+extern uint32_t g_wave_sample_rate;
+extern uint8_t g_wave_bits_per_sample;
+extern int g_wave_interpolation;
 extern int g_rom_loader_type;
 extern bool g_append_container_files;
 
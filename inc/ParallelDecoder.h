@@ -0,0 +1,53 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Parallel decoder (decodes segments of the wav file on multiple threads)   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __ParallelDecoder_h
+#define __ParallelDecoder_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+#include "Main.h"
+#include "WaveFilter.h"
+#include "TapeDecoder.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define PD_SCAN_WINDOW_LENGTH (SAMPLE_RATE / 100)			// length of the energy measurement window (10ms)
+#define PD_SCAN_JOB_WINDOW_COUNT 6000									// number of windows measured by one scan job (1 minute)
+#define PD_MIN_GAP_WINDOW_COUNT 15										// minimum length of the silent gap in windows (150ms)
+#define PD_SIGNAL_LEVEL_PERCENTILE 95									// percentile of the window levels used as signal level
+#define PD_SILENCE_LEVEL_DIVISOR 8										// windows below signal level/divisor are silent (-18dB)
+#define PD_SEGMENTS_PER_THREAD 4											// number of segments per thread (for load balancing)
+#define PD_MIN_SEGMENT_LENGTH (SAMPLE_RATE * 10)			// minimum segment length in samples
+#define PD_CHANNEL_MATCH_DISTANCE (SAMPLE_RATE / 2)		// maximum distance of the same block decoded from different channels
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Decoded program
+typedef struct
+{
+	LoadStatus Status;						// LS_Success or LS_Error
+	bool SignalLost;							// signal was lost while loading (program is partial when status is LS_Success)
+	uint32_t SamplePosition;			// sample position where the decoding of the program was finished
+	uint32_t BlockPosition;				// sample position where the loading of the last block of the program was started
+	int Channel;									// decoded channel (1 based, WF_MIXED_CHANNELS - average of the channels)
+	bool FileNameReceived;				// file name was loaded by the segment decoder (otherwise it's taken from the previous segment)
+	bool AutostartReceived;				// autostart flag was loaded by the segment decoder
+	TDProgramType Program;
+} PDResultType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+PDResultType* PDDecode(FilterTypes in_filter_type, int in_thread_count, int* out_result_count, uint32_t* out_skipped_sample_count);
+PDResultType* PDDecodeChannels(FilterTypes in_filter_type, int* out_result_count, uint32_t* out_skipped_sample_count);
+
+#endif
@@ -75,6 +75,14 @@ typedef struct
 } TAPESectorEndType;
 
 #pragma pack(pop)
+
+// Length of the tape signal
+typedef struct
+{
+	uint32_t SampleCount;
+	uint32_t SampleRate;
+	uint32_t Duration;				// in ms
+} TAPEEstimateType;
 					 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
@@ -82,10 +90,13 @@ bool TAPEOpenInput(wchar_t* in_file_name);
 bool TAPECreateOutput(wchar_t* in_file_name);
 
 bool TAPESave(wchar_t* in_file_name);
+bool TAPEEstimate(TAPEEstimateType* out_estimate);
 LoadStatus TAPELoad(void);
+LoadStatus TAPECatalog(void);
 
 void TAPECloseOutput(void);
 void TAPECloseInput(void);
+void TAPEProgramSaved(wchar_t* in_file_name);
 
 void TAPEInitBlockHeader(TAPEBlockHeaderType* out_block_header);
 bool TAPEValidateBlockHeader(TAPEBlockHeaderType* in_block_header);
@@ -95,5 +106,11 @@ bool TAPEValidateBlockHeader(TAPEBlockHeaderType* in_block_header);
 extern uint16_t g_frequency_offset;
 extern uint16_t g_leading_length;
 extern uint16_t g_gap_length;
+extern bool g_verify_output;
+extern bool g_catalog_mode;
+extern int g_indexed_program;
+extern bool g_resume_decoding;
+extern int g_thread_count;
+extern bool g_channel_decoding;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Decoder checkpoint file (resumes interrupted wav file decoding)           */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __TapeCheckpoint_h
+#define __TapeCheckpoint_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+#include "TapeDecoder.h"
+#include "WaveFile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TC_FILE_EXTENSION L"tck"
+#define TC_FILE_ID 0x4b435654					// 'TVCK'
+#define TC_FILE_VERSION 3
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+#pragma pack(push, 1)
+
+// Checkpoint file header (followed by the raw decoder state, the inverted reader state and the saved programs)
+typedef struct
+{
+	uint32_t FileID;
+	uint16_t Version;
+	WFInputIDType Input;							// identification of the decoded wav file (the checkpoint is invalid when it differs)
+	uint32_t SampleIndex;							// decoding continues from this input sample position (the decoder state includes every sample before)
+	uint16_t SavedProgramCount;
+	uint32_t DecoderStateSize;				// size of the decoder state (the checkpoint is invalid when the decoder struct differs)
+	uint32_t ReaderStateSize;					// size of the inverted reader state (zero when the dual polarity reading is disabled)
+} TCCheckpointType;
+
+// Program saved before the checkpoint
+typedef struct
+{
+	uint32_t Position;								// input sample position where the program was loaded
+	wchar_t FileName[MAX_PATH_LENGTH];	// output file name
+} TCSavedProgramType;
+
+#pragma pack(pop)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+TCSavedProgramType* TCLoad(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, TCCheckpointType* out_checkpoint, TapeDecoderType* out_decoder_state, TDReaderStateType* out_inverted_reader_state);
+bool TCSave(wchar_t* in_wav_file_name, TCCheckpointType* inout_checkpoint, const TapeDecoderType* in_decoder, const TCSavedProgramType* in_programs);
+void TCDelete(wchar_t* in_wav_file_name);
+void TCGetFileName(wchar_t* out_checkpoint_file_name, wchar_t* in_wav_file_name);
+
+#endif
\ No newline at end of file
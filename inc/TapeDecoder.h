@@ -0,0 +1,179 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape signal decoder (FSK demodulator and tape block reader)               */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __TapeDecoder_h
+#define __TapeDecoder_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+#include "Main.h"
+#include "TAPEFile.h"
+#include "CASFile.h"
+#include "DataBuffer.h"
+#include "WaveFilter.h"
+#include "WaveLevelControl.h"
+#include "Decimator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TD_MIDDLE_PERIOD_BUFFER_LENGTH 256
+#define TD_GATE_MIN_LEVEL 128							// blocks below this average level are silent (-48dB)
+#define TD_GATE_MIN_FREQUENCY 700					// blocks with lower average crossing frequency can't contain tape signal (Hz)
+#define TD_GATE_MAX_FREQUENCY 5000				// blocks with higher average crossing frequency are noise (Hz)
+#define TD_PRIMED_LEADING_PERIOD_COUNT 32		// leading periods needed before the sync when the middle period is preloaded
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Current state of the decoder
+typedef  enum
+{
+	DST_Idle,
+	DST_Primed,
+	DST_WaitingForLeading,
+	DST_WaitingForSync,
+	DST_SyncDetected,
+	DST_ReadingData,
+	DST_SectorEnd
+}	DecoderStateType;
+
+// Current state of the tape reader
+typedef enum
+{
+	TRST_Idle,
+	TRST_BlockHeader,
+	TRST_SectorHeader,
+	TRST_HeaderFileNameLength,
+	TRST_HeaderFileName,
+	TRST_HeaderProgramHeader,
+	TRST_SectorEnd,
+	TRST_Data
+} TapeReaderStatusType;
+
+// Signal phase type
+typedef enum
+{
+	SPT_High,
+	SPT_Low
+} SignalPhaseType;
+
+// Zero crossing (half period end) of the processed signal
+typedef struct
+{
+	uint16_t SamplePos;						// index of the first sample behind the crossing
+	uint16_t OversampledLength;		// distance of the crossing from the previous sample (1/OVERSAMPLING_RATE input sample units)
+} TDZeroCrossingType;
+
+// Decoded program
+typedef struct
+{
+	uint8_t Buffer[DB_MAX_DATA_LENGTH];
+	uint16_t BufferLength;
+	uint16_t BufferIndex;
+	char FileName[DB_MAX_FILENAME_LENGTH+1];
+	bool Autostart;
+	bool CRCErrorDetected;
+} TDProgramType;
+
+// Demodulator and tape reader state (the decoder keeps a second instance to read the other polarity)
+typedef struct
+{
+	// demodulator
+	DecoderStateType DecoderState;
+	SignalPhaseType CurrentPhase;
+	SignalPhaseType PhaseMode;
+	int PeriodHighLength;
+	int PeriodLowLength;
+	int SyncFirstHalfPeriodLength;
+	int SyncSecondHalfPeriodLength;
+	int MiddlePeriodBuffer[TD_MIDDLE_PERIOD_BUFFER_LENGTH];	// buffer used for middle frequency (period) avg. calculation
+	uint32_t MiddlePeriodBufferIndex;
+	uint16_t MiddlePeriod;
+	uint32_t MiddlePeriodSum;
+	uint8_t DataByte;
+	uint8_t BitCounter;
+	uint16_t SectorEndPeriodCount;
+	uint8_t PrimedCrossingCount;												// crossings skipped after seeking (their periods are incomplete)
+	WaveLevelControlModeType LevelControlMode;					// level control mode requested by the demodulator
+
+	// tape reader
+	TapeReaderStatusType ReaderStatus;
+	uint32_t DataByteIndex;
+	TAPEBlockHeaderType BlockHeader;
+	TAPESectorHeaderType SectorHeader;
+	uint8_t FileNameLength;
+	CASProgramFileHeaderType ProgramHeader;
+	TAPESectorEndType SectorEnd;
+	uint16_t CurrentSectorLength;
+	uint16_t CRC;
+	bool HeaderBlockValid;
+	bool FileNameReceived;															// program file name was loaded from the tape by this instance
+	bool AutostartReceived;															// autostart flag was loaded from the tape by this instance
+	bool HeaderOnly;																		// catalog mode: blocks are reported after their header, data blocks are skipped
+	uint32_t SkipSampleCount;														// input samples to be skipped by the caller (header only mode)
+	uint16_t ValidSectorCount;														// sectors of the current block loaded with valid CRC
+
+	TDProgramType Program;
+} TDReaderStateType;
+
+// Decoder instance (one instance per decoded signal, all members except the inverted reader are stored by value)
+typedef struct
+{
+	// signal processing
+	WFFilterType Filter;
+	DMDecimatorType Decimator;
+	WLCContextType LevelControl;
+	int SampleLength;																		// length of one processed sample (1/OVERSAMPLING_RATE input sample units)
+	int32_t ProcessedBlock[WAVE_SAMPLE_BLOCK_LENGTH];		// filtered, decimated and level controlled samples
+	size_t ProcessedBlockLength;
+	size_t ProcessedBlockPos;														// number of decoded samples of the processed block
+	size_t FlushSampleCount;														// silence to be pushed through the filter at the end of the input
+	TDZeroCrossingType Crossings[WAVE_SAMPLE_BLOCK_LENGTH];	// zero crossings of the processed block
+	size_t CrossingCount;
+	size_t CrossingIndex;																// next crossing to decode
+	int32_t PreviousSample;															// last sample of the processed block
+
+	// signal gate
+	bool GateEnabled;																		// skip input blocks without tape signal while no block is loaded
+	int32_t GateWarmUpBlock[WAVE_SAMPLE_BLOCK_LENGTH];	// last skipped block (warms up the filter before the next signal)
+	size_t GateWarmUpLength;
+	uint32_t SkippedSampleCount;												// number of input samples skipped by the gate
+
+	// dual polarity reading
+	TDReaderStateType* InvertedReader;									// reads the block with the other phase mode (NULL when disabled)
+	bool InvertedReaderActive;													// inverted reader is started at the sync of the current block
+
+	// demodulator, tape reader and the loaded program
+	TDReaderStateType Reader;
+} TapeDecoderType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+TapeDecoderType* TDCreate(FilterTypes in_filter_type, int in_decimation_factor);
+void TDDestroy(TapeDecoderType* in_decoder);
+size_t TDFeedSamples(TapeDecoderType* in_decoder, const int32_t* in_samples, size_t in_sample_count);
+size_t TDFlush(TapeDecoderType* in_decoder);
+void TDWarmUp(TapeDecoderType* in_decoder, const int32_t* in_samples, size_t in_sample_count);
+void TDSeek(TapeDecoderType* in_decoder, uint16_t in_middle_period);
+size_t TDGetLatency(TapeDecoderType* in_decoder);
+LoadStatus TDPoll(TapeDecoderType* in_decoder);
+size_t TDFindZeroCrossings(SignalPhaseType* inout_phase, int32_t* inout_previous_sample, const int32_t* in_samples, size_t in_sample_count, int in_sample_length, TDZeroCrossingType* out_crossings);
+void TDResetProgram(TapeDecoderType* in_decoder);
+bool TDKeepPartialProgram(TapeDecoderType* in_decoder);
+bool TDSetState(TapeDecoderType* in_decoder, const TapeDecoderType* in_state, const TDReaderStateType* in_inverted_reader);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables
+extern uint8_t g_decimation_factor;
+extern bool g_signal_gate;
+extern bool g_dual_polarity;
+
+#endif
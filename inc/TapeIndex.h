@@ -0,0 +1,64 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape index file (block positions of a wav file for random access)         */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __TapeIndex_h
+#define __TapeIndex_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include "Types.h"
+#include "TAPEFile.h"
+#include "CASFile.h"
+#include "DataBuffer.h"
+#include "WaveFile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TI_FILE_EXTENSION L"tix"
+#define TI_FILE_ID 0x58495654					// 'TVIX'
+#define TI_FILE_VERSION 2
+#define TI_MAX_BLOCK_COUNT 65535
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+#pragma pack(push, 1)
+
+// Index file header
+typedef struct
+{
+	uint32_t FileID;
+	uint16_t Version;
+	WFInputIDType Input;							// identification of the indexed wav file (the index is invalid when it differs)
+	uint16_t BlockCount;
+} TIFileHeaderType;
+
+// Indexed tape block
+typedef struct
+{
+	uint32_t LeadingPosition;					// input sample position of the block leading
+	uint32_t SyncPosition;						// input sample position shortly before the sync
+	uint16_t MiddlePeriod;						// middle period measured by the decoder (1/OVERSAMPLING_RATE input sample units)
+	TAPEBlockHeaderType BlockHeader;
+	uint8_t HeaderValid;							// header block: CRC of the block is correct
+	char FileName[DB_MAX_FILENAME_LENGTH+1];	// header block: file name of the program
+	CASProgramFileHeaderType ProgramHeader;		// header block: program header
+} TIBlockType;
+
+#pragma pack(pop)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+TIBlockType* TILoad(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, int* out_block_count);
+bool TISave(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, const TIBlockType* in_blocks, int in_block_count);
+bool TIFindProgram(const TIBlockType* in_blocks, int in_block_count, int in_program, int* out_header_block, int* out_data_block);
+void TIGetFileName(wchar_t* out_index_file_name, wchar_t* in_wav_file_name);
+
+#endif
\ No newline at end of file
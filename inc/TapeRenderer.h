@@ -0,0 +1,67 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape renderer (renders a planned tape signal on multiple threads)         */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __TapeRenderer_h
+#define __TapeRenderer_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "Types.h"
+#include "Main.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TR_JOB_SAMPLE_COUNT (SAMPLE_RATE * 5)		// approximate number of samples rendered by one job
+#define TR_JOBS_PER_THREAD 2										// number of jobs rendered at once per thread (limits memory usage)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Tape signal element class
+typedef enum
+{
+	TREC_Silence,
+	TREC_Signal,
+	TREC_Data
+} TRElementClassType;
+
+// Tape signal element
+typedef struct
+{
+	TRElementClassType Class;
+	uint32_t Frequency;						// frequency of the signal
+	uint32_t Length;							// number of samples (silence), periods (signal) or bytes (data)
+	size_t DataIndex;							// first byte of the data in the data buffer of the plan
+} TRElementType;
+
+// Tape signal plan (the whole signal of one saved program)
+typedef struct
+{
+	TRElementType* Elements;
+	int ElementCount;
+	int ElementCapacity;
+	uint8_t* Data;
+	size_t DataLength;
+	size_t DataCapacity;
+	bool OutOfMemory;
+} TRPlanType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+TRPlanType* TRCreatePlan(void);
+void TRDestroyPlan(TRPlanType* in_plan);
+void TRAddSilence(TRPlanType* in_plan, uint16_t in_length_in_ms);
+void TRAddSignal(TRPlanType* in_plan, uint32_t in_frequency, uint32_t in_cycle_count);
+void TRAddData(TRPlanType* in_plan, const uint8_t* in_data, int in_length);
+uint32_t TRGetSampleCount(const TRPlanType* in_plan);
+bool TRRender(TRPlanType* in_plan, int in_thread_count);
+
+#endif
\ No newline at end of file
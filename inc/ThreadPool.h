@@ -0,0 +1,34 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Worker threads for running independent jobs in parallel                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+#ifndef __ThreadPool_h
+#define __ThreadPool_h
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stddef.h>
+#include "Types.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TP_MAX_THREAD_COUNT 64		// maximum number of worker threads (limited by WaitForMultipleObjects)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Job function (called once for every job, from any of the worker threads)
+typedef void (*TPJobFunctionType)(void* in_job);
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+int TPGetProcessorCount(void);
+void TPRunJobs(TPJobFunctionType in_function, void* in_jobs, size_t in_job_size, int in_job_count, int in_thread_count);
+
+#endif
@@ -20,10 +20,12 @@
 // Function prototypes
 bool WDOpenInput(wchar_t* in_file_name);
 bool WDReadSample(int32_t* out_sample);
+size_t WDReadSamples(int32_t* out_samples, size_t in_sample_count);
 void WDCloseInput(void);
 
 bool WDOpenOutput(wchar_t* in_file_name);
 bool WDWriteSample(uint8_t in_sample);
+bool WDWriteSamples(const uint8_t* in_samples, size_t in_sample_count);
 void WDCloseOutput(bool in_force_close);
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -22,6 +22,8 @@
 #define RIFF_HEADER_FORMAT_ID 0x45564157 /* 'WAVE' */
 #define CHUNK_ID_FORMAT 0x20746d66 /* 'fmt ' */
 #define CHUNK_ID_DATA 0x61746164 /* 'data' */
+#define WF_MAX_CHANNEL_COUNT 16
+#define WF_MIXED_CHANNELS 0		// channel index of the average of all channels (channels are 1 based)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Wave file structs
@@ -50,22 +52,42 @@ typedef struct
 	uint16_t	BitsPerSample;
 } FormatChunkType;
 
+// Identification of the input file (index and checkpoint files are valid only for the same recording)
+typedef struct
+{
+	uint32_t SampleCount;
+	uint32_t DataLength;			// length of the data chunk (limited to the file size)
+	FormatChunkType Format;
+} WFInputIDType;
+
 #pragma pack(pop)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
 extern uint32_t g_input_wav_file_sample_count;
 extern uint32_t g_input_wav_file_sample_index;
+extern uint32_t g_input_wav_start_sample;
+extern uint32_t g_input_wav_end_sample;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Functions prototypes
 bool WFOpenInput(wchar_t* in_file_name);
 bool WFReadSample(int32_t* out_sample);
+size_t WFReadSamples(int32_t* out_samples, size_t in_sample_count);
+size_t WFReadSamplesAt(uint32_t in_sample_index, int in_channel, int32_t* out_samples, size_t in_sample_count);
+bool WFSeekInput(uint32_t in_sample_index);
+bool WFIsInputMapped(void);
+int WFGetInputChannelCount(void);
+void WFGetInputID(WFInputIDType* out_id);
 void WFCloseInput(void);
 
-bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample);
-bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample);
+bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample, uint32_t in_sample_rate);
+bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample, uint32_t in_sample_rate);
+bool WFReserveOutput(uint32_t in_sample_count);
 void WFWriteSample(int32_t in_sample);
+void WFWriteSamples(const int32_t* in_samples, size_t in_sample_count);
+void WFWriteByteSamples(const uint8_t* in_samples, size_t in_sample_count);
+void WFWriteWordSamples(const int16_t* in_samples, size_t in_sample_count);
 void WFCloseOutput(bool in_force_close);
 
 #endif
\ No newline at end of file
@@ -14,6 +14,17 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include <Types.h>
+#include "FFT.h"
+#include "IIRFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define WF_SHARP_FILTER_MIN_TAP_COUNT 256
+#define WF_SHARP_FILTER_MAX_TAP_COUNT 2048
+#define WF_SHARP_FILTER_DEFAULT_TAP_COUNT 1024
+#define WF_FIR_BLOCK_LENGTH 256									// number of samples processed by one FIR kernel call
+#define WF_STRONG_FILTER_TAP_COUNT 64
+#define WF_FAST_FILTER_REFERENCE_ORDER 4
 
 ///////////////////////////////////////////////////////////////////////////////
 // Types
@@ -22,12 +33,57 @@ typedef enum
 	FT_NoFilter,
 	FT_Fast,
 	FT_Strong,
+	FT_Sharp,
 	FT_Auto
 } FilterTypes;
 
+typedef enum
+{
+	FIRK_Unknown,
+	FIRK_Scalar,
+	FIRK_SSE2,
+	FIRK_AVX2
+} FIRKernelType;
+
+// Filter instance (coefficients and state of the selected filter)
+typedef struct
+{
+	FilterTypes Type;
+
+	// fast (IIR) filter
+	IIRFilterType FastFilter;
+	int32_t FastFilterReferenceX[WF_FAST_FILTER_REFERENCE_ORDER + 1];
+	int64_t FastFilterReferenceY[WF_FAST_FILTER_REFERENCE_ORDER + 1];
+
+	// strong (block FIR) filter
+	FIRKernelType FIRKernel;
+	int16_t StrongFilterReversedCoefficients[WF_STRONG_FILTER_TAP_COUNT];
+	int StrongFilterDCGainShift;
+	int32_t StrongFilterHistory[WF_STRONG_FILTER_TAP_COUNT - 1 + WF_FIR_BLOCK_LENGTH];	// history followed by the current block
+	int16_t StrongFilterHistory16[WF_STRONG_FILTER_TAP_COUNT - 1 + WF_FIR_BLOCK_LENGTH];
+	int32_t StrongFilterReferenceHistory[WF_STRONG_FILTER_TAP_COUNT];
+
+	// sharp (FFT overlap-save) filter
+	int SharpFilterTapCount;
+	int SharpFilterHopLength;																	// number of new samples processed by one FFT frame
+	int SharpFilterFramePos;																	// number of new samples in the current frame
+	FFTType SharpFilterFFT;
+	FFTComplexType SharpFilterResponse[FFT_MAX_LENGTH / 2 + 1];
+	FFTComplexType SharpFilterSpectrum[FFT_MAX_LENGTH / 2 + 1];
+	double SharpFilterFrame[FFT_MAX_LENGTH];									// history followed by the new samples
+	double SharpFilterResult[FFT_MAX_LENGTH];
+	int32_t SharpFilterOutput[FFT_MAX_LENGTH];								// output of the previous frame
+} WFFilterType;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-int32_t WFProcessSample(int32_t in_new_sample);
+void WFInit(WFFilterType* out_filter, FilterTypes in_type);
+void WFProcessSamples(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+size_t WFGetLatency(const WFFilterType* in_filter);
+bool WFBenchmark(void);
 extern FilterTypes g_filter_type;
+extern uint16_t g_sharp_filter_tap_count;
+extern uint16_t g_filter_low_cutoff_frequency;
+extern uint16_t g_filter_high_cutoff_frequency;
 
 #endif
\ No newline at end of file
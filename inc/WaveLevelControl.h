@@ -15,6 +15,11 @@
 // Includes
 #include <Types.h>
 
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define WLC_MAX_LOOK_AHEAD_LENGTH 256
+#define WLC_DEFAULT_LOOK_AHEAD_LENGTH 64
+
 ///////////////////////////////////////////////////////////////////////////////
 // Types
 typedef enum
@@ -23,12 +28,36 @@ typedef enum
 	WLCMT_LevelControl
 } WaveLevelControlModeType;
 
+typedef enum 
+{
+	WLCST_Unknown,
+	WLCST_Rising,
+	WLCST_Falling,
+	WLCST_Constant
+} WLCSlopeType;
+
+// Level control state (one instance per processed signal)
+typedef struct
+{
+	int LookAheadLength;																		// number of samples the output is delayed by
+	int32_t LookAheadBuffer[WLC_MAX_LOOK_AHEAD_LENGTH];
+	int32_t LookAheadBufferABS[WLC_MAX_LOOK_AHEAD_LENGTH];	// absolute value of the look ahead samples
+	int32_t Envelope[WLC_MAX_LOOK_AHEAD_LENGTH];
+	int LookAheadBufferIndex;
+	int LastPeakIndex;
+	WLCSlopeType PrevSlope;
+	int32_t PrevSample;
+	int32_t PeakThreshold;
+	WaveLevelControlModeType Mode;
+	int32_t NoiseKillerSilenceLength;
+} WLCContextType;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-void WLCInit(void);
-int32_t WLCProcessSample(int32_t in_sample);
-void WLCClose(void);
-void WLCSetMode(WaveLevelControlModeType in_mode);
+void WLCInit(WLCContextType* in_context, int in_look_ahead_length);
+void WLCProcessSamples(WLCContextType* in_context, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+void WLCClose(WLCContextType* in_context);
+void WLCSetMode(WLCContextType* in_context, WaveLevelControlModeType in_mode);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
@@ -23,10 +23,15 @@
 // Function prototypes
 bool WMOpenInput(wchar_t* in_file_name);
 bool WMReadSample(int32_t* out_sample);
+size_t WMReadSamples(int32_t* out_samples, size_t in_sample_count);
+bool WMSeekInput(uint32_t in_sample_index);
 void WMCloseInput(void);
 
 bool WMOpenOutput(wchar_t* in_file_name);
+bool WMReserveOutput(uint32_t in_sample_count);
 bool WMWriteSample(uint8_t in_sample);
+bool WMWriteSamples(const uint8_t* in_samples, size_t in_sample_count);
+bool WMWriteWordSamples(const int16_t* in_samples, size_t in_sample_count);
 void WMCloseOutput(bool in_force_close);
 
 #endif
\ No newline at end of file
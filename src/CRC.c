@@ -11,15 +11,65 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
+#include <stdlib.h>
+#include <Windows.h>
 #include <CRC.h>
+#include <Console.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define CRC_SLICE_COUNT 8										// number of tables for the slice-by-8 block update
+#define SELF_TEST_DATA_LENGTH (1024 * 1024)
+#define SELF_TEST_BLOCK_COUNT 10000
 
 ///////////////////////////////////////////////////////////////////////////////
 // Module global variables
 static uint16_t l_crc;
+static uint16_t l_crc_table[256];									// CRC of the (bit reversed) CRC high byte
+static uint16_t l_crc_slice_table[CRC_SLICE_COUNT][256];		// bit reversed tables, [n] = byte followed by n zero bytes
+static uint8_t l_bit_reverse_table[256];
 
 ///////////////////////////////////////////////////////////////////////////////
 // Local functions
-static uint16_t CRCAddBit(bool in_bit);
+static uint16_t CRCAddBit(uint16_t in_crc, bool in_bit);
+static uint16_t ReferenceUpdateByte(uint16_t in_crc, uint8_t in_data);
+static uint16_t ReverseBits16(uint16_t in_value);
+static uint16_t ReferenceUpdateBlock(uint16_t in_crc, const uint8_t* in_buffer, int in_buffer_length);
+static double MeasureThroughput(uint16_t (*in_function)(uint16_t, const uint8_t*, int), const uint8_t* in_buffer, uint16_t* out_crc);
+
+///////////////////////////////////////////////////////////////////////////////
+// Builds CRC tables (must be called before using any other CRC function)
+void CRCInit(void)
+{
+	int i;
+	int bit;
+	int slice;
+
+	for(i = 0; i < 256; i++)
+	{
+		l_bit_reverse_table[i] = 0;
+		for(bit = 0; bit < 8; bit++)
+		{
+			if((i & (1 << bit)) != 0)
+				l_bit_reverse_table[i] |= 0x80 >> bit;
+		}
+	}
+
+	// the Z80 routine shifts the data bits (LSB first) into the MSB of the CRC, so one byte update is
+	// (crc << 8) ^ table[HIGH(crc) ^ reverse(data)], where the table comes from the original bitwise routine
+	for(i = 0; i < 256; i++)
+		l_crc_table[i] = ReferenceUpdateByte((uint16_t)(i << 8), 0);
+
+	// bit reversed CRC is updated by shifting to the right, no data bit reversing is needed for the slice-by-N method
+	for(i = 0; i < 256; i++)
+		l_crc_slice_table[0][i] = ReverseBits16(l_crc_table[l_bit_reverse_table[i]]);
+
+	for(slice = 1; slice < CRC_SLICE_COUNT; slice++)
+	{
+		for(i = 0; i < 256; i++)
+			l_crc_slice_table[slice][i] = (l_crc_slice_table[slice - 1][i] >> 8) ^ l_crc_slice_table[0][l_crc_slice_table[slice - 1][i] & 0xff];
+	}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // Initializes CRC value
@@ -39,42 +89,180 @@ uint16_t CRCGet(void)
 // Calculates CRC
 uint16_t CRCAddByte(uint8_t in_data)
 {
-	int i;
+	l_crc = CRCUpdateByte(l_crc, in_data);
 
-	for( i = 0; i < 8; i++)
+	return l_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds buffer content to the CRC
+uint16_t CRCAddBlock(uint8_t* in_buffer, int in_buffer_length)
+{
+	l_crc = CRCUpdateBlock(l_crc, in_buffer, in_buffer_length);
+
+	return l_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates CRC of one byte starting from the given CRC value (doesn't use the module CRC)
+uint16_t CRCUpdateByte(uint16_t in_crc, uint8_t in_data)
+{
+	return (uint16_t)(in_crc << 8) ^ l_crc_table[HIGH(in_crc) ^ l_bit_reverse_table[in_data]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates CRC of a buffer starting from the given CRC value (doesn't use the module CRC)
+uint16_t CRCUpdateBlock(uint16_t in_crc, const uint8_t* in_buffer, int in_buffer_length)
+{
+	uint16_t crc;
+
+	// short blocks are processed byte by byte
+	if(in_buffer_length < 4)
 	{
-		if( (in_data & 0x01) == 0 )
-		{
-			CRCAddBit(false);
-		}
-		else
+		while(in_buffer_length > 0)
 		{
-			CRCAddBit(true);
+			in_crc = CRCUpdateByte(in_crc, *in_buffer);
+			in_buffer++;
+			in_buffer_length--;
 		}
 
-		in_data >>= 1;
+		return in_crc;
 	}
 
-	return l_crc;
+	crc = ReverseBits16(in_crc);
+
+	// slice-by-8
+	while(in_buffer_length >= 8)
+	{
+		crc = l_crc_slice_table[7][(uint8_t)(crc ^ in_buffer[0])] ^ l_crc_slice_table[6][(uint8_t)((crc >> 8) ^ in_buffer[1])] ^
+					l_crc_slice_table[5][in_buffer[2]] ^ l_crc_slice_table[4][in_buffer[3]] ^
+					l_crc_slice_table[3][in_buffer[4]] ^ l_crc_slice_table[2][in_buffer[5]] ^
+					l_crc_slice_table[1][in_buffer[6]] ^ l_crc_slice_table[0][in_buffer[7]];
+
+		in_buffer += 8;
+		in_buffer_length -= 8;
+	}
+
+	// slice-by-4
+	if(in_buffer_length >= 4)
+	{
+		crc = l_crc_slice_table[3][(uint8_t)(crc ^ in_buffer[0])] ^ l_crc_slice_table[2][(uint8_t)((crc >> 8) ^ in_buffer[1])] ^
+					l_crc_slice_table[1][in_buffer[2]] ^ l_crc_slice_table[0][in_buffer[3]];
+
+		in_buffer += 4;
+		in_buffer_length -= 4;
+	}
+
+	// remaining bytes
+	while(in_buffer_length > 0)
+	{
+		crc = (crc >> 8) ^ l_crc_slice_table[0][(uint8_t)(crc ^ *in_buffer)];
+		in_buffer++;
+		in_buffer_length--;
+	}
+
+	return ReverseBits16(crc);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Adds buffer content to the CRC
-uint16_t CRCAddBlock(uint8_t* in_buffer, int in_buffer_length)
+// Compares the table driven CRC routines to the original bitwise Z80 routine (every CRC and byte value, and blocks
+// of random data with random length, alignment and start value) and measures their speed. Returns true on success.
+bool CRCSelfTest(void)
 {
-	while(in_buffer_length > 0 )
+	uint8_t* data;
+	uint32_t random;
+	uint32_t crc;
+	uint32_t value;
+	uint16_t reference_crc;
+	uint16_t table_crc;
+	uint16_t start_crc;
+	int offset;
+	int length;
+	int split;
+	int i;
+	double reference_throughput;
+	double table_throughput;
+	bool success = true;
+
+	data = (uint8_t*)malloc(SELF_TEST_DATA_LENGTH);
+	if(data == NULL)
+		return false;
+
+	// pseudo random test data
+	random = 1;
+	for(i = 0; i < SELF_TEST_DATA_LENGTH; i++)
 	{
-		CRCAddByte(*in_buffer);
-		in_buffer++;
-		in_buffer_length--;
+		random = random * 1103515245 + 12345;
+		data[i] = (uint8_t)(random >> 16);
 	}
 
-	return l_crc;
+	DisplayMessage(L"CRC self test\n");
+
+	// every CRC value with every data byte
+	for(crc = 0; crc < 0x10000 && success; crc++)
+	{
+		for(value = 0; value < 256; value++)
+		{
+			if(CRCUpdateByte((uint16_t)crc, (uint8_t)value) != ReferenceUpdateByte((uint16_t)crc, (uint8_t)value))
+			{
+				success = false;
+				break;
+			}
+		}
+	}
+
+	DisplayMessage(L"  %-10s %s\n", L"byte", success ? L"ok" : L"failed");
+
+	// blocks (slice-by-8 and slice-by-4 paths, unaligned data) and the incremental interface
+	for(i = 0; i < SELF_TEST_BLOCK_COUNT && success; i++)
+	{
+		random = random * 1103515245 + 12345;
+		offset = (random >> 8) % (SELF_TEST_DATA_LENGTH / 2);
+		random = random * 1103515245 + 12345;
+		length = (random >> 8) % 1100;
+		random = random * 1103515245 + 12345;
+		start_crc = (uint16_t)(random >> 16);
+		split = (length > 0) ? (int)((random >> 4) % length) : 0;
+
+		reference_crc = ReferenceUpdateBlock(start_crc, &data[offset], length);
+
+		if(CRCUpdateBlock(start_crc, &data[offset], length) != reference_crc)
+			success = false;
+
+		CRCReset(start_crc);
+		CRCAddBlock(&data[offset], split);
+		if(split < length)
+			CRCAddByte(data[offset + split]);
+		if(split + 1 < length)
+			CRCAddBlock(&data[offset + split + 1], length - split - 1);
+
+		if(CRCGet() != reference_crc)
+			success = false;
+	}
+
+	DisplayMessage(L"  %-10s %s\n", L"block", success ? L"ok" : L"failed");
+
+	// speed
+	if(success)
+	{
+		reference_throughput = MeasureThroughput(ReferenceUpdateBlock, data, &reference_crc);
+		table_throughput = MeasureThroughput(CRCUpdateBlock, data, &table_crc);
+
+		if(reference_crc != table_crc)
+			success = false;
+
+		DisplayMessage(L"  %-10s %12.0f bytes/sec\n", L"bitwise", reference_throughput);
+		DisplayMessage(L"  %-10s %12.0f bytes/sec\n", L"slice-by-8", table_throughput);
+	}
+
+	free(data);
+
+	return success;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Adds one bit to CRC
-static uint16_t CRCAddBit(bool in_bit)
+static uint16_t CRCAddBit(uint16_t in_crc, bool in_bit)
 {
 	uint8_t A;
 	uint8_t CY;
@@ -84,19 +272,84 @@ static uint16_t CRCAddBit(bool in_bit)
 	else											//    
 		A = 0;									// 		 XOR A
 														//
-	A = A ^ (HIGH(l_crc));		// L1: XOR H    
+	A = A ^ (HIGH(in_crc));		// L1: XOR H    
 	CY = (A & 0x80);					//     RLA
 														//
 	if( CY != 0 )							//     JR  NC,L2
 	{													//		 LD  A,H
-		l_crc ^= 0x0810;				//     XOR 08
+		in_crc ^= 0x0810;				//     XOR 08
 		CY = 1;                 //     LD  H,A
 		                        //     LD  A,L
 														//     XOR 10
 		                        //     LD  L,A
 	}													//     SCF
 														//
-	l_crc += l_crc + CY;			//     ADC HL,HL
+	in_crc += in_crc + CY;		//     ADC HL,HL
 
-	return l_crc;
+	return in_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates CRC of one byte using the original bitwise routine (reference for the table driven implementation)
+static uint16_t ReferenceUpdateByte(uint16_t in_crc, uint8_t in_data)
+{
+	int i;
+
+	for( i = 0; i < 8; i++)
+	{
+		if( (in_data & 0x01) == 0 )
+		{
+			in_crc = CRCAddBit(in_crc, false);
+		}
+		else
+		{
+			in_crc = CRCAddBit(in_crc, true);
+		}
+
+		in_data >>= 1;
+	}
+
+	return in_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates CRC of a buffer using the original bitwise routine
+static uint16_t ReferenceUpdateBlock(uint16_t in_crc, const uint8_t* in_buffer, int in_buffer_length)
+{
+	while(in_buffer_length > 0 )
+	{
+		in_crc = ReferenceUpdateByte(in_crc, *in_buffer);
+		in_buffer++;
+		in_buffer_length--;
+	}
+
+	return in_crc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reverses the bit order of a 16 bit value
+static uint16_t ReverseBits16(uint16_t in_value)
+{
+	return (uint16_t)((l_bit_reverse_table[in_value & 0xff] << 8) | l_bit_reverse_table[in_value >> 8]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Measures the speed of a block CRC function (bytes/sec)
+static double MeasureThroughput(uint16_t (*in_function)(uint16_t, const uint8_t*, int), const uint8_t* in_buffer, uint16_t* out_crc)
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER start_time;
+	LARGE_INTEGER end_time;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+
+	*out_crc = in_function(0, in_buffer, SELF_TEST_DATA_LENGTH);
+
+	QueryPerformanceCounter(&end_time);
+
+	if(end_time.QuadPart == start_time.QuadPart)
+		return 0;
+
+	return (double)SELF_TEST_DATA_LENGTH * frequency.QuadPart / (end_time.QuadPart - start_time.QuadPart);
 }
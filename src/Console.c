@@ -248,10 +248,14 @@ void PrintHelp(void)
 			L"  -s filename  saves list of file name of the created output files\n"
 			L"  -l filename  load input file names from a text file instead of using \n"
 			L"               command line parameter\n"
-			L"  -p f,l       digital preprocessing parameters (default = 1,1)\n"
-			L"     f - digital filter type (0 - no filter, 1 - fast, 2 - strong)\n"
+			L"  -p f,l,n,b,t digital preprocessing parameters (default = 1,1)\n"
+			L"     f - digital filter type (0 - no filter, 1 - fast, 2 - strong,\n"
+			L"         3 - sharp (long FIR filter using FFT))\n"
 			L"         (default: wavein=fast, wav=strong)\n"
 			L"     l - digital level control mode (0 - off, 1 - on)\n"
+			L"     n - sharp filter length in taps (256-2048, 0 or default: 1024)\n"
+			L"     b,t - filter pass band bottom and top frequency in Hz\n"
+			L"         (default: fast,strong=1000-3000, sharp=700-4000)\n"
 			L"  -g f,g,l     changes wave generation parameters\n"
 			L"     f - frequency offset in percentage\n"
 			L"     g - length of the gap in ms between header and data blocks\n"
@@ -288,6 +292,38 @@ void PrintHelp(void)
 			L"         goes into the tape (WAV or TTP) file header and the remaining data\n"
 			L"         bytes goesinto the data part of the tape file.\n"
 			L"         If the output file type is not WAV or TTP, this switch is ignored.\n"
+			L"  --benchmark  measures the speed of the digital filter implementations\n"
+			L"               (samples/sec) and exits\n"
+			L"  --selftest   checks the table driven CRC against the original bitwise\n"
+			L"               routine and exits\n"
+			L"  --parallel[=n] decodes WAV file segments and renders WAV output\n"
+			L"               on n threads in parallel (default: number of processors)\n"
+			L"  --wave=r,b,i wave file output format\n"
+			L"     r - sample rate (44100 (default), 48000, 96000 Hz)\n"
+			L"     b - bits per sample (8 (default), 16)\n"
+			L"     i - waveform interpolation (0 - none (default), 1 - linear,\n"
+			L"         2 - polynomial)\n"
+			L"  --verify     decodes the generated tape signal (44100Hz only) and\n"
+			L"               compares it with the saved program\n"
+			L"  --decimate=n decodes at 1/n of the input sample rate after the band\n"
+			L"               pass filter (1 (default) - 4)\n"
+			L"  --catalog    lists the programs of the wav input (position, name, length\n"
+			L"               and flags) from the header blocks, data blocks are skipped\n"
+			L"               and the block positions are saved into an index file (.tix)\n"
+			L"  --program=n  loads only the n-th program of the catalog using the index\n"
+			L"               file (the index is created when it doesn't exist)\n"
+			L"  --start=t    starts decoding of the wav input at the given position\n"
+			L"  --end=t      stops decoding of the wav input at the given position\n"
+			L"               (t is in seconds e.g. 95.5, or in samples e.g. 4211550smp)\n"
+			L"  --channels   decodes every channel of multichannel wav input separately\n"
+			L"               on its own thread, the best copy of each program is kept\n"
+			L"  --polarity   reads every block with both signal polarities, the one\n"
+			L"               which loads valid sectors is kept (inverted recordings)\n"
+			L"  --gate       skips silence, noise and voice between the programs of\n"
+			L"               the input without running them through the decoder\n"
+			L"  --resume     continues decoding of the wav input from its last checkpoint\n"
+			L"               (.tck with the full decoder state, saved every minute of\n"
+			L"               input and after every program during sequential decoding)\n"
 			L"\n"
 			L"  - 'file1' and 'file2' can be 'CAS', 'BAS', 'TTP', 'BIN', 'HEX' (Intel),\n"
 			L"     ROM (Cart), 'WAV' (PCM), 'WAVE:' (wave in/out device),\n"
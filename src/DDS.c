@@ -11,14 +11,55 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "DDS.h"
 #include "WaveMapper.h"
+#include "LoopbackVerifier.h"
 #include "Main.h"
 
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define DDS_PHASE_RANGE 0x10000							// number of phase values (only the upper 16 bits of the accumulator are used)
+#define DDS_SAMPLE_BUFFER_LENGTH 4096				// samples are rendered into a buffer and written in blocks
+#define DDS_FINE_AMPLITUDE 30720						// amplitude of the 16 bit sine table (same level as the 8 bit table)
+#define PI 3.14159265358979323846
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Pre-rendered waveforms of one bit (one signal period) for every possible starting phase
+typedef struct
+{
+	uint32_t PhaseIncrement;								// phase increment per sample (upper 16 bits of the DDS increment)
+	uint32_t* SampleIndex;									// first sample of the waveform for each starting phase
+	uint16_t* SampleCount;									// length of the waveform for each starting phase
+	uint16_t* EndPhase;											// phase after the waveform for each starting phase
+	uint8_t* Samples;
+} DDSBitCacheType;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Module global variables
 static uint32_t l_dds_accumulator = 0;
-static uint32_t l_dds_increment = 0;
+static uint32_t l_bit_increment[2];				// DDS increment of zero and one bits
+static DDSBitCacheType l_bit_cache[2];		// cached waveforms of zero and one bits
+static bool l_bit_cache_valid = false;
+static uint8_t l_sample_buffer[DDS_SAMPLE_BUFFER_LENGTH * sizeof(int16_t)];
+
+// output format
+static uint32_t l_sample_rate = SAMPLE_RATE;
+static uint8_t l_bits_per_sample = 8;
+static DDSInterpolationType l_interpolation = DDSI_None;
+static bool l_original_format = true;				// 8 bit, 44.1kHz, no interpolation: uses the original 8 bit sine table
+static uint64_t l_increment_per_hz;					// accumulator increment of 1Hz (Q16) at the current sample rate
+static int16_t l_fine_sine_table[DDS_TABLE_LENGTH + 3];	// 16 bit sine table with one extra entry before and two after
+
+///////////////////////////////////////////////////////////////////////////////
+// Local functions
+static int16_t GetFineSample(uint32_t in_accumulator);
+static bool RenderBitCache(DDSBitCacheType* inout_cache);
+static void FreeBitCache(DDSBitCacheType* inout_cache);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Initialize DDS
@@ -65,27 +106,45 @@ static uint8_t l_sine_table[DDS_TABLE_LENGTH] =
 	0x69, 0x6B, 0x6E, 0x71, 0x74, 0x77, 0x7A, 0x7D
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Sets output sample format (sample rate in Hz, 8 or 16 bits, sine table interpolation method)
+bool SetDDSFormat(uint32_t in_sample_rate, uint8_t in_bits_per_sample, DDSInterpolationType in_interpolation)
+{
+	int i;
+
+	if(in_sample_rate != 44100 && in_sample_rate != 48000 && in_sample_rate != 96000)
+		return false;
+
+	if(in_bits_per_sample != 8 && in_bits_per_sample != 16)
+		return false;
+
+	l_sample_rate = in_sample_rate;
+	l_bits_per_sample = in_bits_per_sample;
+	l_interpolation = in_interpolation;
+	l_original_format = (in_sample_rate == SAMPLE_RATE && in_bits_per_sample == 8 && in_interpolation == DDSI_None);
+	l_increment_per_hz = ((uint64_t)1 << 48) / in_sample_rate;
+
+	for(i = 0; i < DDS_TABLE_LENGTH + 3; i++)
+		l_fine_sine_table[i] = (int16_t)floor(DDS_FINE_AMPLITUDE * sin(2 * PI * (i - 1) / DDS_TABLE_LENGTH) + 0.5);
+
+	l_dds_accumulator = 0;
+
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Generate signal
 bool GenerateDDSSignal(uint32_t in_frequency, uint32_t in_cycle_count)
 {
-	uint8_t sample;
-	uint32_t prev_accumulator;
 	uint32_t dds_increment;
+	size_t length;
 	bool success = true;
 	
-	dds_increment = ((in_frequency * DDS_TABLE_LENGTH * 256) / SAMPLE_RATE) << 16;
+	dds_increment = GetDDSIncrement(in_frequency);
 	while(in_cycle_count > 0 && success)
 	{
-		sample = l_sine_table[(uint8_t)(l_dds_accumulator >> 24)];
-
-		prev_accumulator = l_dds_accumulator;
-		l_dds_accumulator += dds_increment;
-
-		if(l_dds_accumulator < prev_accumulator)
-			in_cycle_count--;
-
-		success = WMWriteSample(sample);
+		length = RenderDDSSignal(&l_dds_accumulator, dds_increment, &in_cycle_count, l_sample_buffer, DDS_SAMPLE_BUFFER_LENGTH);
+		success = WriteDDSSamples(l_sample_buffer, length);
 	}
 
 	return success;
@@ -95,16 +154,362 @@ bool GenerateDDSSignal(uint32_t in_frequency, uint32_t in_cycle_count)
 // Generate silence
 bool GenerateDDSSilence(uint16_t in_length_in_ms)
 {
-	uint32_t sample_count = (uint32_t)in_length_in_ms * SAMPLE_RATE / 1000;
+	uint32_t sample_count = GetDDSSilenceLength(in_length_in_ms);
+	uint32_t length;
 	bool success = true;
+
+	RenderDDSSilence(l_sample_buffer, DDS_SAMPLE_BUFFER_LENGTH);
 	
 	while(sample_count > 0 && success)
 	{
-		WMWriteSample(BYTE_SAMPLE_ZERO_VALUE);
-		sample_count--;
+		length = sample_count;
+		if(length > DDS_SAMPLE_BUFFER_LENGTH)
+			length = DDS_SAMPLE_BUFFER_LENGTH;
+
+		success = WriteDDSSamples(l_sample_buffer, length);
+		sample_count -= length;
 	}
 
 	l_dds_accumulator = 0;
 
 	return success;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// Sets zero and one bit frequencies (they are fixed for the whole encoding) and pre-renders their waveform for every
+// starting phase when the original sample format is used. Returns true if the waveform cache was created.
+bool InitDDSBitCache(uint32_t in_zero_frequency, uint32_t in_one_frequency)
+{
+	FreeDDSBitCache();
+
+	l_bit_increment[0] = GetDDSIncrement(in_zero_frequency);
+	l_bit_increment[1] = GetDDSIncrement(in_one_frequency);
+
+	// the cache is bit exact only with the original sample format
+	if(!l_original_format)
+		return false;
+
+	l_bit_cache[0].PhaseIncrement = l_bit_increment[0] >> 16;
+	l_bit_cache[1].PhaseIncrement = l_bit_increment[1] >> 16;
+
+	l_bit_cache_valid = RenderBitCache(&l_bit_cache[0]) && RenderBitCache(&l_bit_cache[1]);
+
+	if(!l_bit_cache_valid)
+		FreeDDSBitCache();
+
+	return l_bit_cache_valid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases bit waveform cache
+void FreeDDSBitCache(void)
+{
+	FreeBitCache(&l_bit_cache[0]);
+	FreeBitCache(&l_bit_cache[1]);
+
+	l_bit_cache_valid = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generates signal of one byte (LSB first, one period per bit)
+bool GenerateDDSByte(uint8_t in_data)
+{
+	size_t length;
+
+	length = RenderDDSByte(&l_dds_accumulator, in_data, l_sample_buffer);
+
+	return WriteDDSSamples(l_sample_buffer, length);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets current phase accumulator value
+uint32_t GetDDSAccumulator(void)
+{
+	return l_dds_accumulator;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sets phase accumulator value
+void SetDDSAccumulator(uint32_t in_accumulator)
+{
+	l_dds_accumulator = in_accumulator;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets size of one rendered sample in bytes
+size_t GetDDSSampleSize(void)
+{
+	return (l_bits_per_sample == 16) ? sizeof(int16_t) : sizeof(uint8_t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets sample rate of the rendered signal
+uint32_t GetDDSSampleRate(void)
+{
+	return l_sample_rate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates DDS accumulator increment of the given frequency (the original format uses the original 16 bit precision
+// increment, the other formats use the precomputed full precision increment of the sample rate)
+uint32_t GetDDSIncrement(uint32_t in_frequency)
+{
+	if(l_original_format)
+		return ((in_frequency * DDS_TABLE_LENGTH * 256) / SAMPLE_RATE) << 16;
+	else
+		return (uint32_t)((in_frequency * l_increment_per_hz + 0x8000) >> 16);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates the number of samples of the given number of signal periods without rendering them. The accumulator is
+// updated to its value after the signal. (A period ends when the accumulator overflows after a sample, so the signal
+// is as long as the number of increments needed to reach in_cycle_count overflows.)
+uint32_t GetDDSSignalLength(uint32_t* inout_accumulator, uint32_t in_increment, uint32_t in_cycle_count)
+{
+	uint64_t sample_count;
+
+	if(in_cycle_count == 0)
+		return 0;
+
+	sample_count = (((uint64_t)in_cycle_count << 32) - *inout_accumulator + in_increment - 1) / in_increment;
+	*inout_accumulator += (uint32_t)(sample_count * in_increment);
+
+	return (uint32_t)sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates the number of samples of one byte without rendering it (accumulator is updated)
+uint32_t GetDDSByteLength(uint32_t* inout_accumulator, uint8_t in_data)
+{
+	uint32_t sample_count = 0;
+	uint32_t phase;
+	int bit;
+
+	if(l_bit_cache_valid)
+	{
+		phase = *inout_accumulator >> 16;
+		for(bit = 0; bit < 8; bit++)
+		{
+			sample_count += l_bit_cache[in_data & 0x01].SampleCount[phase];
+			phase = l_bit_cache[in_data & 0x01].EndPhase[phase];
+			in_data >>= 1;
+		}
+
+		*inout_accumulator = phase << 16;
+	}
+	else
+	{
+		for(bit = 0; bit < 8; bit++)
+		{
+			sample_count += GetDDSSignalLength(inout_accumulator, l_bit_increment[in_data & 0x01], 1);
+			in_data >>= 1;
+		}
+	}
+
+	return sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of samples of the given length of silence
+uint32_t GetDDSSilenceLength(uint16_t in_length_in_ms)
+{
+	return (uint32_t)in_length_in_ms * l_sample_rate / 1000;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Renders signal periods into the buffer starting at the given phase (max. in_max_sample_count samples). Accumulator
+// and the remaining cycle count are updated, returns the number of rendered samples.
+size_t RenderDDSSignal(uint32_t* inout_accumulator, uint32_t in_increment, uint32_t* inout_cycle_count, uint8_t* out_samples, size_t in_max_sample_count)
+{
+	uint32_t accumulator = *inout_accumulator;
+	uint32_t prev_accumulator;
+	uint32_t cycle_count = *inout_cycle_count;
+	int16_t* fine_samples = (int16_t*)out_samples;
+	size_t length = 0;
+
+	while(cycle_count > 0 && length < in_max_sample_count)
+	{
+		if(l_original_format)
+			out_samples[length] = l_sine_table[(uint8_t)(accumulator >> 24)];
+		else if(l_bits_per_sample == 16)
+			fine_samples[length] = GetFineSample(accumulator);
+		else
+			out_samples[length] = (uint8_t)((GetFineSample(accumulator) + 0x8000 + 0x80) >> 8);
+
+		length++;
+
+		prev_accumulator = accumulator;
+		accumulator += in_increment;
+
+		if(accumulator < prev_accumulator)
+			cycle_count--;
+	}
+
+	*inout_accumulator = accumulator;
+	*inout_cycle_count = cycle_count;
+
+	return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Renders signal of one byte (LSB first, one period per bit) using the bit waveform cache when it is available.
+// The buffer must hold 8 * DDS_MAX_BIT_SAMPLE_COUNT samples. Returns the number of rendered samples.
+size_t RenderDDSByte(uint32_t* inout_accumulator, uint8_t in_data, uint8_t* out_samples)
+{
+	DDSBitCacheType* cache;
+	uint32_t phase;
+	uint32_t cycle_count;
+	size_t length = 0;
+	int bit;
+
+	if(l_bit_cache_valid)
+	{
+		// assemble byte waveform from the cached bit waveforms
+		phase = *inout_accumulator >> 16;
+		for(bit = 0; bit < 8; bit++)
+		{
+			cache = &l_bit_cache[in_data & 0x01];
+
+			memcpy(&out_samples[length], &cache->Samples[cache->SampleIndex[phase]], cache->SampleCount[phase]);
+			length += cache->SampleCount[phase];
+			phase = cache->EndPhase[phase];
+
+			in_data >>= 1;
+		}
+
+		*inout_accumulator = phase << 16;
+	}
+	else
+	{
+		for(bit = 0; bit < 8; bit++)
+		{
+			cycle_count = 1;
+			length += RenderDDSSignal(inout_accumulator, l_bit_increment[in_data & 0x01], &cycle_count, out_samples + length * GetDDSSampleSize(), DDS_MAX_BIT_SAMPLE_COUNT);
+			in_data >>= 1;
+		}
+	}
+
+	return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fills the buffer with silence
+void RenderDDSSilence(uint8_t* out_samples, size_t in_sample_count)
+{
+	if(l_bits_per_sample == 16)
+		memset(out_samples, 0, in_sample_count * sizeof(int16_t));
+	else
+		memset(out_samples, BYTE_SAMPLE_ZERO_VALUE, in_sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes rendered samples to the wave output
+bool WriteDDSSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	// pass the signal to the loopback verifier (when it is running)
+	LVFeedSamples(in_samples, in_sample_count);
+
+	if(l_bits_per_sample == 16)
+		return WMWriteWordSamples((const int16_t*)in_samples, in_sample_count);
+	else
+		return WMWriteSamples(in_samples, in_sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets 16 bit sample of the given phase (the upper 8 bits of the accumulator select the table entry, the next 16 bits
+// are used for interpolation)
+static int16_t GetFineSample(uint32_t in_accumulator)
+{
+	int index = (int)(in_accumulator >> 24) + 1;
+	int32_t fraction = (int32_t)((in_accumulator >> 8) & 0xffff);
+	double x;
+	double y0, y1, y2, y3;
+	double value;
+
+	switch(l_interpolation)
+	{
+		// linear interpolation between the two neighbouring entries
+		case DDSI_Linear:
+			return (int16_t)(l_fine_sine_table[index] + (((l_fine_sine_table[index + 1] - l_fine_sine_table[index]) * fraction) >> 16));
+
+		// third order (Catmull-Rom) polynomial of the four neighbouring entries
+		case DDSI_Polynomial:
+			x = fraction / 65536.0;
+			y0 = l_fine_sine_table[index - 1];
+			y1 = l_fine_sine_table[index];
+			y2 = l_fine_sine_table[index + 1];
+			y3 = l_fine_sine_table[index + 2];
+
+			value = y1 + 0.5 * x * (y2 - y0 + x * (2 * y0 - 5 * y1 + 4 * y2 - y3 + x * (3 * (y1 - y2) + y3 - y0)));
+
+			return (int16_t)floor(value + 0.5);
+
+		default:
+			return l_fine_sine_table[index];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Renders bit waveforms of the given frequency. The lower 16 bits of the accumulator are always zero (the increment is
+// shifted by 16 and the accumulator is reset to zero by silence), so the upper 16 bits determine the whole waveform.
+static bool RenderBitCache(DDSBitCacheType* inout_cache)
+{
+	uint32_t phase;
+	uint32_t start_phase;
+	uint32_t sample_index;
+	uint32_t sample_count;
+	uint32_t total_sample_count;
+
+	// too low or too high frequencies are not cached
+	if(inout_cache->PhaseIncrement == 0 || (DDS_PHASE_RANGE + inout_cache->PhaseIncrement - 1) / inout_cache->PhaseIncrement > DDS_MAX_BIT_SAMPLE_COUNT)
+		return false;
+
+	// determine cache size
+	total_sample_count = 0;
+	for(start_phase = 0; start_phase < DDS_PHASE_RANGE; start_phase++)
+		total_sample_count += (DDS_PHASE_RANGE - start_phase + inout_cache->PhaseIncrement - 1) / inout_cache->PhaseIncrement;
+
+	inout_cache->SampleIndex = (uint32_t*)malloc(DDS_PHASE_RANGE * sizeof(uint32_t));
+	inout_cache->SampleCount = (uint16_t*)malloc(DDS_PHASE_RANGE * sizeof(uint16_t));
+	inout_cache->EndPhase = (uint16_t*)malloc(DDS_PHASE_RANGE * sizeof(uint16_t));
+	inout_cache->Samples = (uint8_t*)malloc(total_sample_count);
+
+	if(inout_cache->SampleIndex == NULL || inout_cache->SampleCount == NULL || inout_cache->EndPhase == NULL || inout_cache->Samples == NULL)
+		return false;
+
+	// render waveforms
+	sample_index = 0;
+	for(start_phase = 0; start_phase < DDS_PHASE_RANGE; start_phase++)
+	{
+		inout_cache->SampleIndex[start_phase] = sample_index;
+
+		phase = start_phase;
+		sample_count = 0;
+		while(phase < DDS_PHASE_RANGE)
+		{
+			inout_cache->Samples[sample_index++] = l_sine_table[(uint8_t)(phase >> 8)];
+			phase += inout_cache->PhaseIncrement;
+			sample_count++;
+		}
+
+		inout_cache->SampleCount[start_phase] = (uint16_t)sample_count;
+		inout_cache->EndPhase[start_phase] = (uint16_t)(phase - DDS_PHASE_RANGE);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases waveforms of one bit
+static void FreeBitCache(DDSBitCacheType* inout_cache)
+{
+	free(inout_cache->SampleIndex);
+	free(inout_cache->SampleCount);
+	free(inout_cache->EndPhase);
+	free(inout_cache->Samples);
+
+	inout_cache->SampleIndex = NULL;
+	inout_cache->SampleCount = NULL;
+	inout_cache->EndPhase = NULL;
+	inout_cache->Samples = NULL;
+}
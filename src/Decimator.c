@@ -0,0 +1,120 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Polyphase decimator (low pass filter and sample rate reduction)           */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <math.h>
+#include <string.h>
+#include "Decimator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define PI 3.14159265358979323846
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes decimator. The anti aliasing filter is a Blackman windowed sinc low pass filter with the cutoff at the
+// output Nyquist frequency, its transition band is wide enough to keep the 1-3kHz band of the tape signal intact.
+bool DMInit(DMDecimatorType* out_decimator, int in_factor)
+{
+	double coefficients[DM_MAX_TAP_COUNT];
+	double cutoff;
+	double sum;
+	double x;
+	int32_t quantized_sum;
+	int i;
+
+	if(in_factor < 1 || in_factor > DM_MAX_FACTOR)
+		return false;
+
+	memset(out_decimator, 0, sizeof(DMDecimatorType));
+	out_decimator->Factor = in_factor;
+
+	if(in_factor == 1)
+		return true;
+
+	out_decimator->TapCount = in_factor * DM_TAPS_PER_PHASE;
+
+	// design low pass filter (cutoff is relative to the input sample rate)
+	cutoff = 0.5 / in_factor;
+	sum = 0;
+	for(i = 0; i < out_decimator->TapCount; i++)
+	{
+		x = i - (out_decimator->TapCount - 1) / 2.0;
+		coefficients[i] = 2 * cutoff * ((x == 0) ? 1.0 : sin(2 * PI * cutoff * x) / (2 * PI * cutoff * x));
+		coefficients[i] *= 0.42 - 0.5 * cos(2 * PI * i / (out_decimator->TapCount - 1)) + 0.08 * cos(4 * PI * i / (out_decimator->TapCount - 1));
+		sum += coefficients[i];
+	}
+
+	// quantize coefficients for unity DC gain (rounding error is added to the middle tap)
+	quantized_sum = 0;
+	for(i = 0; i < out_decimator->TapCount; i++)
+	{
+		out_decimator->Coefficients[i] = (int32_t)floor(coefficients[i] / sum * (1 << DM_COEFFICIENT_SHIFT) + 0.5);
+		quantized_sum += out_decimator->Coefficients[i];
+	}
+	out_decimator->Coefficients[out_decimator->TapCount / 2] += (1 << DM_COEFFICIENT_SHIFT) - quantized_sum;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Filters and decimates a block of samples (max. WAVE_SAMPLE_BLOCK_LENGTH samples, in_samples and out_samples may be
+// the same buffer). Only every Factor-th output of the filter is calculated. Returns the number of output samples.
+size_t DMProcessSamples(DMDecimatorType* in_decimator, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	const int32_t* coefficients = in_decimator->Coefficients;
+	int32_t* history = in_decimator->History;
+	int history_length = in_decimator->TapCount - 1;
+	size_t output_count = 0;
+	size_t i;
+	int64_t sum;
+	int tap;
+
+	if(in_decimator->Factor == 1)
+	{
+		if(out_samples != in_samples)
+			memmove(out_samples, in_samples, in_sample_count * sizeof(int32_t));
+
+		return in_sample_count;
+	}
+
+	if(in_sample_count > WAVE_SAMPLE_BLOCK_LENGTH)
+		in_sample_count = WAVE_SAMPLE_BLOCK_LENGTH;
+
+	memcpy(&history[history_length], in_samples, in_sample_count * sizeof(int32_t));
+
+	for(i = in_decimator->SkipCount; i < in_sample_count; i += in_decimator->Factor)
+	{
+		// the filter is symmetric, the output belongs to the i-th input sample
+		sum = 0;
+		for(tap = 0; tap < in_decimator->TapCount; tap++)
+			sum += (int64_t)coefficients[tap] * history[i + tap];
+
+		out_samples[output_count++] = (int32_t)((sum + (1 << (DM_COEFFICIENT_SHIFT - 1))) >> DM_COEFFICIENT_SHIFT);
+	}
+
+	in_decimator->SkipCount = (int)(i - in_sample_count);
+
+	// keep the last samples for the next block
+	memmove(history, &history[in_sample_count], history_length * sizeof(int32_t));
+
+	return output_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the delay of the decimator in input samples
+size_t DMGetLatency(const DMDecimatorType* in_decimator)
+{
+	if(in_decimator->Factor == 1)
+		return 0;
+
+	return (in_decimator->TapCount - 1) / 2;
+}
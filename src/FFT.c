@@ -0,0 +1,219 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Real FFT (radix-2) for fast convolution                                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <math.h>
+#include "FFT.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define PI 3.14159265358979323846
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void ComplexTransform(FFTType* in_fft, FFTComplexType* in_out_data, bool in_inverse);
+
+///////////////////////////////////////////////////////////////////////////////
+// Prepares transform tables for the given length (power of two between FFT_MIN_LENGTH and FFT_MAX_LENGTH)
+bool FFTInit(FFTType* out_fft, int in_length)
+{
+	int i;
+	int bit_count;
+	int reversed;
+	int bit;
+	int half_size;
+
+	// check length
+	if(in_length < FFT_MIN_LENGTH || in_length > FFT_MAX_LENGTH || (in_length & (in_length - 1)) != 0)
+		return false;
+
+	out_fft->Length = in_length;
+	out_fft->ComplexLength = in_length / 2;
+
+	// twiddle factors
+	for(half_size = 1; half_size < out_fft->ComplexLength; half_size *= 2)
+	{
+		for(i = 0; i < half_size; i++)
+		{
+			out_fft->Twiddle[half_size - 1 + i].Re = cos(PI * i / half_size);
+			out_fft->Twiddle[half_size - 1 + i].Im = -sin(PI * i / half_size);
+		}
+	}
+
+	for(i = 0; i < out_fft->ComplexLength; i++)
+	{
+		out_fft->RealTwiddle[i].Re = cos(2 * PI * i / in_length);
+		out_fft->RealTwiddle[i].Im = -sin(2 * PI * i / in_length);
+	}
+
+	// bit reversal table
+	bit_count = 0;
+	while((1 << bit_count) < out_fft->ComplexLength)
+		bit_count++;
+
+	for(i = 0; i < out_fft->ComplexLength; i++)
+	{
+		reversed = 0;
+		for(bit = 0; bit < bit_count; bit++)
+		{
+			if((i & (1 << bit)) != 0)
+				reversed |= 1 << (bit_count - 1 - bit);
+		}
+
+		out_fft->BitReverse[i] = (uint16_t)reversed;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Transforms Length real samples into Length/2+1 complex spectrum values
+void FFTForwardReal(FFTType* in_fft, const double* in_samples, FFTComplexType* out_spectrum)
+{
+	int n = in_fft->ComplexLength;
+	int k;
+	FFTComplexType* z = in_fft->Buffer;
+	FFTComplexType even;
+	FFTComplexType odd;
+	FFTComplexType w;
+
+	// pack even samples to the real, odd samples to the imaginary part
+	for(k = 0; k < n; k++)
+	{
+		z[k].Re = in_samples[2 * k];
+		z[k].Im = in_samples[2 * k + 1];
+	}
+
+	ComplexTransform(in_fft, z, false);
+
+	// split the spectrum of the even and odd samples and combine them
+	out_spectrum[0].Re = z[0].Re + z[0].Im;
+	out_spectrum[0].Im = 0;
+	out_spectrum[n].Re = z[0].Re - z[0].Im;
+	out_spectrum[n].Im = 0;
+
+	for(k = 1; k < n; k++)
+	{
+		even.Re = (z[k].Re + z[n - k].Re) / 2;
+		even.Im = (z[k].Im - z[n - k].Im) / 2;
+		odd.Re = (z[k].Im + z[n - k].Im) / 2;
+		odd.Im = -(z[k].Re - z[n - k].Re) / 2;
+		w = in_fft->RealTwiddle[k];
+
+		out_spectrum[k].Re = even.Re + w.Re * odd.Re - w.Im * odd.Im;
+		out_spectrum[k].Im = even.Im + w.Re * odd.Im + w.Im * odd.Re;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Transforms Length/2+1 complex spectrum values back to Length real samples (scaled by 1/Length)
+void FFTInverseReal(FFTType* in_fft, const FFTComplexType* in_spectrum, double* out_samples)
+{
+	int n = in_fft->ComplexLength;
+	int k;
+	FFTComplexType* z = in_fft->Buffer;
+	FFTComplexType even;
+	FFTComplexType difference;
+	FFTComplexType odd;
+	FFTComplexType w;
+
+	// rebuild the spectrum of the even (real part) and odd (imaginary part) samples
+	for(k = 0; k < n; k++)
+	{
+		even.Re = (in_spectrum[k].Re + in_spectrum[n - k].Re) / 2;
+		even.Im = (in_spectrum[k].Im - in_spectrum[n - k].Im) / 2;
+		difference.Re = (in_spectrum[k].Re - in_spectrum[n - k].Re) / 2;
+		difference.Im = (in_spectrum[k].Im + in_spectrum[n - k].Im) / 2;
+		w = in_fft->RealTwiddle[k];
+
+		// odd = difference * conj(w)
+		odd.Re = difference.Re * w.Re + difference.Im * w.Im;
+		odd.Im = difference.Im * w.Re - difference.Re * w.Im;
+
+		z[k].Re = even.Re - odd.Im;
+		z[k].Im = even.Im + odd.Re;
+	}
+
+	ComplexTransform(in_fft, z, true);
+
+	for(k = 0; k < n; k++)
+	{
+		out_samples[2 * k] = z[k].Re / n;
+		out_samples[2 * k + 1] = z[k].Im / n;
+	}
+}
+
+/*****************************************************************************/
+/* Local functions                                                           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// In place radix-2 complex FFT of ComplexLength points (inverse is not scaled)
+static void ComplexTransform(FFTType* in_fft, FFTComplexType* in_out_data, bool in_inverse)
+{
+	int n = in_fft->ComplexLength;
+	int i;
+	int j;
+	int k;
+	int start;
+	int half_size;
+	const FFTComplexType* twiddle;
+	FFTComplexType temp;
+
+	// inverse transform is calculated as conj(FFT(conj(x)))
+	if(in_inverse)
+	{
+		for(i = 0; i < n; i++)
+			in_out_data[i].Im = -in_out_data[i].Im;
+	}
+
+	// reorder data to bit reversed order
+	for(i = 0; i < n; i++)
+	{
+		j = in_fft->BitReverse[i];
+		if(j > i)
+		{
+			temp = in_out_data[i];
+			in_out_data[i] = in_out_data[j];
+			in_out_data[j] = temp;
+		}
+	}
+
+	// butterflies
+	for(half_size = 1; half_size < n; half_size *= 2)
+	{
+		twiddle = &in_fft->Twiddle[half_size - 1];
+
+		for(start = 0; start < n; start += 2 * half_size)
+		{
+			for(k = 0; k < half_size; k++)
+			{
+				i = start + k;
+				j = i + half_size;
+
+				temp.Re = in_out_data[j].Re * twiddle[k].Re - in_out_data[j].Im * twiddle[k].Im;
+				temp.Im = in_out_data[j].Re * twiddle[k].Im + in_out_data[j].Im * twiddle[k].Re;
+
+				in_out_data[j].Re = in_out_data[i].Re - temp.Re;
+				in_out_data[j].Im = in_out_data[i].Im - temp.Im;
+				in_out_data[i].Re += temp.Re;
+				in_out_data[i].Im += temp.Im;
+			}
+		}
+	}
+
+	if(in_inverse)
+	{
+		for(i = 0; i < n; i++)
+			in_out_data[i].Im = -in_out_data[i].Im;
+	}
+}
@@ -0,0 +1,417 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Digital filter designer (IIR and FIR band pass filters)                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <math.h>
+#include <string.h>
+#include "FilterDesign.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define PI 3.14159265358979323846
+#define IIR_CACHE_SIZE 8
+#define FIR_CACHE_SIZE 4
+#define MAX_DC_GAIN_SHIFT 30
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+typedef struct
+{
+	double Re;
+	double Im;
+} ComplexType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static bool DesignIIR(FDIIRDesignType* out_design);
+static void DesignFIR(FDFIRDesignType* out_design);
+static void QuantizeFIR(FDFIRDesignType* in_out_design);
+static double KaiserWindow(int in_index, int in_length, double in_beta);
+static double BesselI0(double in_x);
+static ComplexType ComplexMake(double in_re, double in_im);
+static ComplexType ComplexAdd(ComplexType in_a, ComplexType in_b);
+static ComplexType ComplexSub(ComplexType in_a, ComplexType in_b);
+static ComplexType ComplexMul(ComplexType in_a, ComplexType in_b);
+static ComplexType ComplexDiv(ComplexType in_a, ComplexType in_b);
+static ComplexType ComplexSqrt(ComplexType in_a);
+
+///////////////////////////////////////////////////////////////////////////////
+// Module global variables
+
+// memoized designs (the same filter is requested again after every reinitialization)
+static FDIIRDesignType l_iir_cache[IIR_CACHE_SIZE];
+static int l_iir_cache_count = 0;
+static int l_iir_cache_next = 0;
+static FDFIRDesignType l_fir_cache[FIR_CACHE_SIZE];
+static int l_fir_cache_count = 0;
+static int l_fir_cache_next = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets IIR band pass filter design (returns NULL if parameters are invalid)
+// The returned design is valid until the next design call.
+const FDIIRDesignType* FDDesignIIRBandPass(FDIIRModelType in_model, uint32_t in_sample_rate, uint16_t in_low_cutoff_frequency, uint16_t in_high_cutoff_frequency, uint8_t in_order)
+{
+	FDIIRDesignType* design;
+	FDIIRDesignType new_design;
+	int i;
+
+	// check parameters
+	if(in_order < 1 || in_order > FD_MAX_IIR_ORDER || in_low_cutoff_frequency == 0 || in_low_cutoff_frequency >= in_high_cutoff_frequency || 2 * (uint32_t)in_high_cutoff_frequency >= in_sample_rate)
+		return NULL;
+
+	// find in cache
+	for(i = 0; i < l_iir_cache_count; i++)
+	{
+		design = &l_iir_cache[i];
+		if(design->Model == in_model && design->SampleRate == in_sample_rate && design->LowCutoffFrequency == in_low_cutoff_frequency && design->HighCutoffFrequency == in_high_cutoff_frequency && design->Order == in_order)
+			return design;
+	}
+
+	// design new filter
+	memset(&new_design, 0, sizeof(new_design));
+	new_design.Model = in_model;
+	new_design.SampleRate = in_sample_rate;
+	new_design.LowCutoffFrequency = in_low_cutoff_frequency;
+	new_design.HighCutoffFrequency = in_high_cutoff_frequency;
+	new_design.Order = in_order;
+
+	if(!DesignIIR(&new_design))
+		return NULL;
+
+	// store in the next cache entry
+	design = &l_iir_cache[l_iir_cache_next];
+	*design = new_design;
+
+	if(l_iir_cache_count < IIR_CACHE_SIZE)
+		l_iir_cache_count++;
+	l_iir_cache_next = (l_iir_cache_next + 1) % IIR_CACHE_SIZE;
+
+	return design;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets windowed sinc FIR band pass filter design (returns NULL if parameters are invalid)
+// The returned design is valid until the next design call.
+const FDFIRDesignType* FDDesignFIRBandPass(FDWindowType in_window, uint32_t in_sample_rate, uint16_t in_low_cutoff_frequency, uint16_t in_high_cutoff_frequency, uint16_t in_tap_count)
+{
+	FDFIRDesignType* design;
+	int i;
+
+	// check parameters
+	if(in_tap_count < 2 || in_tap_count > FD_MAX_FIR_TAP_COUNT || in_low_cutoff_frequency == 0 || in_low_cutoff_frequency >= in_high_cutoff_frequency || 2 * (uint32_t)in_high_cutoff_frequency >= in_sample_rate)
+		return NULL;
+
+	// find in cache
+	for(i = 0; i < l_fir_cache_count; i++)
+	{
+		design = &l_fir_cache[i];
+		if(design->Window == in_window && design->SampleRate == in_sample_rate && design->LowCutoffFrequency == in_low_cutoff_frequency && design->HighCutoffFrequency == in_high_cutoff_frequency && design->TapCount == in_tap_count)
+			return design;
+	}
+
+	// design into the next cache entry (design can't fail after the parameter check)
+	design = &l_fir_cache[l_fir_cache_next];
+	design->Window = in_window;
+	design->SampleRate = in_sample_rate;
+	design->LowCutoffFrequency = in_low_cutoff_frequency;
+	design->HighCutoffFrequency = in_high_cutoff_frequency;
+	design->TapCount = in_tap_count;
+
+	DesignFIR(design);
+	QuantizeFIR(design);
+
+	if(l_fir_cache_count < FIR_CACHE_SIZE)
+		l_fir_cache_count++;
+	l_fir_cache_next = (l_fir_cache_next + 1) % FIR_CACHE_SIZE;
+
+	return design;
+}
+
+/*****************************************************************************/
+/* IIR design                                                                */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Designs band pass filter: analog low pass prototype -> band pass transform -> bilinear transform
+static bool DesignIIR(FDIIRDesignType* out_design)
+{
+	double fs = out_design->SampleRate;
+	int order = out_design->Order;
+	double epsilon;
+	double mu;
+	double theta;
+	double low_omega;
+	double high_omega;
+	double center_omega;
+	double bandwidth;
+	double prototype_gain;
+	double center_frequency;
+	double gain;
+	double section_gain;
+	ComplexType prototype_pole;
+	ComplexType half_pole;
+	ComplexType root;
+	ComplexType analog_poles[2];
+	ComplexType digital_poles[2];
+	ComplexType z1;
+	ComplexType z2;
+	ComplexType zc;
+	ComplexType zc2;
+	ComplexType response;
+	ComplexType two_fs = ComplexMake(2 * fs, 0);
+	FDSectionType* section;
+	int section_count;
+	int pole_count;
+	int k;
+	int i;
+
+	// pre-warped band edges
+	low_omega = 2 * fs * tan(PI * out_design->LowCutoffFrequency / fs);
+	high_omega = 2 * fs * tan(PI * out_design->HighCutoffFrequency / fs);
+	center_omega = sqrt(low_omega * high_omega);
+	bandwidth = high_omega - low_omega;
+
+	if(out_design->Model == FDM_Chebyshev)
+	{
+		epsilon = sqrt(pow(10.0, FD_CHEBYSHEV_RIPPLE / 10) - 1);
+		mu = asinh(1 / epsilon) / order;
+		prototype_gain = ((order % 2) == 0) ? 1 / sqrt(1 + epsilon * epsilon) : 1;
+	}
+	else
+	{
+		epsilon = 0;
+		mu = 0;
+		prototype_gain = 1;
+	}
+
+	// process upper half plane prototype poles, each of them gives two sections (a real pole gives one)
+	section_count = 0;
+	for(k = 0; k < (order + 1) / 2; k++)
+	{
+		theta = PI * (2 * k + 1) / (2 * order);
+
+		if(out_design->Model == FDM_Chebyshev)
+			prototype_pole = ComplexMake(-sinh(mu) * sin(theta), cosh(mu) * cos(theta));
+		else
+			prototype_pole = ComplexMake(-sin(theta), cos(theta));
+
+		// low pass to band pass transform: s^2 - p*bw*s + w0^2 = 0
+		half_pole = ComplexMake(prototype_pole.Re * bandwidth / 2, prototype_pole.Im * bandwidth / 2);
+		root = ComplexSqrt(ComplexSub(ComplexMul(half_pole, half_pole), ComplexMake(center_omega * center_omega, 0)));
+		analog_poles[0] = ComplexAdd(half_pole, root);
+		analog_poles[1] = ComplexSub(half_pole, root);
+
+		// bilinear transform
+		for(i = 0; i < 2; i++)
+			digital_poles[i] = ComplexDiv(ComplexAdd(two_fs, analog_poles[i]), ComplexSub(two_fs, analog_poles[i]));
+
+		// real prototype pole gives one section with the two band pass poles, complex pole gives two sections with the conjugate poles
+		if(fabs(prototype_pole.Im) < 1e-12)
+			pole_count = 1;
+		else
+			pole_count = 2;
+
+		for(i = 0; i < pole_count; i++)
+		{
+			if(pole_count == 1)
+			{
+				z1 = digital_poles[0];
+				z2 = digital_poles[1];
+			}
+			else
+			{
+				z1 = digital_poles[i];
+				z2 = ComplexMake(z1.Re, -z1.Im);
+			}
+
+			if(section_count >= FD_MAX_IIR_ORDER)
+				return false;
+
+			// zeros at z=1 and z=-1
+			section = &out_design->Sections[section_count++];
+			section->B0 = 1;
+			section->B1 = 0;
+			section->B2 = -1;
+			section->A1 = -(z1.Re + z2.Re);
+			section->A2 = z1.Re * z2.Re - z1.Im * z2.Im;
+		}
+	}
+
+	if(section_count != order)
+		return false;
+
+	// normalize gain at the center frequency (the image of the DC of the prototype)
+	center_frequency = atan(center_omega / (2 * fs)) / PI;
+	zc = ComplexMake(cos(2 * PI * center_frequency), -sin(2 * PI * center_frequency));
+	zc2 = ComplexMul(zc, zc);
+	response = ComplexMake(1, 0);
+	for(i = 0; i < section_count; i++)
+	{
+		section = &out_design->Sections[i];
+		response = ComplexMul(response, ComplexDiv(
+			ComplexMake(section->B0 + section->B2 * zc2.Re, section->B2 * zc2.Im),
+			ComplexMake(1 + section->A1 * zc.Re + section->A2 * zc2.Re, section->A1 * zc.Im + section->A2 * zc2.Im)));
+	}
+
+	gain = prototype_gain / sqrt(response.Re * response.Re + response.Im * response.Im);
+	section_gain = pow(gain, 1.0 / section_count);
+
+	for(i = 0; i < section_count; i++)
+	{
+		section = &out_design->Sections[i];
+		section->B0 *= section_gain;
+		section->B1 *= section_gain;
+		section->B2 *= section_gain;
+	}
+
+	return true;
+}
+
+/*****************************************************************************/
+/* FIR design                                                                */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Designs windowed sinc band pass filter
+static void DesignFIR(FDFIRDesignType* out_design)
+{
+	int tap_count = out_design->TapCount;
+	double low = (double)out_design->LowCutoffFrequency / out_design->SampleRate;
+	double high = (double)out_design->HighCutoffFrequency / out_design->SampleRate;
+	double beta = 0.1102 * (FD_KAISER_ATTENUATION - 8.7);
+	double m;
+	int i;
+
+	for(i = 0; i < tap_count; i++)
+	{
+		m = i - (tap_count - 1) / 2.0;
+
+		if(m == 0)
+			out_design->Coefficients[i] = 2 * (high - low);
+		else
+			out_design->Coefficients[i] = (sin(2 * PI * high * m) - sin(2 * PI * low * m)) / (PI * m);
+
+		switch(out_design->Window)
+		{
+			case FDW_Blackman:
+				out_design->Coefficients[i] *= 0.42 - 0.5 * cos(2 * PI * i / (tap_count - 1)) + 0.08 * cos(4 * PI * i / (tap_count - 1));
+				break;
+
+			case FDW_Kaiser:
+				out_design->Coefficients[i] *= KaiserWindow(i, tap_count, beta);
+				break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Quantizes FIR coefficients to 16 bit using the highest power of two gain which fits
+static void QuantizeFIR(FDFIRDesignType* in_out_design)
+{
+	double max_coefficient = 0;
+	int shift;
+	int i;
+
+	for(i = 0; i < in_out_design->TapCount; i++)
+	{
+		if(fabs(in_out_design->Coefficients[i]) > max_coefficient)
+			max_coefficient = fabs(in_out_design->Coefficients[i]);
+	}
+
+	shift = 0;
+	while(shift < MAX_DC_GAIN_SHIFT && floor(max_coefficient * ((int32_t)1 << (shift + 1)) + 0.5) <= INT16_MAX)
+		shift++;
+
+	for(i = 0; i < in_out_design->TapCount; i++)
+		in_out_design->QuantizedCoefficients[i] = (int16_t)floor(in_out_design->Coefficients[i] * ((int32_t)1 << shift) + 0.5);
+
+	in_out_design->QuantizedDCGainShift = shift;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Kaiser window function
+static double KaiserWindow(int in_index, int in_length, double in_beta)
+{
+	double x = 2.0 * in_index / (in_length - 1) - 1;
+
+	return BesselI0(in_beta * sqrt(1 - x * x)) / BesselI0(in_beta);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Zeroth order modified Bessel function of the first kind (power series)
+static double BesselI0(double in_x)
+{
+	double sum = 1;
+	double term = 1;
+	double half_x = in_x / 2;
+	int k;
+
+	for(k = 1; k < 50; k++)
+	{
+		term *= (half_x / k) * (half_x / k);
+		sum += term;
+
+		if(term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+/*****************************************************************************/
+/* Complex arithmetic                                                        */
+/*****************************************************************************/
+
+static ComplexType ComplexMake(double in_re, double in_im)
+{
+	ComplexType result;
+
+	result.Re = in_re;
+	result.Im = in_im;
+
+	return result;
+}
+
+static ComplexType ComplexAdd(ComplexType in_a, ComplexType in_b)
+{
+	return ComplexMake(in_a.Re + in_b.Re, in_a.Im + in_b.Im);
+}
+
+static ComplexType ComplexSub(ComplexType in_a, ComplexType in_b)
+{
+	return ComplexMake(in_a.Re - in_b.Re, in_a.Im - in_b.Im);
+}
+
+static ComplexType ComplexMul(ComplexType in_a, ComplexType in_b)
+{
+	return ComplexMake(in_a.Re * in_b.Re - in_a.Im * in_b.Im, in_a.Re * in_b.Im + in_a.Im * in_b.Re);
+}
+
+static ComplexType ComplexDiv(ComplexType in_a, ComplexType in_b)
+{
+	double divisor = in_b.Re * in_b.Re + in_b.Im * in_b.Im;
+
+	return ComplexMake((in_a.Re * in_b.Re + in_a.Im * in_b.Im) / divisor, (in_a.Im * in_b.Re - in_a.Re * in_b.Im) / divisor);
+}
+
+static ComplexType ComplexSqrt(ComplexType in_a)
+{
+	double magnitude = sqrt(in_a.Re * in_a.Re + in_a.Im * in_a.Im);
+	double re = (magnitude + in_a.Re) / 2;
+	double im = (magnitude - in_a.Re) / 2;
+
+	// rounding error may give small negative values
+	re = (re > 0) ? sqrt(re) : 0;
+	im = (im > 0) ? sqrt(im) : 0;
+
+	return ComplexMake(re, (in_a.Im < 0) ? -im : im);
+}
@@ -0,0 +1,218 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* IIR filter engine (cascade of second order sections)                      */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <math.h>
+#include <string.h>
+#include "IIRFilter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static bool QuantizeCoefficient(double in_coefficient, int32_t* out_coefficient);
+static void ProcessFixedPoint(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static void ProcessFloatingPoint(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes filter from the designed sections (returns false if the coefficients can't be represented)
+bool IIRInit(IIRFilterType* out_filter, const FDSectionType* in_sections, int in_section_count, IIRArithmeticType in_arithmetic)
+{
+	IIRFixedPointSectionType* fixed_section;
+	IIRFloatingPointSectionType* float_section;
+	bool success = true;
+	int i;
+
+	if(in_section_count < 1 || in_section_count > IIR_MAX_SECTION_COUNT)
+		return false;
+
+	memset(out_filter, 0, sizeof(IIRFilterType));
+	out_filter->Arithmetic = in_arithmetic;
+	out_filter->SectionCount = in_section_count;
+
+	for(i = 0; i < in_section_count && success; i++)
+	{
+		switch(in_arithmetic)
+		{
+			case IIRA_FixedPoint:
+				fixed_section = &out_filter->FixedPointSections[i];
+				success = QuantizeCoefficient(in_sections[i].B0, &fixed_section->B0) &&
+									QuantizeCoefficient(in_sections[i].B1, &fixed_section->B1) &&
+									QuantizeCoefficient(in_sections[i].B2, &fixed_section->B2) &&
+									QuantizeCoefficient(in_sections[i].A1, &fixed_section->A1) &&
+									QuantizeCoefficient(in_sections[i].A2, &fixed_section->A2);
+				break;
+
+			case IIRA_FloatingPoint:
+				float_section = &out_filter->FloatingPointSections[i];
+				float_section->B0 = in_sections[i].B0;
+				float_section->B1 = in_sections[i].B1;
+				float_section->B2 = in_sections[i].B2;
+				float_section->A1 = in_sections[i].A1;
+				float_section->A2 = in_sections[i].A2;
+				break;
+
+			default:
+				success = false;
+				break;
+		}
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clears filter state (keeps the coefficients)
+void IIRReset(IIRFilterType* in_filter)
+{
+	int i;
+
+	for(i = 0; i < in_filter->SectionCount; i++)
+	{
+		in_filter->FixedPointSections[i].X1 = 0;
+		in_filter->FixedPointSections[i].X2 = 0;
+		in_filter->FixedPointSections[i].Y1 = 0;
+		in_filter->FixedPointSections[i].Y2 = 0;
+		in_filter->FloatingPointSections[i].Z1 = 0;
+		in_filter->FloatingPointSections[i].Z2 = 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Filters a block of samples (in_samples and out_samples may be the same buffer)
+void IIRProcessSamples(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	if(in_filter->Arithmetic == IIRA_FixedPoint)
+		ProcessFixedPoint(in_filter, in_samples, out_samples, in_sample_count);
+	else
+		ProcessFloatingPoint(in_filter, in_samples, out_samples, in_sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts coefficient to Q28 fixed point number
+static bool QuantizeCoefficient(double in_coefficient, int32_t* out_coefficient)
+{
+	double value = floor(in_coefficient * ((int32_t)1 << IIR_COEFFICIENT_SHIFT) + 0.5);
+
+	if(value < INT32_MIN || value > INT32_MAX)
+		return false;
+
+	*out_coefficient = (int32_t)value;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fixed point filter: every section runs on the whole block, results are normalized by shifting (no division)
+static void ProcessFixedPoint(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	int64_t buffer[IIR_BLOCK_LENGTH];
+	IIRFixedPointSectionType* section;
+	size_t block_length;
+	size_t i;
+	int64_t x1, x2, y1, y2;
+	int64_t x;
+	int64_t y;
+	int s;
+
+	while(in_sample_count > 0)
+	{
+		block_length = in_sample_count;
+		if(block_length > IIR_BLOCK_LENGTH)
+			block_length = IIR_BLOCK_LENGTH;
+
+		for(i = 0; i < block_length; i++)
+			buffer[i] = (int64_t)in_samples[i] << IIR_STATE_FRACTION_BITS;
+
+		for(s = 0; s < in_filter->SectionCount; s++)
+		{
+			section = &in_filter->FixedPointSections[s];
+			x1 = section->X1;
+			x2 = section->X2;
+			y1 = section->Y1;
+			y2 = section->Y2;
+
+			for(i = 0; i < block_length; i++)
+			{
+				x = buffer[i];
+				y = section->B0 * x + section->B1 * x1 + section->B2 * x2 - section->A1 * y1 - section->A2 * y2;
+				y = (y + ((int64_t)1 << (IIR_COEFFICIENT_SHIFT - 1))) >> IIR_COEFFICIENT_SHIFT;
+
+				x2 = x1;
+				x1 = x;
+				y2 = y1;
+				y1 = y;
+				buffer[i] = y;
+			}
+
+			section->X1 = x1;
+			section->X2 = x2;
+			section->Y1 = y1;
+			section->Y2 = y2;
+		}
+
+		for(i = 0; i < block_length; i++)
+			out_samples[i] = (int32_t)((buffer[i] + (1 << (IIR_STATE_FRACTION_BITS - 1))) >> IIR_STATE_FRACTION_BITS);
+
+		in_samples += block_length;
+		out_samples += block_length;
+		in_sample_count -= block_length;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Floating point filter
+static void ProcessFloatingPoint(IIRFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	double buffer[IIR_BLOCK_LENGTH];
+	IIRFloatingPointSectionType* section;
+	size_t block_length;
+	size_t i;
+	double z1, z2;
+	double x;
+	double y;
+	int s;
+
+	while(in_sample_count > 0)
+	{
+		block_length = in_sample_count;
+		if(block_length > IIR_BLOCK_LENGTH)
+			block_length = IIR_BLOCK_LENGTH;
+
+		for(i = 0; i < block_length; i++)
+			buffer[i] = in_samples[i];
+
+		for(s = 0; s < in_filter->SectionCount; s++)
+		{
+			section = &in_filter->FloatingPointSections[s];
+			z1 = section->Z1;
+			z2 = section->Z2;
+
+			for(i = 0; i < block_length; i++)
+			{
+				x = buffer[i];
+				y = section->B0 * x + z1;
+				z1 = section->B1 * x - section->A1 * y + z2;
+				z2 = section->B2 * x - section->A2 * y;
+				buffer[i] = y;
+			}
+
+			section->Z1 = z1;
+			section->Z2 = z2;
+		}
+
+		for(i = 0; i < block_length; i++)
+			out_samples[i] = (int32_t)floor(buffer[i] + 0.5);
+
+		in_samples += block_length;
+		out_samples += block_length;
+		in_sample_count -= block_length;
+	}
+}
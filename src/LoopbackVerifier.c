@@ -0,0 +1,338 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Loopback verifier (decodes the rendered tape signal on a worker thread)   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <Windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LoopbackVerifier.h"
+#include "TapeDecoder.h"
+#include "WaveMapper.h"
+#include "Console.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Block of rendered samples (zero sample count marks the end of the signal)
+typedef struct
+{
+	uint8_t Samples[LV_BLOCK_SAMPLE_COUNT * sizeof(int16_t)];
+	size_t SampleCount;
+} SampleBlockType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void QueueBlock(void);
+static DWORD WINAPI DecoderThread(LPVOID in_parameter);
+static void ConvertSamples(const SampleBlockType* in_block, int32_t* out_samples);
+static void DecodeSamples(const int32_t* in_samples, size_t in_sample_count);
+static void StoreResult(LoadStatus in_load_status);
+
+///////////////////////////////////////////////////////////////////////////////
+// Module global variables
+static bool l_active = false;
+static uint8_t l_bits_per_sample;
+static bool l_one_bit;
+static TapeDecoderType* l_decoder = NULL;
+static HANDLE l_thread = NULL;
+static HANDLE l_free_blocks = NULL;				// number of empty blocks in the queue
+static HANDLE l_queued_blocks = NULL;			// number of blocks waiting for the decoder
+static SampleBlockType* l_queue = NULL;
+static int l_write_index;									// block filled by the encoder (owned by the encoder when l_write_block_acquired is set)
+static int l_read_index;									// next block processed by the decoder thread
+static bool l_write_block_acquired;
+static LoadStatus l_load_status;
+static TDProgramType l_program;						// first program decoded from the signal
+
+///////////////////////////////////////////////////////////////////////////////
+// Starts verification of the rendered signal. The decoder only works with 44.1kHz signal. When the filter is not
+// selected (auto) the signal is decoded with the default filter of the wav file input.
+bool LVStart(FilterTypes in_filter_type, uint32_t in_sample_rate, uint8_t in_bits_per_sample, bool in_one_bit)
+{
+	if(l_active)
+		return false;
+
+	if(in_sample_rate != SAMPLE_RATE)
+	{
+		DisplayMessage(L"\nVerify: only %dHz signal can be verified", SAMPLE_RATE);
+		return false;
+	}
+
+	l_bits_per_sample = in_bits_per_sample;
+	l_one_bit = in_one_bit;
+	l_write_index = 0;
+	l_read_index = 0;
+	l_write_block_acquired = false;
+	l_load_status = LS_Unknown;
+
+	// set filter
+	if(in_filter_type == FT_Auto)
+		in_filter_type = FT_Strong;
+
+	// decoder is created from this thread because of the shared filter design cache
+	l_decoder = TDCreate(in_filter_type, g_decimation_factor);
+	l_queue = (SampleBlockType*)malloc(LV_QUEUE_LENGTH * sizeof(SampleBlockType));
+	l_free_blocks = CreateSemaphore(NULL, LV_QUEUE_LENGTH, LV_QUEUE_LENGTH, NULL);
+	l_queued_blocks = CreateSemaphore(NULL, 0, LV_QUEUE_LENGTH, NULL);
+
+	if(l_decoder != NULL && l_queue != NULL && l_free_blocks != NULL && l_queued_blocks != NULL)
+	{
+		TDResetProgram(l_decoder);
+		l_thread = CreateThread(NULL, 0, DecoderThread, NULL, 0, NULL);
+	}
+
+	if(l_thread == NULL)
+	{
+		DisplayMessage(L"\nVerify: can't start the decoder");
+
+		TDDestroy(l_decoder);
+		l_decoder = NULL;
+		free(l_queue);
+		l_queue = NULL;
+		if(l_free_blocks != NULL)
+			CloseHandle(l_free_blocks);
+		if(l_queued_blocks != NULL)
+			CloseHandle(l_queued_blocks);
+		l_free_blocks = NULL;
+		l_queued_blocks = NULL;
+
+		return false;
+	}
+
+	l_active = true;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Passes rendered samples to the decoder thread (waits only when the decoder is far behind the encoder)
+void LVFeedSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	SampleBlockType* block;
+	size_t sample_size = (l_bits_per_sample == 16) ? sizeof(int16_t) : sizeof(uint8_t);
+	size_t length;
+
+	if(!l_active)
+		return;
+
+	while(in_sample_count > 0)
+	{
+		// get next empty block
+		if(!l_write_block_acquired)
+		{
+			WaitForSingleObject(l_free_blocks, INFINITE);
+			l_queue[l_write_index].SampleCount = 0;
+			l_write_block_acquired = true;
+		}
+
+		block = &l_queue[l_write_index];
+
+		length = LV_BLOCK_SAMPLE_COUNT - block->SampleCount;
+		if(length > in_sample_count)
+			length = in_sample_count;
+
+		memcpy(&block->Samples[block->SampleCount * sample_size], in_samples, length * sample_size);
+		block->SampleCount += length;
+		in_samples += length * sample_size;
+		in_sample_count -= length;
+
+		if(block->SampleCount == LV_BLOCK_SAMPLE_COUNT)
+			QueueBlock();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finishes verification: waits for the decoder thread and compares the decoded program with the encoded one. The
+// result of the header block (file name) and the data block (first mismatching byte) is displayed.
+bool LVStop(const char* in_file_name, bool in_header_block, const uint8_t* in_data, int in_data_length)
+{
+	bool success = true;
+	int i;
+
+	if(!l_active)
+		return true;
+
+	// pass the last partial block and the end mark
+	if(l_write_block_acquired && l_queue[l_write_index].SampleCount > 0)
+		QueueBlock();
+
+	if(!l_write_block_acquired)
+		WaitForSingleObject(l_free_blocks, INFINITE);
+
+	l_queue[l_write_index].SampleCount = 0;
+	QueueBlock();
+
+	WaitForSingleObject(l_thread, INFINITE);
+
+	CloseHandle(l_thread);
+	CloseHandle(l_free_blocks);
+	CloseHandle(l_queued_blocks);
+	TDDestroy(l_decoder);
+	free(l_queue);
+	l_thread = NULL;
+	l_free_blocks = NULL;
+	l_queued_blocks = NULL;
+	l_decoder = NULL;
+	l_queue = NULL;
+	l_active = false;
+
+	// compare results
+	if(l_load_status == LS_Unknown)
+	{
+		DisplayMessage(L"\nVerify: no program was decoded from the signal");
+		return false;
+	}
+
+	if(in_header_block)
+	{
+		if(strcmp(l_program.FileName, in_file_name) == 0)
+		{
+			DisplayMessage(L"\nVerify: header block OK");
+		}
+		else
+		{
+			DisplayMessage(L"\nVerify: header block mismatch (file name)");
+			success = false;
+		}
+	}
+
+	for(i = 0; i < in_data_length && i < l_program.BufferIndex; i++)
+	{
+		if(l_program.Buffer[i] != in_data[i])
+			break;
+	}
+
+	if(i < in_data_length)
+	{
+		if(i < l_program.BufferIndex)
+			DisplayMessage(L"\nVerify: data block mismatch at byte %d", i);
+		else
+			DisplayMessage(L"\nVerify: data block ends at byte %d (signal lost)", i);
+
+		success = false;
+	}
+	else
+	{
+		if(l_load_status != LS_Success || l_program.CRCErrorDetected)
+		{
+			DisplayMessage(L"\nVerify: data block CRC error");
+			success = false;
+		}
+		else
+		{
+			DisplayMessage(L"\nVerify: data block OK (%d bytes)", in_data_length);
+		}
+	}
+
+	return success;
+}
+
+/*****************************************************************************/
+/* Local functions                                                           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Passes the current block to the decoder thread
+static void QueueBlock(void)
+{
+	l_write_index = (l_write_index + 1) % LV_QUEUE_LENGTH;
+	l_write_block_acquired = false;
+
+	ReleaseSemaphore(l_queued_blocks, 1, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoder thread: decodes the queued blocks until the end mark
+static DWORD WINAPI DecoderThread(LPVOID in_parameter)
+{
+	int32_t samples[LV_BLOCK_SAMPLE_COUNT];
+	SampleBlockType* block;
+	size_t sample_count;
+
+	while(true)
+	{
+		WaitForSingleObject(l_queued_blocks, INFINITE);
+
+		block = &l_queue[l_read_index];
+		sample_count = block->SampleCount;
+
+		if(sample_count > 0)
+			ConvertSamples(block, samples);
+
+		l_read_index = (l_read_index + 1) % LV_QUEUE_LENGTH;
+		ReleaseSemaphore(l_free_blocks, 1, NULL);
+
+		if(sample_count == 0)
+			break;
+
+		DecodeSamples(samples, sample_count);
+	}
+
+	// push silence through the filter to get its delayed samples
+	while(TDFlush(l_decoder) > 0)
+		DecodeSamples(NULL, 0);
+
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts rendered samples in the same way as the wave file reader converts the samples of the written file
+static void ConvertSamples(const SampleBlockType* in_block, int32_t* out_samples)
+{
+	const int16_t* word_samples = (const int16_t*)in_block->Samples;
+	size_t i;
+
+	if(l_bits_per_sample == 16)
+	{
+		for(i = 0; i < in_block->SampleCount; i++)
+			out_samples[i] = word_samples[i];
+	}
+	else
+	{
+		if(l_one_bit)
+		{
+			for(i = 0; i < in_block->SampleCount; i++)
+				out_samples[i] = (in_block->Samples[i] > BYTE_SAMPLE_ZERO_VALUE) ? MAXINT16 : MININT16;
+		}
+		else
+		{
+			for(i = 0; i < in_block->SampleCount; i++)
+				out_samples[i] = ((int32_t)in_block->Samples[i] - BYTE_SAMPLE_ZERO_VALUE) * 256;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Feeds samples to the decoder and decodes all of them (the samples already fed to the decoder are decoded as well)
+static void DecodeSamples(const int32_t* in_samples, size_t in_sample_count)
+{
+	size_t pos = 0;
+
+	while(pos < in_sample_count || l_decoder->ProcessedBlockPos < l_decoder->ProcessedBlockLength)
+	{
+		if(l_decoder->ProcessedBlockPos >= l_decoder->ProcessedBlockLength)
+			pos += TDFeedSamples(l_decoder, &in_samples[pos], in_sample_count - pos);
+
+		StoreResult(TDPoll(l_decoder));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores the first decoded program
+static void StoreResult(LoadStatus in_load_status)
+{
+	if(in_load_status == LS_Unknown || l_load_status != LS_Unknown)
+		return;
+
+	l_load_status = in_load_status;
+	memcpy(&l_program, &l_decoder->Reader.Program, sizeof(TDProgramType));
+}
@@ -36,6 +36,9 @@
 #include "WaveFile.h"
 #include "COMPort.h"
 #include "ROMLoader.h"
+#include "ThreadPool.h"
+#include "TapeDecoder.h"
+#include "CRC.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Types
@@ -45,8 +48,11 @@
 static void CloseInputFileList(void);
 static bool ParseWaveGenerationParameters(wchar_t* in_param);
 static bool ParseWavePreprocessingParameters(wchar_t* in_param);
+static bool ParseWaveFormatParameters(wchar_t* in_param);
+static bool ParseInputPosition(wchar_t* in_param, uint32_t* out_sample_index);
 static bool ProcessCommandLine(int argc, wchar_t **argv);
 static void UpdateStoredFilename(void);
+static void DisplayTapeLength(void);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
@@ -65,6 +71,9 @@ int g_forced_copyprotect = COPYPROTECT_NOT_FORCED;
 bool g_overwrite_output_file = false;
 bool g_stop_after_one_file = false;
 bool g_one_bit_wave_file = false;
+uint32_t g_wave_sample_rate = SAMPLE_RATE;
+uint8_t g_wave_bits_per_sample = 8;
+int g_wave_interpolation = 0;
 bool g_exclude_basic_program = false;
 uint16_t g_lomem_address = 6639;
 uint16_t g_checksum_start = 0;
@@ -78,6 +87,8 @@ int g_binary_divide_position = -1;
 // Module global variables
 static FILE* l_output_file_name_list = NULL;
 static FILE* l_input_file_name_list = NULL;
+static bool l_run_benchmark = false;
+static bool l_run_self_test = false;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Main function
@@ -94,6 +105,7 @@ int wmain( int argc, wchar_t **argv )
 	ConsoleInit();
 	BASInit();
 	COMInit();
+	CRCInit();
 	g_output_wave_file[0] = '\0';
 	g_input_file_name[0] = '\0';
 	g_output_file_name[0] = '\0';
@@ -109,6 +121,24 @@ int wmain( int argc, wchar_t **argv )
 	if(!success)
 		return 1;
 
+	// run filter benchmark
+	if(l_run_benchmark)
+	{
+		if(WFBenchmark())
+			return 0;
+		else
+			return 1;
+	}
+
+	// run self test
+	if(l_run_self_test)
+	{
+		if(CRCSelfTest())
+			return 0;
+		else
+			return 1;
+	}
+
 	// check input file
 	if(success)
 	{
@@ -304,6 +334,58 @@ int wmain( int argc, wchar_t **argv )
 				return 1;
 			}
 
+			// check --catalog switch
+			if(g_catalog_mode && g_input_file_type != FT_WAV)
+			{
+				DisplayError(L"Error: The --catalog switch can be used only with wav input.\n");
+				return 1;
+			}
+
+			// check --program switch
+			if(g_indexed_program > 0 && g_input_file_type != FT_WAV)
+			{
+				DisplayError(L"Error: The --program switch can be used only with wav input.\n");
+				return 1;
+			}
+
+			// check --start and --end switches
+			if(g_input_wav_start_sample > 0 || g_input_wav_end_sample > 0)
+			{
+				if(g_input_file_type != FT_WAV)
+				{
+					DisplayError(L"Error: The --start and --end switches can be used only with wav input.\n");
+					return 1;
+				}
+
+				if(g_input_wav_end_sample > 0 && g_input_wav_end_sample <= g_input_wav_start_sample)
+				{
+					DisplayError(L"Error: The end position must be behind the start position.\n");
+					return 1;
+				}
+
+				if(g_indexed_program > 0)
+				{
+					DisplayError(L"Error: The --program switch can't be used together with --start or --end.\n");
+					return 1;
+				}
+			}
+
+			// check --resume switch
+			if(g_resume_decoding)
+			{
+				if(g_input_file_type != FT_WAV)
+				{
+					DisplayError(L"Error: The --resume switch can be used only with wav input.\n");
+					return 1;
+				}
+
+				if(g_catalog_mode || g_indexed_program > 0 || g_input_wav_start_sample > 0 || g_input_wav_end_sample > 0)
+				{
+					DisplayError(L"Error: The --resume switch can't be used together with --catalog, --program, --start or --end.\n");
+					return 1;
+				}
+			}
+
 			// Load input file
 			switch(g_input_file_type)
 			{
@@ -366,7 +448,7 @@ int wmain( int argc, wchar_t **argv )
 		// open debug wave out file
 		if(g_output_wave_file[0] != '\0')
 		{
-			WFOpenOutput(g_output_wave_file, 16);
+			WFOpenOutput(g_output_wave_file, 16, SAMPLE_RATE / g_decimation_factor);
 		}
 
 		// display error
@@ -385,7 +467,10 @@ int wmain( int argc, wchar_t **argv )
 				{
 					case FT_WAV:
 					case FT_WaveInOut:
-						load_status = TAPELoad();
+						if(g_catalog_mode)
+							load_status = TAPECatalog();
+						else
+							load_status = TAPELoad();
 						break;
 
 					case FT_TTP:
@@ -531,18 +616,21 @@ int wmain( int argc, wchar_t **argv )
 
 						// WAV
 						case FT_WAV:
+							UpdateStoredFilename();
 							if(l_input_file_name_list == NULL)
 							{
 								DisplayMessage(L"Saving WAV file: %s", output_file_name);
+								DisplayTapeLength();
 							}
-							UpdateStoredFilename();
 							success = TAPESave(output_file_name);
 							break;
 
 						// Wave Out
 						case FT_WaveInOut:
-							DisplayMessage(L"Generating tape signal. Press <ESC> to stop.\n");
 							UpdateStoredFilename();
+							DisplayMessage(L"Generating tape signal");
+							DisplayTapeLength();
+							DisplayMessage(L". Press <ESC> to stop.\n");
 							success = TAPESave(output_file_name);
 							break;
 
@@ -583,6 +671,10 @@ int wmain( int argc, wchar_t **argv )
 
 					if(l_input_file_name_list == NULL)
 						DisplayMessage(L"\n");
+
+					// saved programs are not loaded again when the decoding is resumed
+					if(success && g_input_file_type == FT_WAV)
+						TAPEProgramSaved(output_file_name);
 				}
 			}
 			else
@@ -669,6 +761,18 @@ static void UpdateStoredFilename(void)
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Displays length of the tape signal of the current program
+static void DisplayTapeLength(void)
+{
+	TAPEEstimateType estimate;
+
+	if(!TAPEEstimate(&estimate))
+		return;
+
+	DisplayMessage(L" (%um%02u.%03us, %u samples)", estimate.Duration / 60000, (estimate.Duration / 1000) % 60, estimate.Duration % 1000, estimate.SampleCount);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Parses wave generation parameters
 static bool ParseWaveGenerationParameters(wchar_t* in_param)
@@ -708,6 +812,34 @@ static bool ParseWaveGenerationParameters(wchar_t* in_param)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Parses input position given in seconds (fractions are allowed) or in samples (with 'smp' suffix)
+static bool ParseInputPosition(wchar_t* in_param, uint32_t* out_sample_index)
+{
+	wchar_t* end;
+	double seconds;
+
+	seconds = wcstod(in_param, &end);
+	if(end == in_param || seconds < 0)
+		return false;
+
+	// position in seconds
+	if(*end == '\0')
+	{
+		if(seconds * SAMPLE_RATE >= 4294967295.0)
+			return false;
+
+		*out_sample_index = (uint32_t)(seconds * SAMPLE_RATE + 0.5);
+
+		return true;
+	}
+
+	// position in samples
+	*out_sample_index = (uint32_t)wcstoul(in_param, &end, 10);
+
+	return _wcsicmp(end, L"smp") == 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Parses wave preprocessing parameters
 static bool ParseWavePreprocessingParameters(wchar_t* in_param)
@@ -720,7 +852,7 @@ static bool ParseWavePreprocessingParameters(wchar_t* in_param)
 	token = wcstok( in_param, L",", &buffer ); 
 
 	index = 0;
-	while( token != NULL && index < 3 )
+	while( token != NULL && index < 5 )
   {												
 		value = _wtoi(token);
 
@@ -733,6 +865,83 @@ static bool ParseWavePreprocessingParameters(wchar_t* in_param)
 			case 1:
 				g_wave_level_control_mode = value;
 				break;
+
+			case 2:
+				// zero keeps the default length
+				if(value == 0)
+					break;
+
+				if(value < WF_SHARP_FILTER_MIN_TAP_COUNT || value > WF_SHARP_FILTER_MAX_TAP_COUNT)
+					return false;
+
+				g_sharp_filter_tap_count = (uint16_t)value;
+				break;
+
+			case 3:
+				if(value <= 0 || value >= SAMPLE_RATE / 2)
+					return false;
+
+				g_filter_low_cutoff_frequency = (uint16_t)value;
+				break;
+
+			case 4:
+				if(value <= g_filter_low_cutoff_frequency || value >= SAMPLE_RATE / 2)
+					return false;
+
+				g_filter_high_cutoff_frequency = (uint16_t)value;
+				break;
+		}
+
+    // Get next token: 
+		token = wcstok( NULL, L",", &buffer );
+		index++;
+  }
+
+	// both band edges must be specified
+	if(g_filter_low_cutoff_frequency != 0 && g_filter_high_cutoff_frequency == 0)
+		return false;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Parses wave output format parameters
+static bool ParseWaveFormatParameters(wchar_t* in_param)
+{
+	wchar_t* token;
+	wchar_t* buffer;
+	int index;
+	int value;
+
+	token = wcstok( in_param, L",", &buffer ); 
+
+	index = 0;
+	while( token != NULL && index < 3 )
+  {												
+		value = _wtoi(token);
+
+		switch (index)
+		{
+			case 0:
+				if(value != 44100 && value != 48000 && value != 96000)
+					return false;
+
+				g_wave_sample_rate = value;
+				break;
+
+			case 1:
+				if(value != 8 && value != 16)
+					return false;
+
+				g_wave_bits_per_sample = (uint8_t)value;
+				break;
+
+			case 2:
+				if(value < 0 || value > 2)
+					return false;
+
+				g_wave_interpolation = value;
+				break;
 		}
 
     // Get next token: 
@@ -748,6 +957,7 @@ static bool ParseWavePreprocessingParameters(wchar_t* in_param)
 static bool ProcessCommandLine(int argc, wchar_t **argv)
 {
 	int i;
+	int value;
 	bool success = true;
 	wchar_t* buffer;
 
@@ -1033,6 +1243,105 @@ static bool ProcessCommandLine(int argc, wchar_t **argv)
 					}	
 					break;
 
+				// long options
+				case '-':
+					if(_wcsicmp(argv[i], L"--benchmark") == 0)
+					{
+						l_run_benchmark = true;
+					}
+					else if(_wcsnicmp(argv[i], L"--wave=", 7) == 0)
+					{
+						if(!ParseWaveFormatParameters(&argv[i][7]))
+						{
+							DisplayError(L"Error: Invalid wave format: %s\n", argv[i]);
+							return false;
+						}
+					}
+					else if(_wcsicmp(argv[i], L"--selftest") == 0)
+					{
+						l_run_self_test = true;
+					}
+					else if(_wcsicmp(argv[i], L"--verify") == 0)
+					{
+						g_verify_output = true;
+					}
+					else if(_wcsicmp(argv[i], L"--parallel") == 0)
+					{
+						g_thread_count = TPGetProcessorCount();
+					}
+					else if(_wcsnicmp(argv[i], L"--parallel=", 11) == 0)
+					{
+						g_thread_count = _wtoi(&argv[i][11]);
+						if(g_thread_count < 1 || g_thread_count > TP_MAX_THREAD_COUNT)
+						{
+							DisplayError(L"Error: Invalid thread count: %s\n", argv[i]);
+							return false;
+						}
+					}
+					else if(_wcsicmp(argv[i], L"--catalog") == 0)
+					{
+						g_catalog_mode = true;
+					}
+					else if(_wcsicmp(argv[i], L"--gate") == 0)
+					{
+						g_signal_gate = true;
+					}
+					else if(_wcsicmp(argv[i], L"--channels") == 0)
+					{
+						g_channel_decoding = true;
+					}
+					else if(_wcsicmp(argv[i], L"--polarity") == 0)
+					{
+						g_dual_polarity = true;
+					}
+					else if(_wcsicmp(argv[i], L"--resume") == 0)
+					{
+						// programs saved before the checkpoint stay in the container output file
+						g_resume_decoding = true;
+						g_append_container_files = true;
+					}
+					else if(_wcsnicmp(argv[i], L"--start=", 8) == 0)
+					{
+						if(!ParseInputPosition(&argv[i][8], &g_input_wav_start_sample))
+						{
+							DisplayError(L"Error: Invalid start position: %s\n", argv[i]);
+							return false;
+						}
+					}
+					else if(_wcsnicmp(argv[i], L"--end=", 6) == 0)
+					{
+						if(!ParseInputPosition(&argv[i][6], &g_input_wav_end_sample) || g_input_wav_end_sample == 0)
+						{
+							DisplayError(L"Error: Invalid end position: %s\n", argv[i]);
+							return false;
+						}
+					}
+					else if(_wcsnicmp(argv[i], L"--program=", 10) == 0)
+					{
+						g_indexed_program = _wtoi(&argv[i][10]);
+						if(g_indexed_program < 1)
+						{
+							DisplayError(L"Error: Invalid program number: %s\n", argv[i]);
+							return false;
+						}
+					}
+					else if(_wcsnicmp(argv[i], L"--decimate=", 11) == 0)
+					{
+						value = _wtoi(&argv[i][11]);
+						if(value < 1 || value > DM_MAX_FACTOR)
+						{
+							DisplayError(L"Error: Invalid decimation factor: %s\n", argv[i]);
+							return false;
+						}
+						g_decimation_factor = (uint8_t)value;
+					}
+					else
+					{
+						DisplayError(L"Error: Unknown flag: %s\n", argv[i]);
+						return false;
+					}
+					break;
+
 				default:
 					DisplayError(L"Error: Unknown flag: -%c\n", argv[i][1]);
 					return false;
@@ -0,0 +1,608 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Parallel decoder (decodes segments of the wav file on multiple threads)   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include "ParallelDecoder.h"
+#include "ThreadPool.h"
+#include "WaveFile.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define INPUT_SILENCE_SAMPLE_COUNT 32		// silence appended by the wave file reader after the last sample
+#define LEVEL_HISTOGRAM_SHIFT 7
+#define LEVEL_HISTOGRAM_LENGTH ((32768 >> LEVEL_HISTOGRAM_SHIFT) + 1)
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Energy scan job
+typedef struct
+{
+	uint16_t* Levels;								// average absolute sample value of the windows
+	uint32_t FirstWindow;
+	uint32_t WindowCount;
+} ScanJobType;
+
+// Decoder job (one segment of the input)
+typedef struct
+{
+	TapeDecoderType* Decoder;
+	uint32_t StartSample;						// decoding starts here (in the middle of a silent gap)
+	uint32_t EndSample;							// nominal end of the segment, decoding continues until the first idle gap behind it
+	const uint32_t* Gaps;						// middle of all silent gaps of the input
+	int GapCount;
+	uint32_t StopSample;						// position where the decoding was stopped
+	PDResultType* Results;
+	int ResultCount;
+	int ResultCapacity;
+	bool OutOfMemory;
+	char FileName[DB_MAX_FILENAME_LENGTH+1];	// file name and autostart of the decoder at the stop position
+	bool Autostart;
+	bool FileNameReceived;
+	bool AutostartReceived;
+	uint32_t SkippedSampleCount;		// number of samples of the segment skipped by the signal gate
+	int Channel;										// decoded channel (1 based, WF_MIXED_CHANNELS - average of the channels)
+} SegmentType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static void ScanWindows(void* in_job);
+static uint32_t* FindGaps(int in_thread_count, int* out_gap_count);
+static void DecodeSegment(void* in_job);
+static bool IsDecoderIdle(TapeDecoderType* in_decoder);
+static void StoreResult(SegmentType* in_segment, LoadStatus in_load_status, uint32_t in_sample_position, uint32_t in_block_position);
+static bool IsSameProgram(const PDResultType* in_result1, const PDResultType* in_result2);
+static int GetResultQuality(const PDResultType* in_result);
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes the whole (mapped) wave input file. The input is divided into segments at the silent gaps before the
+// block leadings, segments are decoded in parallel and the results are merged in tape order. Every segment is decoded
+// until the first gap behind its end where its decoder is idle, programs finished before this point are dropped from
+// the next segment. File name and autostart flag of the programs not having their own header block in the segment
+// are taken from the previous segments, so the results are the same as the results of the sequential decoding.
+// Returns the array of the decoded programs (must be released by free) or NULL when there is not enough memory.
+// Skipped sample count is the number of samples skipped by the signal gates of the segment decoders.
+PDResultType* PDDecode(FilterTypes in_filter_type, int in_thread_count, int* out_result_count, uint32_t* out_skipped_sample_count)
+{
+	SegmentType* segments = NULL;
+	PDResultType* results = NULL;
+	PDResultType* result;
+	uint32_t* gaps;
+	int gap_count;
+	int segment_count;
+	int segment_index;
+	int result_count;
+	uint32_t segment_length;
+	uint32_t covered_sample_count;
+	char file_name[DB_MAX_FILENAME_LENGTH+1];
+	bool autostart;
+	bool success = true;
+	int i;
+
+	*out_result_count = 0;
+	*out_skipped_sample_count = 0;
+
+	// find silent gaps
+	gaps = FindGaps(in_thread_count, &gap_count);
+	if(gaps == NULL)
+		return NULL;
+
+	// create segments (decoders are created from this thread because of the shared filter design cache)
+	segment_length = g_input_wav_file_sample_count / (in_thread_count * PD_SEGMENTS_PER_THREAD);
+	if(segment_length < PD_MIN_SEGMENT_LENGTH)
+		segment_length = PD_MIN_SEGMENT_LENGTH;
+
+	segments = (SegmentType*)calloc(gap_count + 1, sizeof(SegmentType));
+	if(segments == NULL)
+		success = false;
+
+	segment_count = 0;
+	for(i = 0; i <= gap_count && success; i++)
+	{
+		if(i < gap_count && gaps[i] - segments[segment_count].StartSample < segment_length)
+			continue;
+
+		segments[segment_count].EndSample = (i < gap_count) ? gaps[i] : g_input_wav_file_sample_count + INPUT_SILENCE_SAMPLE_COUNT;
+		segments[segment_count].Gaps = gaps;
+		segments[segment_count].GapCount = gap_count;
+		segments[segment_count].Decoder = TDCreate(in_filter_type, g_decimation_factor);
+		if(segments[segment_count].Decoder == NULL)
+			success = false;
+
+		segment_count++;
+		if(i < gap_count)
+			segments[segment_count].StartSample = gaps[i];
+	}
+
+	// decode segments
+	if(success)
+	{
+		TPRunJobs(DecodeSegment, segments, sizeof(SegmentType), segment_count, in_thread_count);
+
+		result_count = 0;
+		for(segment_index = 0; segment_index < segment_count; segment_index++)
+		{
+			result_count += segments[segment_index].ResultCount;
+			*out_skipped_sample_count += segments[segment_index].SkippedSampleCount;
+			if(segments[segment_index].OutOfMemory)
+				success = false;
+		}
+
+		// one more item to avoid zero length allocation
+		results = (PDResultType*)malloc((result_count + 1) * sizeof(PDResultType));
+		if(results == NULL)
+			success = false;
+	}
+
+	// merge results in tape order
+	if(success)
+	{
+		covered_sample_count = 0;
+		file_name[0] = '\0';
+		autostart = false;
+
+		for(segment_index = 0; segment_index < segment_count; segment_index++)
+		{
+			// segment was entirely decoded by the previous segments
+			if(segment_index > 0 && segments[segment_index].StopSample <= covered_sample_count)
+				continue;
+
+			for(i = 0; i < segments[segment_index].ResultCount; i++)
+			{
+				result = &segments[segment_index].Results[i];
+
+				// program was already decoded by the previous segment
+				if(segment_index > 0 && result->SamplePosition <= covered_sample_count)
+					continue;
+
+				// file name and autostart flag which were not loaded by this segment
+				if(!result->FileNameReceived)
+					strcpy(result->Program.FileName, file_name);
+
+				if(!result->AutostartReceived)
+					result->Program.Autostart = autostart;
+
+				memcpy(&results[*out_result_count], result, sizeof(PDResultType));
+				(*out_result_count)++;
+			}
+
+			// file name and autostart flag at the stop position
+			if(!segments[segment_index].FileNameReceived)
+				strcpy(segments[segment_index].FileName, file_name);
+			strcpy(file_name, segments[segment_index].FileName);
+
+			if(!segments[segment_index].AutostartReceived)
+				segments[segment_index].Autostart = autostart;
+			autostart = segments[segment_index].Autostart;
+
+			if(segments[segment_index].StopSample > covered_sample_count)
+				covered_sample_count = segments[segment_index].StopSample;
+		}
+	}
+
+	// release segments
+	if(segments != NULL)
+	{
+		for(segment_index = 0; segment_index < gap_count + 1; segment_index++)
+		{
+			TDDestroy(segments[segment_index].Decoder);
+			free(segments[segment_index].Results);
+		}
+		free(segments);
+	}
+	free(gaps);
+
+	if(!success)
+	{
+		free(results);
+		*out_result_count = 0;
+		return NULL;
+	}
+
+	return results;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes every channel of the whole (mapped) wave input file on its own thread, every channel has its own filter,
+// level control and decoder. The results are merged in tape order: copies of the same program decoded from different
+// channels (loaded from the same block position) are merged into one result using the best copy (CRC-clean copy is
+// preferred), programs found only on one channel are kept. Returns the array of the decoded programs (must be
+// released by free) or NULL when there is not enough memory. Skipped sample count is the average number of samples
+// skipped by the signal gates of the channels.
+PDResultType* PDDecodeChannels(FilterTypes in_filter_type, int* out_result_count, uint32_t* out_skipped_sample_count)
+{
+	SegmentType* segments;
+	PDResultType* results = NULL;
+	PDResultType* best;
+	PDResultType* copy;
+	int result_indices[WF_MAX_CHANNEL_COUNT];
+	int channel_count = WFGetInputChannelCount();
+	int first_channel;
+	int channel;
+	int result_count;
+	bool success = true;
+
+	*out_result_count = 0;
+	*out_skipped_sample_count = 0;
+
+	// one segment per channel covering the whole input (decoders are created from this thread because of the shared
+	// filter design cache)
+	segments = (SegmentType*)calloc(channel_count, sizeof(SegmentType));
+	if(segments == NULL)
+		return NULL;
+
+	for(channel = 0; channel < channel_count && success; channel++)
+	{
+		segments[channel].Channel = channel + 1;
+		segments[channel].EndSample = g_input_wav_file_sample_count + INPUT_SILENCE_SAMPLE_COUNT;
+		segments[channel].Decoder = TDCreate(in_filter_type, g_decimation_factor);
+		if(segments[channel].Decoder == NULL)
+			success = false;
+	}
+
+	// decode channels
+	if(success)
+	{
+		TPRunJobs(DecodeSegment, segments, sizeof(SegmentType), channel_count, channel_count);
+
+		result_count = 0;
+		for(channel = 0; channel < channel_count; channel++)
+		{
+			result_count += segments[channel].ResultCount;
+			*out_skipped_sample_count += segments[channel].SkippedSampleCount / channel_count;
+			if(segments[channel].OutOfMemory)
+				success = false;
+		}
+
+		// one more item to avoid zero length allocation
+		results = (PDResultType*)malloc((result_count + 1) * sizeof(PDResultType));
+		if(results == NULL)
+			success = false;
+	}
+
+	// merge results in tape order
+	if(success)
+	{
+		memset(result_indices, 0, sizeof(result_indices));
+
+		while(true)
+		{
+			// earliest remaining program of the channels
+			first_channel = -1;
+			for(channel = 0; channel < channel_count; channel++)
+			{
+				if(result_indices[channel] >= segments[channel].ResultCount)
+					continue;
+
+				if(first_channel < 0 || segments[channel].Results[result_indices[channel]].BlockPosition < segments[first_channel].Results[result_indices[first_channel]].BlockPosition)
+					first_channel = channel;
+			}
+
+			if(first_channel < 0)
+				break;
+
+			best = &segments[first_channel].Results[result_indices[first_channel]++];
+
+			// copies of the program decoded from the other channels
+			for(channel = 0; channel < channel_count; channel++)
+			{
+				if(channel == first_channel || result_indices[channel] >= segments[channel].ResultCount)
+					continue;
+
+				copy = &segments[channel].Results[result_indices[channel]];
+				if(IsSameProgram(best, copy))
+				{
+					result_indices[channel]++;
+
+					if(GetResultQuality(copy) > GetResultQuality(best))
+						best = copy;
+				}
+			}
+
+			memcpy(&results[*out_result_count], best, sizeof(PDResultType));
+			(*out_result_count)++;
+		}
+	}
+
+	// release segments
+	for(channel = 0; channel < channel_count; channel++)
+	{
+		TDDestroy(segments[channel].Decoder);
+		free(segments[channel].Results);
+	}
+	free(segments);
+
+	if(!success)
+	{
+		free(results);
+		*out_result_count = 0;
+		return NULL;
+	}
+
+	return results;
+}
+
+/*****************************************************************************/
+/* Local functions                                                           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Measures average absolute sample value of the windows of a scan job
+static void ScanWindows(void* in_job)
+{
+	ScanJobType* job = (ScanJobType*)in_job;
+	int32_t samples[PD_SCAN_WINDOW_LENGTH];
+	uint32_t window;
+	size_t sample_count;
+	uint32_t sum;
+	size_t i;
+
+	for(window = job->FirstWindow; window < job->FirstWindow + job->WindowCount; window++)
+	{
+		sample_count = WFReadSamplesAt(window * PD_SCAN_WINDOW_LENGTH, WF_MIXED_CHANNELS, samples, PD_SCAN_WINDOW_LENGTH);
+
+		sum = 0;
+		for(i = 0; i < sample_count; i++)
+			sum += (samples[i] < 0) ? -samples[i] : samples[i];
+
+		job->Levels[window] = (uint16_t)((sample_count > 0) ? sum / sample_count : 0);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the silent gaps of the input by measuring the signal energy. Returns the array of the sample positions of the
+// middle of the gaps (must be released by free) or NULL when there is not enough memory.
+static uint32_t* FindGaps(int in_thread_count, int* out_gap_count)
+{
+	uint32_t histogram[LEVEL_HISTOGRAM_LENGTH];
+	uint32_t window_count;
+	uint16_t* levels;
+	ScanJobType* jobs;
+	int job_count;
+	uint32_t* gaps;
+	uint32_t level_count;
+	uint32_t silence_level;
+	uint32_t gap_start;
+	uint32_t window;
+	int i;
+
+	*out_gap_count = 0;
+
+	window_count = (g_input_wav_file_sample_count + PD_SCAN_WINDOW_LENGTH - 1) / PD_SCAN_WINDOW_LENGTH;
+	job_count = (int)((window_count + PD_SCAN_JOB_WINDOW_COUNT - 1) / PD_SCAN_JOB_WINDOW_COUNT);
+
+	levels = (uint16_t*)malloc((window_count + 1) * sizeof(uint16_t));
+	jobs = (ScanJobType*)malloc((job_count + 1) * sizeof(ScanJobType));
+	gaps = (uint32_t*)malloc((window_count / PD_MIN_GAP_WINDOW_COUNT + 1) * sizeof(uint32_t));
+	if(levels == NULL || jobs == NULL || gaps == NULL)
+	{
+		free(levels);
+		free(jobs);
+		free(gaps);
+		return NULL;
+	}
+
+	// measure window levels
+	for(i = 0; i < job_count; i++)
+	{
+		jobs[i].Levels = levels;
+		jobs[i].FirstWindow = i * PD_SCAN_JOB_WINDOW_COUNT;
+		jobs[i].WindowCount = window_count - jobs[i].FirstWindow;
+		if(jobs[i].WindowCount > PD_SCAN_JOB_WINDOW_COUNT)
+			jobs[i].WindowCount = PD_SCAN_JOB_WINDOW_COUNT;
+	}
+
+	TPRunJobs(ScanWindows, jobs, sizeof(ScanJobType), job_count, in_thread_count);
+	free(jobs);
+
+	// determine signal level from the histogram of the window levels
+	memset(histogram, 0, sizeof(histogram));
+	for(window = 0; window < window_count; window++)
+		histogram[levels[window] >> LEVEL_HISTOGRAM_SHIFT]++;
+
+	level_count = 0;
+	for(i = 0; i < LEVEL_HISTOGRAM_LENGTH - 1; i++)
+	{
+		level_count += histogram[i];
+		if((uint64_t)level_count * 100 >= (uint64_t)window_count * PD_SIGNAL_LEVEL_PERCENTILE)
+			break;
+	}
+
+	silence_level = (((uint32_t)i + 1) << LEVEL_HISTOGRAM_SHIFT) / PD_SILENCE_LEVEL_DIVISOR;
+
+	// find gaps
+	gap_start = 0;
+	for(window = 0; window <= window_count; window++)
+	{
+		if(window < window_count && levels[window] < silence_level)
+			continue;
+
+		if(window - gap_start >= PD_MIN_GAP_WINDOW_COUNT)
+			gaps[(*out_gap_count)++] = (gap_start + window) / 2 * PD_SCAN_WINDOW_LENGTH;
+
+		gap_start = window + 1;
+	}
+
+	free(levels);
+
+	return gaps;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes one segment of the input
+static void DecodeSegment(void* in_job)
+{
+	SegmentType* segment = (SegmentType*)in_job;
+	TapeDecoderType* decoder = segment->Decoder;
+	int32_t samples[WAVE_SAMPLE_BLOCK_LENGTH];
+	uint32_t input_length = g_input_wav_file_sample_count + INPUT_SILENCE_SAMPLE_COUNT;
+	uint32_t position = segment->StartSample;
+	uint32_t block_position = segment->StartSample;
+	uint32_t next_position;
+	uint32_t skipped_sample_count;
+	LoadStatus load_status;
+	size_t sample_count;
+	int gap_index;
+
+	// first gap where the decoding can be stopped
+	gap_index = 0;
+	while(gap_index < segment->GapCount && segment->Gaps[gap_index] < segment->EndSample)
+		gap_index++;
+
+	TDResetProgram(decoder);
+
+	while(!segment->OutOfMemory)
+	{
+		// read and process next block of samples
+		if(decoder->ProcessedBlockPos >= decoder->ProcessedBlockLength)
+		{
+			// stop at the first gap behind the end of the segment where no program is being loaded
+			while(gap_index < segment->GapCount && position >= segment->Gaps[gap_index])
+			{
+				if(IsDecoderIdle(decoder))
+					break;
+
+				gap_index++;
+			}
+
+			if(gap_index < segment->GapCount && position >= segment->Gaps[gap_index])
+				break;
+
+			// blocks are ending at the gap positions
+			next_position = (gap_index < segment->GapCount) ? segment->Gaps[gap_index] : input_length;
+			if(next_position - position > WAVE_SAMPLE_BLOCK_LENGTH)
+				next_position = position + WAVE_SAMPLE_BLOCK_LENGTH;
+
+			if(next_position > position)
+			{
+				sample_count = WFReadSamplesAt(position, segment->Channel, samples, next_position - position);
+				skipped_sample_count = decoder->SkippedSampleCount;
+				TDFeedSamples(decoder, samples, sample_count);
+
+				// skipped input behind the end is counted by the next segment
+				if(position < segment->EndSample)
+					segment->SkippedSampleCount += decoder->SkippedSampleCount - skipped_sample_count;
+
+				position = next_position;
+			}
+			else
+			{
+				// end of the input
+				if(TDFlush(decoder) == 0)
+					break;
+			}
+		}
+
+		// decode
+		load_status = TDPoll(decoder);
+		if(load_status != LS_Unknown)
+			StoreResult(segment, load_status, position - (uint32_t)((decoder->ProcessedBlockLength - decoder->ProcessedBlockPos) * decoder->SampleLength / OVERSAMPLING_RATE), block_position);
+
+		// blocks are starting after the last position where the reader was idle
+		if(decoder->Reader.ReaderStatus == TRST_Idle)
+			block_position = position;
+	}
+
+	// store decoder state at the stop position
+	segment->StopSample = position;
+	strcpy(segment->FileName, decoder->Reader.Program.FileName);
+	segment->Autostart = decoder->Reader.Program.Autostart;
+	segment->FileNameReceived = decoder->Reader.FileNameReceived;
+	segment->AutostartReceived = decoder->Reader.AutostartReceived;
+
+	TDDestroy(decoder);
+	segment->Decoder = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true when the decoder is not loading any program
+static bool IsDecoderIdle(TapeDecoderType* in_decoder)
+{
+	return (in_decoder->Reader.DecoderState == DST_Idle || in_decoder->Reader.DecoderState == DST_WaitingForLeading) &&
+		in_decoder->Reader.ReaderStatus == TRST_Idle && !in_decoder->Reader.HeaderBlockValid;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores decoded program (partial program is kept in the same way as the sequential loader does)
+static void StoreResult(SegmentType* in_segment, LoadStatus in_load_status, uint32_t in_sample_position, uint32_t in_block_position)
+{
+	TapeDecoderType* decoder = in_segment->Decoder;
+	PDResultType* result;
+	PDResultType* results;
+	int capacity;
+
+	// grow result array
+	if(in_segment->ResultCount >= in_segment->ResultCapacity)
+	{
+		capacity = (in_segment->ResultCapacity == 0) ? 4 : in_segment->ResultCapacity * 2;
+		results = (PDResultType*)realloc(in_segment->Results, capacity * sizeof(PDResultType));
+		if(results == NULL)
+		{
+			in_segment->OutOfMemory = true;
+			return;
+		}
+
+		in_segment->Results = results;
+		in_segment->ResultCapacity = capacity;
+	}
+
+	result = &in_segment->Results[in_segment->ResultCount++];
+
+	result->SignalLost = (in_load_status == LS_Error);
+	if(result->SignalLost && TDKeepPartialProgram(decoder))
+		in_load_status = LS_Success;
+
+	result->Status = in_load_status;
+	result->SamplePosition = in_sample_position;
+	result->BlockPosition = in_block_position;
+	result->Channel = in_segment->Channel;
+	result->FileNameReceived = decoder->Reader.FileNameReceived;
+	result->AutostartReceived = decoder->Reader.AutostartReceived;
+	memcpy(&result->Program, &decoder->Reader.Program, sizeof(TDProgramType));
+
+	TDResetProgram(decoder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true when the results of different channels are copies of the same program (they were loaded from the same
+// block position and their length is the same, the length of a failed copy is unknown)
+static bool IsSameProgram(const PDResultType* in_result1, const PDResultType* in_result2)
+{
+	uint32_t distance;
+
+	distance = (in_result1->BlockPosition > in_result2->BlockPosition) ? in_result1->BlockPosition - in_result2->BlockPosition : in_result2->BlockPosition - in_result1->BlockPosition;
+	if(distance > PD_CHANNEL_MATCH_DISTANCE)
+		return false;
+
+	if(in_result1->Status != LS_Success || in_result2->Status != LS_Success)
+		return true;
+
+	return in_result1->Program.BufferLength == in_result2->Program.BufferLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the quality of the decoded program (CRC-clean program is the best, failed program is the worst)
+static int GetResultQuality(const PDResultType* in_result)
+{
+	if(in_result->Status != LS_Success)
+		return 0;
+
+	if(in_result->SignalLost)
+		return 1;
+
+	if(in_result->Program.CRCErrorDetected)
+		return 2;
+
+	return 3;
+}
@@ -12,6 +12,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "DDS.h"
 #include "CRC.h"
@@ -21,7 +22,12 @@
 #include "WaveMapper.h"
 #include "WaveFile.h"
 #include "WaveFilter.h"
-#include "WaveLevelControl.h"
+#include "TapeDecoder.h"
+#include "TapeIndex.h"
+#include "TapeCheckpoint.h"
+#include "ParallelDecoder.h"
+#include "TapeRenderer.h"
+#include "LoopbackVerifier.h"
 #include "Main.h"
 #include "CharMap.h"
 #include "DataBuffer.h"
@@ -29,54 +35,42 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Constants
-#define MIDDLE_PERIOD_BUFFER_LENGTH 256
-#define SYNC_PHASE_MAX_DIFFERENCE 2
-#define SECTOR_END_PERIOD_COUNT 5
 #define DEFAULT_LEADING_LENGTH 4812 // Default leading length in ms (10240period @ 2128Hz)
 #define DEFAULT_GAP_LENGTH 1000 // length of silent gaps before block start in ms
+#define INDEX_PREROLL_LENGTH (TD_PRIMED_LEADING_PERIOD_COUNT * 2 * SAMPLE_RATE / FREQ_LEADING)	// indexed blocks are decoded from this distance before the sync (in samples)
+#define INDEX_LOCK_LENGTH (TD_MIDDLE_PERIOD_BUFFER_LENGTH * SAMPLE_RATE / FREQ_LEADING)	// length of the leading before the decoder locks to it (in samples)
+#define CHECKPOINT_INTERVAL (60 * SAMPLE_RATE)	// checkpoints are saved after this amount of decoded input (in samples)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Types
 
-// Current state of the decoder
-typedef  enum
-{
-	DST_Idle,
-	DST_WaitingForLeading,
-	DST_WaitingForSync,
-	DST_SyncDetected,
-	DST_ReadingData,
-	DST_SectorEnd
-}	DecoderStateType;
-
-// Current state of the tape reader
-typedef enum
-{
-	TRST_Idle,
-	TRST_BlockHeader,
-	TRST_SectorHeader,
-	TRST_HeaderFileNameLength,
-	TRST_HeaderFileName,
-	TRST_HeaderProgramHeader,
-	TRST_SectorEnd,
-	TRST_Data
-} TapeReaderStatusType;
-
-// Signal phase type
-typedef enum
-{
-	SPT_High,
-	SPT_Low
-} SignalPhaseType;
-
 typedef enum
 {
 	BT_Header,
 	BT_Data
 } BlockType;
 
+// Program entry of the catalog
+typedef struct
+{
+	uint32_t HeaderPosition;		// input sample position of the header block
+	uint32_t DataPosition;			// input sample position of the data block
+	bool HeaderFound;
+	bool DataFound;
+	bool HeaderValid;						// CRC of the header block is correct
+	char FileName[DB_MAX_FILENAME_LENGTH+1];
+	uint16_t FileLength;
+	uint8_t SectorCount;
+	bool Autostart;
+	bool CopyProtect;
+} CatalogEntryType;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
+static bool CreateRenderPlan(void);
+static bool EncodeProgram(void);
+static bool EncodeSignal(uint16_t in_frequency, uint16_t in_cycle_count);
+static bool EncodeSilence(uint16_t in_length_in_ms);
 static bool EncodeByte(uint8_t in_data);
 static bool EncodeBlockLeading(BlockType in_block_type);
 static bool EncodeBlock(uint8_t* in_buffer, int in_length);
@@ -84,14 +78,17 @@ static void DisplayOutputHeaderProgress(int in_pos, int in_max_pos);
 static void DisplayOutputDataProgress(int in_pos, int in_max_pos);
 static void DisplayInputDataProgress(void);
 static void DisplayFailedToLoad(void);
-static LoadStatus DecodeSample(int32_t in_sample);
-static LoadStatus DecoderRestart(void);
-static void UpdateMiddleFrequency(uint32_t in_frequency, uint32_t in_measured_period_length);
-static LoadStatus StoreByte(uint8_t in_data_byte);
-static int IntABS(int in_value);
-static bool StoreByteInStruct(uint8_t in_data_byte, void* in_struct, size_t in_size, bool in_add_to_crc);
-static void SetSectorLength(uint8_t in_sector_length);
-static void ChangeReaderStatus(TapeReaderStatusType in_new_status);
+static void DisplaySkippedInput(uint32_t in_skipped_sample_count);
+static void DisplayCatalogEntry(CatalogEntryType* inout_entry, int in_program);
+static void StoreDecodedProgram(void);
+static LoadStatus LoadDecodedProgram(void);
+static void StoreIndexBlock(uint32_t in_leading_position, uint32_t in_sync_position, bool in_header_valid);
+static LoadStatus LoadIndexedProgram(void);
+static LoadStatus DecodeIndexedBlock(int in_block_index);
+static bool ResumeFromCheckpoint(void);
+static bool WarmUpDecoder(uint32_t in_start_position);
+static void SaveCheckpoint(void);
+static void FreeCheckpoint(void);
 static uint16_t OffsetFrequency(uint16_t in_frequency);
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -100,108 +97,152 @@ static uint16_t OffsetFrequency(uint16_t in_frequency);
 // encoder variables
 static uint8_t l_prev_input_percentage;
 static uint32_t l_prev_input_total_seconds;
+static bool l_display_progress = false;
+static TRPlanType* l_render_plan = NULL;								// signal plan of the current program (wav output only)
 
 // decoder variables
-static uint8_t l_data_byte;
-static uint32_t l_data_byte_index;
-static uint8_t l_bit_counter;
-static DecoderStateType l_decoder_state = DST_Idle;
-static TapeReaderStatusType l_tape_reader_status = TRST_Idle;
-static SignalPhaseType l_current_phase = SPT_Low;
-static SignalPhaseType l_phase_mode = SPT_Low;
-
-static int32_t l_previous_sample;
-static int l_period_high_length;
-static int l_period_low_length;
-static int l_sync_first_half_period_length;
-static int l_sync_second_half_period_length;
-
-static int l_middle_period_buffer[MIDDLE_PERIOD_BUFFER_LENGTH];	// buffer used for middle frequency (period) avg. calculation
-static uint32_t l_middle_period_buffer_index;
-static uint16_t l_middle_period;
-static uint32_t l_middle_period_sum;
-
-static TAPEBlockHeaderType l_block_header;
-static TAPESectorHeaderType l_sector_header;
-static uint8_t l_file_name_length;
-static CASProgramFileHeaderType l_program_header;
-static TAPESectorEndType l_sector_end;
-static uint16_t l_current_sector_length;
-static uint16_t l_sector_end_period_count;
-static uint32_t l_sync_period_length;
-static bool l_header_block_valid;
+static TapeDecoderType* l_tape_decoder = NULL;
+static int32_t l_sample_block[WAVE_SAMPLE_BLOCK_LENGTH];			// raw input samples
+
+// parallel decoder variables
+static bool l_parallel_decoding = false;
+static bool l_channel_decoding = false;										// channels of the input are decoded separately by the parallel decoder
+static PDResultType* l_parallel_results = NULL;						// programs decoded by the parallel decoder
+static int l_parallel_result_count = 0;
+static int l_parallel_result_index = 0;
+static uint32_t l_parallel_skipped_sample_count = 0;				// input skipped by the signal gates of the parallel decoder
+
+// tape index variables
+static TIBlockType* l_index_blocks = NULL;
+static int l_index_block_count = 0;
+static int l_index_block_capacity = 0;
+static bool l_indexed_program_loaded = false;
+
+// checkpoint variables
+static bool l_checkpoint_enabled = false;
+static uint32_t l_checkpoint_position = 0;									// input position of the last saved checkpoint
+static bool l_checkpoint_program_pending = false;						// the next load continues the program of the restored decoder state
+static TCCheckpointType l_checkpoint;
+static TCSavedProgramType* l_saved_programs = NULL;					// programs saved since the start of the decoding
+static int l_saved_program_count = 0;
+static int l_saved_program_capacity = 0;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
-
-static int l_demod_sample_index = 0;  // for debugging only (will be removed)
-
 uint16_t g_frequency_offset = 0;
 uint16_t g_leading_length = DEFAULT_LEADING_LENGTH;
 uint16_t g_gap_length = DEFAULT_GAP_LENGTH;
+bool g_verify_output = false;		// decode the rendered signal and compare it with the saved program
+bool g_catalog_mode = false;		// list the header blocks of the input instead of loading the programs
+int g_thread_count = 0;		// number of threads used for decoding and rendering wav files (0 - sequential processing)
+bool g_channel_decoding = false;	// decode every channel of multichannel wav files separately on its own thread
+int g_indexed_program = 0;	// program loaded using the tape index of the wav file (1 based, 0 - all programs are loaded)
+bool g_resume_decoding = false;	// continue decoding of the wav file from its last checkpoint
 
 ///////////////////////////////////////////////////////////////////////////////
 // Initialization of tape functions
 bool TAPEOpenInput(wchar_t* in_file_name)
 {
+	bool resumed = false;
+
 	l_prev_input_percentage = 0xff;
 	l_prev_input_total_seconds = 0xffffffff;
 
-	WLCInit();
-	WLCSetMode(WLCMT_NoiseKiller);
+	TDDestroy(l_tape_decoder);
+	l_tape_decoder = TDCreate(g_filter_type, g_decimation_factor);
+	if(l_tape_decoder == NULL)
+		return false;
+
+	free(l_parallel_results);
+	l_parallel_results = NULL;
+
+	free(l_index_blocks);
+	l_index_blocks = NULL;
+	l_index_block_count = 0;
+	l_index_block_capacity = 0;
+	l_indexed_program_loaded = false;
+
+	FreeCheckpoint();
 
-	l_decoder_state = DST_Idle;
-	l_period_high_length = 0;
-	l_period_low_length = 0;
-	l_header_block_valid = false;
-	l_previous_sample = 0;
+	if(!WMOpenInput(in_file_name))
+		return false;
+
+	// the samples before the decoded window settle the filter and the level control
+	if(g_input_file_type == FT_WAV && g_input_wav_start_sample > 0)
+		WarmUpDecoder(g_input_wav_start_sample);
+
+	// checkpoints are saved only while the whole wav file is decoded sequentially
+	l_checkpoint_enabled = (g_input_file_type == FT_WAV && !g_catalog_mode && g_output_wave_file[0] == '\0' && g_indexed_program == 0 && g_input_wav_start_sample == 0 && g_input_wav_end_sample == 0);
+	if(l_checkpoint_enabled && g_resume_decoding)
+		resumed = ResumeFromCheckpoint();
+
+	// parallel decoding needs random access to the wav file and it can't store the preprocessed wave
+	l_parallel_decoding = (g_input_file_type == FT_WAV && WFIsInputMapped() && g_output_wave_file[0] == '\0' && g_indexed_program == 0 && g_input_wav_start_sample == 0 && !resumed);
+	l_channel_decoding = (l_parallel_decoding && g_channel_decoding && WFGetInputChannelCount() > 1);
+	l_parallel_decoding = (l_parallel_decoding && (g_thread_count > 0 || l_channel_decoding));
+	if(l_parallel_decoding)
+		l_checkpoint_enabled = false;
 
-	return WMOpenInput(in_file_name);
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // TAPE Load
 LoadStatus TAPELoad(void)
 {
-	bool success = true;
-	int32_t	sample;
+	size_t sample_count = 0;
 	LoadStatus load_status = LS_Unknown;
 
-	// init buffer
-	g_db_buffer_length = 0;
-	g_db_buffer_index = 0;
+	if(l_parallel_decoding)
+		return LoadDecodedProgram();
+
+	if(g_indexed_program > 0)
+		return LoadIndexedProgram();
+
+	// init buffer (after resuming the program which was being loaded at the checkpoint is continued)
+	if(!l_checkpoint_program_pending)
+		TDResetProgram(l_tape_decoder);
+
+	l_checkpoint_program_pending = false;
 
 	// scan for files
 	while(load_status == LS_Unknown)
 	{
-		success = WMReadSample(&sample);
-	 
-		if(success)
+		// read and process next block of samples
+		if(l_tape_decoder->ProcessedBlockPos >= l_tape_decoder->ProcessedBlockLength)
 		{
-			sample = WFProcessSample(sample);			// Digital filter
-			sample = WLCProcessSample(sample);		// Amplitude controller							
-			load_status = DecodeSample(sample);		// Decoder
+			sample_count = WMReadSamples(l_sample_block, WAVE_SAMPLE_BLOCK_LENGTH);
 
-			WFWriteSample(sample);
+			// at the end of the input push silence through the filter to get its delayed samples
+			if(sample_count > 0)
+				TDFeedSamples(l_tape_decoder, l_sample_block, sample_count);
+			else
+				sample_count = TDFlush(l_tape_decoder);
+
+			WFWriteSamples(l_tape_decoder->ProcessedBlock, l_tape_decoder->ProcessedBlockLength);
+		}
+	 
+		if(l_tape_decoder->ProcessedBlockPos < l_tape_decoder->ProcessedBlockLength)
+		{
+			// decode until the end of the block or until the decoder reports a result
+			load_status = TDPoll(l_tape_decoder);
 
 			switch(load_status)
 			{
 				case LS_Unknown:
 					DisplayInputDataProgress();
+
+					// the fed samples are decoded, the checkpoint stores the complete decoder state at the current read position
+					if(l_checkpoint_enabled && g_input_wav_file_sample_index - l_checkpoint_position >= CHECKPOINT_INTERVAL)
+						SaveCheckpoint();
 					break;
 
 				case LS_Error:
 					DisplayFailedToLoad();
-					if(l_header_block_valid)
-					{
-						// zero remaining part of the buffer
-						while(g_db_buffer_index < g_db_buffer_length)
-							g_db_buffer[g_db_buffer_index++] = 0;
 
-						// flag as CRC and save partial file
-						g_db_crc_error_detected = true;
+					// save partial file flagged with CRC error
+					if(TDKeepPartialProgram(l_tape_decoder))
 						load_status = LS_Success;
-					}
 					break;
 
 				case LS_Success:
@@ -211,25 +252,212 @@ LoadStatus TAPELoad(void)
 		}
 		else
 		{
-			load_status = LS_Fatal;
+			// a decimated or gated block can be empty, the input ends when no more samples can be fed
+			if(sample_count == 0)
+			{
+				load_status = LS_Fatal;
+				DisplaySkippedInput(l_tape_decoder->SkippedSampleCount);
+
+				// the whole file is decoded, the checkpoint is not needed anymore
+				if(l_checkpoint_enabled)
+					TCDelete(g_input_file_name);
+			}
 		}
 	}
 
+	StoreDecodedProgram();
+
 	return load_status;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Lists the programs of the input (header blocks only). The data blocks are skipped after their block header, the
+// position, name, length and flags of the programs are displayed. The found blocks are saved into the index file of
+// the input. Returns LS_Fatal at the end of the input.
+LoadStatus TAPECatalog(void)
+{
+	CatalogEntryType entry;
+	wchar_t index_file_name[MAX_PATH_LENGTH];
+	WFInputIDType input_id;
+	size_t sample_count = 0;
+	size_t skip_length;
+	uint32_t block_position = 0;
+	uint32_t leading_position = 0;
+	uint32_t skipped_sample_count = 0;
+	int program_count = 0;
+	LoadStatus load_status;
+
+	memset(&entry, 0, sizeof(entry));
+	l_tape_decoder->Reader.HeaderOnly = true;
+	l_index_block_count = 0;
+
+	DisplayMessage(L"  # Header      Data        Name              Length Sectors  Auto  Protect\n");
+
+	while(true)
+	{
+		// read and process next block of samples
+		if(l_tape_decoder->ProcessedBlockPos >= l_tape_decoder->ProcessedBlockLength)
+		{
+			// skip data block (samples are only read, not decoded)
+			while(l_tape_decoder->Reader.SkipSampleCount > 0)
+			{
+				skip_length = (l_tape_decoder->Reader.SkipSampleCount < WAVE_SAMPLE_BLOCK_LENGTH) ? l_tape_decoder->Reader.SkipSampleCount : WAVE_SAMPLE_BLOCK_LENGTH;
+				skip_length = WMReadSamples(l_sample_block, skip_length);
+				if(skip_length == 0)
+					break;
+
+				l_tape_decoder->Reader.SkipSampleCount -= (uint32_t)skip_length;
+				skipped_sample_count += (uint32_t)skip_length;
+			}
+			l_tape_decoder->Reader.SkipSampleCount = 0;
+
+			sample_count = WMReadSamples(l_sample_block, WAVE_SAMPLE_BLOCK_LENGTH);
+
+			// at the end of the input push silence through the filter to get its delayed samples
+			if(sample_count > 0)
+				TDFeedSamples(l_tape_decoder, l_sample_block, sample_count);
+			else
+				sample_count = TDFlush(l_tape_decoder);
+		}
+
+		if(l_tape_decoder->ProcessedBlockPos < l_tape_decoder->ProcessedBlockLength)
+		{
+			load_status = TDPoll(l_tape_decoder);
+
+			if(load_status == LS_Unknown)
+			{
+				DisplayInputDataProgress();
+			}
+			else
+			{
+				StoreIndexBlock(leading_position, block_position, load_status == LS_Success);
+
+				if(l_tape_decoder->Reader.BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
+				{
+					// header block (the previous header without data block is displayed)
+					if(entry.HeaderFound)
+						DisplayCatalogEntry(&entry, ++program_count);
+
+					entry.HeaderFound = true;
+					entry.HeaderPosition = block_position;
+					entry.HeaderValid = (load_status == LS_Success);
+					strcpy(entry.FileName, l_tape_decoder->Reader.Program.FileName);
+					entry.FileLength = l_tape_decoder->Reader.ProgramHeader.FileLength;
+					entry.Autostart = (l_tape_decoder->Reader.ProgramHeader.Autorun != 0);
+					entry.CopyProtect = (l_tape_decoder->Reader.BlockHeader.CopyProtect != 0);
+				}
+				else
+				{
+					// data block completes the entry
+					entry.DataFound = true;
+					entry.DataPosition = block_position;
+					entry.SectorCount = l_tape_decoder->Reader.BlockHeader.SectorsInBlock;
+					DisplayCatalogEntry(&entry, ++program_count);
+				}
+			}
+
+			// blocks are starting after the last position where the reader was idle
+			if(l_tape_decoder->Reader.ReaderStatus == TRST_Idle)
+				block_position = g_input_wav_file_sample_index;
+
+			// the leading starts one middle period buffer before the decoder is locked to it
+			if(l_tape_decoder->Reader.DecoderState == DST_Idle || l_tape_decoder->Reader.DecoderState == DST_WaitingForLeading)
+				leading_position = (g_input_wav_file_sample_index > INDEX_LOCK_LENGTH) ? g_input_wav_file_sample_index - INDEX_LOCK_LENGTH : 0;
+		}
+		else
+		{
+			// a decimated or gated block can be empty, the input ends when no more samples can be fed
+			if(sample_count == 0)
+				break;
+		}
+	}
+
+	if(entry.HeaderFound)
+		DisplayCatalogEntry(&entry, ++program_count);
+
+	DisplayMessageAndClearToLineEnd(L"Catalog: %d program(s), %um%02us of data blocks skipped", program_count, skipped_sample_count / SAMPLE_RATE / 60, (skipped_sample_count / SAMPLE_RATE) % 60);
+	DisplayMessage(L"\n");
+	DisplaySkippedInput(l_tape_decoder->SkippedSampleCount);
+
+	// save the index of the blocks (only the whole file is indexed)
+	if(g_input_wav_start_sample == 0 && g_input_wav_end_sample == 0)
+	{
+		TIGetFileName(index_file_name, g_input_file_name);
+		WFGetInputID(&input_id);
+		if(TISave(g_input_file_name, &input_id, l_index_blocks, l_index_block_count))
+			DisplayMessage(L"Saving index file: %s\n", index_file_name);
+		else
+			DisplayError(L"Error: Can't save index file: %s\n", index_file_name);
+	}
+
+	l_tape_decoder->Reader.HeaderOnly = false;
+
+	return LS_Fatal;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes tape file
 void TAPECloseInput(void)
 {
 	WMCloseOutput(false);
-	WLCClose();
+	TDDestroy(l_tape_decoder);
+	l_tape_decoder = NULL;
+	free(l_parallel_results);
+	l_parallel_results = NULL;
+	free(l_index_blocks);
+	l_index_blocks = NULL;
+	l_index_block_count = 0;
+	l_index_block_capacity = 0;
+	FreeCheckpoint();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Registers the program saved from the last loaded one. The program is stored in the checkpoint and the checkpoint is
+// saved immediately, resumed decoding continues behind the program.
+void TAPEProgramSaved(wchar_t* in_file_name)
+{
+	TCSavedProgramType* programs;
+	TCSavedProgramType* program;
+
+	if(!l_checkpoint_enabled)
+		return;
+
+	// grow the program list
+	if(l_saved_program_count >= l_saved_program_capacity)
+	{
+		programs = (TCSavedProgramType*)realloc(l_saved_programs, (l_saved_program_capacity + 16) * sizeof(TCSavedProgramType));
+		if(programs == NULL)
+			return;
+
+		l_saved_programs = programs;
+		l_saved_program_capacity += 16;
+	}
+
+	program = &l_saved_programs[l_saved_program_count++];
+	memset(program, 0, sizeof(TCSavedProgramType));
+
+	program->Position = g_input_wav_file_sample_index;
+	wcsncpy(program->FileName, in_file_name, MAX_PATH_LENGTH - 1);
+
+	// the loaded program is already stored, the checkpoint holds the state of the decoder before the next load
+	TDResetProgram(l_tape_decoder);
+
+	SaveCheckpoint();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Creates output file
 bool TAPECreateOutput(wchar_t* in_file_name)
 {
+	// wave device output is always 8 bit 44.1kHz, single bit wave files are packed from 8 bit samples
+	if(g_output_file_type == FT_WaveInOut)
+		SetDDSFormat(SAMPLE_RATE, 8, (DDSInterpolationType)g_wave_interpolation);
+	else
+		SetDDSFormat(g_wave_sample_rate, g_one_bit_wave_file ? 8 : g_wave_bits_per_sample, (DDSInterpolationType)g_wave_interpolation);
+
+	// bit frequencies are fixed for the whole run, pre-render their waveforms (falls back to sample generation if it fails)
+	InitDDSBitCache(OffsetFrequency(FREQ_ZERO), OffsetFrequency(FREQ_ONE));
+
 		// openwave output
 	if(!WMOpenOutput(in_file_name))
 		return false;
@@ -242,12 +470,145 @@ bool TAPECreateOutput(wchar_t* in_file_name)
 void TAPECloseOutput(void)
 {
 	WMCloseOutput(false);
-	WLCClose();
+	FreeDDSBitCache();
+
+	TRDestroyPlan(l_render_plan);
+	l_render_plan = NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Saves Tape file
 bool TAPESave(wchar_t* in_file_name)
+{
+	bool success = true;
+	bool verify = false;
+	int data_offset;
+
+	// wave files are rendered after the whole signal is planned (the plan of TAPEEstimate is reused), the final wave
+	// file headers are written and the file space is allocated before rendering
+	if(g_output_file_type == FT_WAV)
+	{
+		success = CreateRenderPlan();
+
+		if(success)
+			success = WMReserveOutput(TRGetSampleCount(l_render_plan));
+	}
+	else
+	{
+		// live output is encoded while it is played
+		TRDestroyPlan(l_render_plan);
+		l_render_plan = NULL;
+	}
+
+	l_display_progress = (g_output_file_type == FT_WaveInOut);
+
+	// the rendered signal is decoded on a worker thread while the encoding continues
+	if(success && g_verify_output)
+		verify = LVStart(g_filter_type, GetDDSSampleRate(), (uint8_t)(GetDDSSampleSize() * 8), g_one_bit_wave_file && g_output_file_type == FT_WAV);
+
+	// render planned signal
+	if(success)
+	{
+		if(l_render_plan != NULL)
+			success = TRRender(l_render_plan, (g_thread_count > 0) ? g_thread_count : 1);
+		else
+			success = EncodeProgram();
+	}
+
+	TRDestroyPlan(l_render_plan);
+	l_render_plan = NULL;
+
+	// compare the decoded program with the saved one
+	if(verify)
+	{
+		data_offset = (g_binary_divide_position < 0) ? 0 : g_binary_divide_position;
+
+		if(!LVStop(g_db_file_name, g_binary_divide_position != 0, &g_db_buffer[data_offset], g_db_buffer_length - data_offset))
+			success = false;
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates the exact length of the tape signal of the current program without rendering it (the output format must
+// be already set by TAPECreateOutput). The signal plan is kept and rendered by the following TAPESave.
+bool TAPEEstimate(TAPEEstimateType* out_estimate)
+{
+	if(!CreateRenderPlan())
+		return false;
+
+	out_estimate->SampleCount = TRGetSampleCount(l_render_plan);
+	out_estimate->SampleRate = GetDDSSampleRate();
+	out_estimate->Duration = (uint32_t)(((uint64_t)out_estimate->SampleCount * 1000 + out_estimate->SampleRate / 2) / out_estimate->SampleRate);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Validates block header
+bool TAPEValidateBlockHeader(TAPEBlockHeaderType* in_block_header)
+{
+	if( in_block_header->Zero != TAPE_BLOCKHDR_ZERO ||
+			in_block_header->Magic != TAPE_BLOCKHDR_MAGIC ||
+			in_block_header->FileType != CASBLOCKHDR_FILE_UNBUFFERED )
+		return false;
+
+	if(in_block_header->BlockType != TAPE_BLOCKHDR_TYPE_HEADER && in_block_header->BlockType != TAPE_BLOCKHDR_TYPE_DATA)
+		return false;
+
+	if(in_block_header->BlockType == TAPE_BLOCKHDR_TYPE_HEADER && in_block_header->SectorsInBlock != 1)
+		return false;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes Tape block header
+void TAPEInitBlockHeader(TAPEBlockHeaderType* out_block_header)
+{
+	// init header block
+	out_block_header->Zero						= 0x00;
+	out_block_header->Magic						= TAPE_BLOCKHDR_MAGIC;
+	out_block_header->BlockType				= TAPE_BLOCKHDR_TYPE_DATA;
+	out_block_header->FileType				= CASBLOCKHDR_FILE_UNBUFFERED;
+	out_block_header->CopyProtect			= (g_db_copy_protect) ? 0xff : 0x00;
+	out_block_header->SectorsInBlock	= (g_db_buffer_length + 255) / 256;
+}
+
+/*****************************************************************************/
+/* Local functions                                                           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Plans the signal of the current program (nothing to do when it is already planned)
+static bool CreateRenderPlan(void)
+{
+	bool success;
+
+	if(l_render_plan != NULL)
+		return true;
+
+	l_render_plan = TRCreatePlan();
+	if(l_render_plan == NULL)
+		return false;
+
+	l_display_progress = false;
+
+	success = EncodeProgram();
+
+	if(!success)
+	{
+		TRDestroyPlan(l_render_plan);
+		l_render_plan = NULL;
+	}
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Encodes the current program (header and data block)
+static bool EncodeProgram(void)
 {
 	TAPEBlockHeaderType tape_block_header;
 	TAPESectorHeaderType tape_sector_header;
@@ -336,9 +697,9 @@ bool TAPESave(wchar_t* in_file_name)
 
 			// closing header block
 			if (success)
-				success = GenerateDDSSignal(OffsetFrequency(FREQ_LEADING), 5);
+				success = EncodeSignal(OffsetFrequency(FREQ_LEADING), 5);
 
-			if (g_output_file_type == FT_WaveInOut)
+			if (l_display_progress)
 				DisplayMessage(L"\n");
 	}
 
@@ -419,60 +780,25 @@ bool TAPESave(wchar_t* in_file_name)
 
 		// closing block
 		if (success)
-			success = GenerateDDSSignal(OffsetFrequency(FREQ_LEADING), 5);
+			success = EncodeSignal(OffsetFrequency(FREQ_LEADING), 5);
 	}
 
 	if(success)
 	{
-		success = GenerateDDSSilence(1000);
+		success = EncodeSilence(1000);
 	}
 
-	if(g_output_file_type == FT_WaveInOut)
+	if(l_display_progress)
 		DisplayMessage(L"\n");
 
 	return success;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-// Validates block header
-bool TAPEValidateBlockHeader(TAPEBlockHeaderType* in_block_header)
-{
-	if( in_block_header->Zero != TAPE_BLOCKHDR_ZERO ||
-			in_block_header->Magic != TAPE_BLOCKHDR_MAGIC ||
-			in_block_header->FileType != CASBLOCKHDR_FILE_UNBUFFERED )
-		return false;
-
-	if(in_block_header->BlockType != TAPE_BLOCKHDR_TYPE_HEADER && in_block_header->BlockType != TAPE_BLOCKHDR_TYPE_DATA)
-		return false;
-
-	if(in_block_header->BlockType == TAPE_BLOCKHDR_TYPE_HEADER && in_block_header->SectorsInBlock != 1)
-		return false;
-
-	return true;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// Initializes Tape block header
-void TAPEInitBlockHeader(TAPEBlockHeaderType* out_block_header)
-{
-	// init header block
-	out_block_header->Zero						= 0x00;
-	out_block_header->Magic						= TAPE_BLOCKHDR_MAGIC;
-	out_block_header->BlockType				= TAPE_BLOCKHDR_TYPE_DATA;
-	out_block_header->FileType				= CASBLOCKHDR_FILE_UNBUFFERED;
-	out_block_header->CopyProtect			= (g_db_copy_protect) ? 0xff : 0x00;
-	out_block_header->SectorsInBlock	= (g_db_buffer_length + 255) / 256;
-}
-
-/*****************************************************************************/
-/* Local functions                                                           */
-/*****************************************************************************/
-
 ///////////////////////////////////////////////////////////////////////////////
 // Display header progress
 static void DisplayOutputHeaderProgress(int in_pos, int in_max_pos)
 {
-	if(g_output_file_type == FT_WaveInOut)
+	if(l_display_progress)
 		DisplayProgressBar(L"Saving header", in_pos, in_max_pos);
 }
 
@@ -480,7 +806,7 @@ static void DisplayOutputHeaderProgress(int in_pos, int in_max_pos)
 // Displays data progress
 static void DisplayOutputDataProgress(int in_pos, int in_max_pos)
 {
-	if(g_output_file_type == FT_WaveInOut)
+	if(l_display_progress)
 		DisplayProgressBar(L"Saving data  ", in_pos, in_max_pos);
 }
 
@@ -542,7 +868,7 @@ static bool EncodeBlockLeading(BlockType in_block_type)
 	}
 	
 	// gap
-	success = GenerateDDSSilence(gap_length);
+	success = EncodeSilence(gap_length);
 
 	// leading signal
 	if(success)
@@ -550,38 +876,53 @@ static bool EncodeBlockLeading(BlockType in_block_type)
 		// caluclate 
 		period_count = (uint16_t)((((uint32_t)OffsetFrequency(FREQ_LEADING)) * leading_length + 500) / 1000);
 
-		success = GenerateDDSSignal(OffsetFrequency(FREQ_LEADING), period_count);
+		success = EncodeSignal(OffsetFrequency(FREQ_LEADING), period_count);
 	}
 
 	// sync signal
 	if(success)
-		success = GenerateDDSSignal(OffsetFrequency(FREQ_SYNC), 1);
+		success = EncodeSignal(OffsetFrequency(FREQ_SYNC), 1);
 
 	return success;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Encodes one byte
-static bool EncodeByte(uint8_t in_data)
+// Encodes signal periods (adds them to the plan when the signal is planned)
+static bool EncodeSignal(uint16_t in_frequency, uint16_t in_cycle_count)
 {
-	int i;
-	bool success = true;
+	if(l_render_plan != NULL)
+	{
+		TRAddSignal(l_render_plan, in_frequency, in_cycle_count);
+		return !l_render_plan->OutOfMemory;
+	}
+
+	return GenerateDDSSignal(in_frequency, in_cycle_count);
+}
 
-	for( i = 0; i < 8 && success; i++)
+///////////////////////////////////////////////////////////////////////////////
+// Encodes silence (adds it to the plan when the signal is planned)
+static bool EncodeSilence(uint16_t in_length_in_ms)
+{
+	if(l_render_plan != NULL)
 	{
-		if( (in_data & 0x01) == 0 )
-		{
-			success = GenerateDDSSignal(OffsetFrequency(FREQ_ZERO), 1);
-		}
-		else
-		{
-			success = GenerateDDSSignal(OffsetFrequency(FREQ_ONE), 1);
-		}
+		TRAddSilence(l_render_plan, in_length_in_ms);
+		return !l_render_plan->OutOfMemory;
+	}
+
+	return GenerateDDSSilence(in_length_in_ms);
+}
 
-		in_data >>= 1;
+///////////////////////////////////////////////////////////////////////////////
+// Encodes one byte
+static bool EncodeByte(uint8_t in_data)
+{
+	if(l_render_plan != NULL)
+	{
+		TRAddData(l_render_plan, &in_data, 1);
+		return !l_render_plan->OutOfMemory;
 	}
 
-	return success;
+	return GenerateDDSByte(in_data);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -589,6 +930,13 @@ static bool EncodeByte(uint8_t in_data)
 static bool EncodeBlock(uint8_t* in_buffer, int in_length)
 {
 	bool success = true;
+
+	if(l_render_plan != NULL)
+	{
+		TRAddData(l_render_plan, in_buffer, in_length);
+		return !l_render_plan->OutOfMemory;
+	}
+
 	while(in_length > 0 && success)
 	{
 		success = EncodeByte(*in_buffer);
@@ -605,28 +953,108 @@ static void DisplayFailedToLoad(void)
 {
 	wchar_t buffer[DB_MAX_FILENAME_LENGTH+1];
 
-	TVCStringToUNICODEString(buffer, g_db_file_name);
+	TVCStringToUNICODEString(buffer, l_tape_decoder->Reader.Program.FileName);
 	DisplayMessageAndClearToLineEnd(L"Failed to load file: %s (signal lost)", buffer);
 	DisplayMessage(L"\n");
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Displays the length of the input skipped by the signal gate at the end of the input
+static void DisplaySkippedInput(uint32_t in_skipped_sample_count)
+{
+	uint32_t total_seconds;
+	uint32_t input_length;
+
+	if(!g_signal_gate || g_input_file_type != FT_WAV)
+		return;
+
+	input_length = g_input_wav_file_sample_count - g_input_wav_start_sample;
+
+	// segments of the parallel decoder can overlap
+	if(in_skipped_sample_count > input_length)
+		in_skipped_sample_count = input_length;
+
+	total_seconds = in_skipped_sample_count / SAMPLE_RATE;
+
+	if(input_length != 0)
+	{
+		DisplayMessageAndClearToLineEnd(L"Skipped: %um%02us without tape signal (%u%% of the input)", total_seconds / 60, total_seconds % 60, (uint32_t)((uint64_t)in_skipped_sample_count * 100 / input_length));
+		DisplayMessage(L"\n");
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Displays one line of the catalog and clears the entry
+static void DisplayCatalogEntry(CatalogEntryType* inout_entry, int in_program)
+{
+	wchar_t header_position[16];
+	wchar_t data_position[16];
+	wchar_t sector_count[8];
+	wchar_t file_name[DB_MAX_FILENAME_LENGTH+1];
+	uint32_t ms;
+
+	if(inout_entry->HeaderFound)
+	{
+		ms = (uint32_t)((uint64_t)inout_entry->HeaderPosition * 1000 / SAMPLE_RATE);
+		swprintf(header_position, 16, L"%3um%02u.%03us", ms / 60000, (ms / 1000) % 60, ms % 1000);
+		TVCStringToUNICODEString(file_name, inout_entry->FileName);
+	}
+	else
+	{
+		wcscpy(header_position, L"          -");
+		wcscpy(file_name, L"?");
+	}
+
+	if(inout_entry->DataFound)
+	{
+		ms = (uint32_t)((uint64_t)inout_entry->DataPosition * 1000 / SAMPLE_RATE);
+		swprintf(data_position, 16, L"%3um%02u.%03us", ms / 60000, (ms / 1000) % 60, ms % 1000);
+		swprintf(sector_count, 8, L"%u", inout_entry->SectorCount);
+	}
+	else
+	{
+		wcscpy(data_position, L"          -");
+		wcscpy(sector_count, L"-");
+	}
+
+	if(inout_entry->HeaderFound)
+	{
+		DisplayMessageAndClearToLineEnd(L"%3d %s %s %-16s %6u %7s  %-4s  %-3s%s", in_program, header_position, data_position, file_name,
+			inout_entry->FileLength, sector_count, inout_entry->Autostart ? L"yes" : L"no", inout_entry->CopyProtect ? L"yes" : L"no",
+			inout_entry->HeaderValid ? L"" : L"  (CRC error)");
+	}
+	else
+	{
+		DisplayMessageAndClearToLineEnd(L"%3d %s %s %-16s %6s %7s", in_program, header_position, data_position, file_name, L"-", sector_count);
+	}
+	DisplayMessage(L"\n");
+
+	memset(inout_entry, 0, sizeof(CatalogEntryType));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Displays input status message
 static void DisplayInputDataProgress(void)
 {
 	uint8_t percentage;
 	uint32_t total_seconds;
+	uint32_t position;
+	uint32_t input_length;
 	uint16_t hour, minutes, seconds;
 	wchar_t buffer[DB_MAX_FILENAME_LENGTH+1];
 
 	switch(g_input_file_type)
 	{
 		case FT_WAV:
-			if(g_input_wav_file_sample_count != 0)
+			if(g_input_wav_file_sample_count > g_input_wav_start_sample)
 			{
+				// progress is relative to the decoded window
+				input_length = g_input_wav_file_sample_count - g_input_wav_start_sample;
+				position = (g_input_wav_file_sample_index > g_input_wav_start_sample) ? g_input_wav_file_sample_index - g_input_wav_start_sample : 0;
+
 				// calculate percentage
-				percentage = (uint8_t)((uint64_t)g_input_wav_file_sample_index * 100 / g_input_wav_file_sample_count);
-				total_seconds = g_input_wav_file_sample_index / SAMPLE_RATE;
+				percentage = (uint8_t)((uint64_t)position * 100 / input_length);
+				total_seconds = position / SAMPLE_RATE;
 
 				// calculate time
 				hour = (uint16_t)(total_seconds / (60 * 60));
@@ -638,9 +1066,9 @@ static void DisplayInputDataProgress(void)
 				if(percentage != l_prev_input_percentage || total_seconds != l_prev_input_total_seconds)
 				{
 					// generate file name and display status information
-					if(l_header_block_valid)
+					if(l_tape_decoder->Reader.HeaderBlockValid)
 					{
-						TVCStringToUNICODEString(buffer, g_db_file_name);
+						TVCStringToUNICODEString(buffer, l_tape_decoder->Reader.Program.FileName);
 						DisplayMessageAndClearToLineEnd(L"Processing: %3d%% (%0uh%02um%02us), Loading: %s", percentage, hour, minutes, seconds, buffer);
 					}
 					else
@@ -658,9 +1086,9 @@ static void DisplayInputDataProgress(void)
 			{
 				if(g_wavein_peak_updated)
 				{
-					if(l_header_block_valid)
+					if(l_tape_decoder->Reader.HeaderBlockValid)
 					{
-						TVCStringToUNICODEString(buffer, g_db_file_name);
+						TVCStringToUNICODEString(buffer, l_tape_decoder->Reader.Program.FileName);
 						DisplaySignalLevel(g_wavein_peak_level, g_cpu_overload, L" Loading: %s", buffer);
 					}
 					else
@@ -676,567 +1104,337 @@ static void DisplayInputDataProgress(void)
 	}
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////
-// Restarts decoder
-static LoadStatus DecoderRestart(void)
+///////////////////////////////////////////////////////////////////////////////
+// Copies the program loaded by the decoder to the common data buffer
+static void StoreDecodedProgram(void)
 {
-	LoadStatus load_status = LS_Unknown;
+	TDProgramType* program = &l_tape_decoder->Reader.Program;
+
+	memcpy(g_db_buffer, program->Buffer, program->BufferLength);
+	g_db_buffer_length = program->BufferLength;
+	g_db_buffer_index = program->BufferIndex;
+	strcpy(g_db_file_name, program->FileName);
+	g_db_autostart = program->Autostart;
+	g_db_crc_error_detected = program->CRCErrorDetected;
+}
 
-	if(l_tape_reader_status == TRST_Data)
+///////////////////////////////////////////////////////////////////////////////
+// Loads next program from the results of the parallel decoder (the whole file is decoded at the first call)
+static LoadStatus LoadDecodedProgram(void)
+{
+	PDResultType* result;
+
+	if(l_parallel_results == NULL)
 	{
-		load_status = LS_Error;
+		l_parallel_result_index = 0;
+
+		if(l_channel_decoding)
+		{
+			DisplayMessageAndClearToLineEnd(L"Processing: decoding %d channels on separate threads", WFGetInputChannelCount());
+			l_parallel_results = PDDecodeChannels(g_filter_type, &l_parallel_result_count, &l_parallel_skipped_sample_count);
+		}
+		else
+		{
+			DisplayMessageAndClearToLineEnd(L"Processing: decoding on %d threads", g_thread_count);
+			l_parallel_results = PDDecode(g_filter_type, g_thread_count, &l_parallel_result_count, &l_parallel_skipped_sample_count);
+		}
+
+		if(l_parallel_results == NULL)
+		{
+			DisplayError(L"Error: Not enough memory for parallel decoding.\n");
+			return LS_Fatal;
+		}
 	}
 
-	// reset decoder
-	l_decoder_state = DST_Idle;
-	WLCSetMode(WLCMT_NoiseKiller);
-	l_tape_reader_status = TRST_Idle;
+	// end of the input
+	if(l_parallel_result_index >= l_parallel_result_count)
+	{
+		DisplaySkippedInput(l_parallel_skipped_sample_count);
+		return LS_Fatal;
+	}
 
-	return load_status;
+	result = &l_parallel_results[l_parallel_result_index++];
+	memcpy(&l_tape_decoder->Reader.Program, &result->Program, sizeof(TDProgramType));
+
+	if(result->SignalLost)
+		DisplayFailedToLoad();
+	else
+		DisplayMessage(L"\r");
+
+	StoreDecodedProgram();
+
+	return result->Status;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Process one sample
-static LoadStatus DecodeSample(int32_t in_sample)
+// Adds the block reported by the decoder to the index
+static void StoreIndexBlock(uint32_t in_leading_position, uint32_t in_sync_position, bool in_header_valid)
 {
-	uint32_t period_length;
-	int high_period_length;
-	int low_period_length;
-	int oversampled_length;
-	SignalPhaseType current_phase;
-	bool half_period_end;
-	LoadStatus load_status = LS_Unknown;
+	TIBlockType* blocks;
+	TIBlockType* block;
 
-	// cache period length
-	high_period_length = l_period_high_length;
-	low_period_length = l_period_low_length;
-	current_phase = l_current_phase;
-
-	// detectg zero crossing (eof of the half periods)
-	half_period_end = false;
-	switch(current_phase)
+	// grow the block list
+	if(l_index_block_count >= l_index_block_capacity)
 	{
-		// check for zero crossing in rising direction
-		case SPT_Low:
-			if(in_sample > 0)
-			{
-				oversampled_length = (OVERSAMPLING_RATE * l_previous_sample) / (l_previous_sample - in_sample);
-				l_period_low_length += oversampled_length;
-				period_length = l_period_high_length + l_period_low_length;
-				l_period_high_length = OVERSAMPLING_RATE - oversampled_length;
-				half_period_end = true;
-				l_current_phase = SPT_High;
-			}
-			else
-			{
-				l_period_low_length += OVERSAMPLING_RATE;
-			}
-			break;
+		blocks = (TIBlockType*)realloc(l_index_blocks, (l_index_block_capacity + 64) * sizeof(TIBlockType));
+		if(blocks == NULL)
+			return;
 
-		// check for zero crossing in falling direction
-		case SPT_High:
-			if(in_sample < 0)
-			{
-				oversampled_length = (OVERSAMPLING_RATE * l_previous_sample) / (l_previous_sample - in_sample);
-				l_period_high_length += oversampled_length;
-				period_length = l_period_high_length + l_period_low_length;
-				l_period_low_length = OVERSAMPLING_RATE - oversampled_length;
-				half_period_end = true;
-				l_current_phase = SPT_Low;
-			}
-			else
-			{
-				l_period_high_length += OVERSAMPLING_RATE;
-			}
-			break;
+		l_index_blocks = blocks;
+		l_index_block_capacity += 64;
 	}
-	l_previous_sample = in_sample;
-
-	// zero cross detected (half period end)
-	if(half_period_end)
-	{
-		switch (l_decoder_state)
-		{
-			// waiting for an apropriate signal
-			case DST_Idle:
-				// looking for leading signal
-				l_middle_period_buffer_index = 0;
-				l_decoder_state = DST_WaitingForLeading;
-				break;
 
-			// waiting for leading signal
-			case DST_WaitingForLeading:
-			{
-				uint32_t leading_min = PERIOD_LEADING - (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
-				uint32_t leading_max = PERIOD_LEADING + (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
+	block = &l_index_blocks[l_index_block_count++];
+	memset(block, 0, sizeof(TIBlockType));
 
-				// check for leading frequency
-				if(period_length >= leading_min && period_length <= leading_max)
-				{
-					// frequency is ok, store it for the running average
-					UpdateMiddleFrequency(FREQ_LEADING, period_length);
+	block->LeadingPosition = in_leading_position;
+	block->SyncPosition = in_sync_position;
+	block->MiddlePeriod = l_tape_decoder->Reader.MiddlePeriod;
+	memcpy(&block->BlockHeader, &l_tape_decoder->Reader.BlockHeader, sizeof(TAPEBlockHeaderType));
 
-					// we have one buffer of leading frequency data -> averrage is valid
-					if(l_middle_period_buffer_index == 0)
-					{
-						l_decoder_state = DST_WaitingForSync;
-						WLCSetMode(WLCMT_LevelControl);
-					}
-				}
-				else
-				{
-					load_status = DecoderRestart();
-				}
-			}
-			break;
-
-			// waiting for sync signal
-			case DST_WaitingForSync:
-				{
-					uint32_t leading_min = PERIOD_LEADING - (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
-					uint32_t leading_max = PERIOD_LEADING + (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
-					uint32_t expected_sync_period = (FREQ_MIDDLE * l_middle_period + FREQ_SYNC / 2) / FREQ_SYNC;
-					uint32_t sync_min = expected_sync_period - (PERIOD_SYNC * SYNC_FREQUENCY_TOLERANCE + 50) / 100;
-					uint32_t sync_max = expected_sync_period + (PERIOD_SYNC * SYNC_FREQUENCY_TOLERANCE + 50) / 100;
-
-					// check for leading frequency
-					if(period_length >= leading_min && period_length <= leading_max)
-					{
-						// frequency is ok, store it for the running average
-						UpdateMiddleFrequency(FREQ_LEADING, period_length);	
-					}
-					else
-					{
-						// check for sync frequency
-						if(period_length >= sync_min && period_length <= sync_max)
-						{
-							switch(current_phase)
-							{
-								case SPT_High:
-									l_sync_first_half_period_length = high_period_length;
-									l_sync_second_half_period_length = low_period_length;
-									l_decoder_state = DST_SyncDetected;
-									break;
-
-								case SPT_Low:
-									l_sync_first_half_period_length = high_period_length;
-									l_sync_second_half_period_length = low_period_length;
-									l_decoder_state = DST_SyncDetected;
-									break;
-							}
-						}
-						else
-						{
-							if(period_length < leading_min || period_length > sync_max)
-								load_status = DecoderRestart();
-						}
-					}
-				}
-				break;
+	if(block->BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
+	{
+		block->HeaderValid = in_header_valid;
+		strcpy(block->FileName, l_tape_decoder->Reader.Program.FileName);
+		memcpy(&block->ProgramHeader, &l_tape_decoder->Reader.ProgramHeader, sizeof(CASProgramFileHeaderType));
+	}
+}
 
-			//	Sync period length detected
-			case DST_SyncDetected:
-				{
-					uint32_t expected_sync_half_period = (FREQ_MIDDLE * l_middle_period / FREQ_SYNC + 1) / 2;
-					uint32_t expected_leading_half_period = (FREQ_MIDDLE * l_middle_period / FREQ_LEADING + 1) / 2;
-					uint32_t expected_zero_half_period = (FREQ_MIDDLE * l_middle_period / FREQ_ZERO + 1) / 2;
-					uint32_t sync_third_half_period_length;
-					uint8_t first_score;
-					uint8_t second_score;
-
-					// determine second and third half period length
-					switch(current_phase)
-					{
-						case SPT_High:
-							sync_third_half_period_length = high_period_length;
-							break;
+///////////////////////////////////////////////////////////////////////////////
+// Loads one program using the index of the input (the index is created by a catalog pass when it doesn't exist or it
+// belongs to a different file). Only the blocks of the program are decoded, the next call returns LS_Fatal.
+static LoadStatus LoadIndexedProgram(void)
+{
+	LoadStatus load_status = LS_Unknown;
+	WFInputIDType input_id;
+	int header_block;
+	int data_block;
 
-						case SPT_Low:
-							sync_third_half_period_length = low_period_length;
-							break;
-					}
+	if(l_indexed_program_loaded)
+		return LS_Fatal;
 
-					//Now we have the length of the three previous half period
-					// determine which two contans a valid sync period. It can be the first two or second two half period.
-					// scoring algorithm will decide
-					first_score = 0;
-					second_score = 0;
+	l_indexed_program_loaded = true;
 
-					// Score based on half period symmetry sync period is most probable has two simmetrical length half period
-					if(IntABS(l_sync_first_half_period_length - l_sync_second_half_period_length) < IntABS(l_sync_second_half_period_length-sync_third_half_period_length))
-					{
-						first_score++;
-					}
-					else
-					{
-						second_score++;
-					}
+	// load index
+	free(l_index_blocks);
+	WFGetInputID(&input_id);
+	l_index_blocks = TILoad(g_input_file_name, &input_id, &l_index_block_count);
+	l_index_block_capacity = l_index_block_count;
 
-					// Score based on the first half period. If its length is closer to leading length, probably it belons to leading signal not to the sync.
-					// If its closer to sync then probably it belongs to sync.
-					if(IntABS(l_sync_first_half_period_length - expected_leading_half_period) < IntABS(l_sync_first_half_period_length-expected_sync_half_period))
-					{
-						second_score++;
-					}
-					else
-					{
-						first_score++;
-					}
+	if(l_index_blocks == NULL)
+	{
+		DisplayMessage(L"Creating index file\n");
+		TAPECatalog();
+	}
 
-					// Score based on the last (third) period length. If the length is closer to zero period length (the first bit after the sync shoud be zero) then 
-					// sync if located at the first period. If its length is closer to sync length than sync is located at the second half period
-					if(IntABS(sync_third_half_period_length - expected_sync_half_period) < IntABS(sync_third_half_period_length - expected_zero_half_period))
-					{
-						second_score++;
-					}
-					else
-					{
-						first_score++;
-					}
+	if(!TIFindProgram(l_index_blocks, l_index_block_count, g_indexed_program, &header_block, &data_block))
+	{
+		DisplayError(L"Error: Program %d is not found in the index.\n", g_indexed_program);
+		return LS_Fatal;
+	}
 
-					if(first_score > second_score)
-					{
-						// sync is located at the first half
-						l_phase_mode = l_current_phase;
-					}
-					else
-					{
-						// sync starts at the second half
-						l_phase_mode = current_phase;
-					}
+	// decode the blocks of the program
+	TDResetProgram(l_tape_decoder);
 
-					// read block header
-					l_decoder_state = DST_ReadingData;
-					l_bit_counter = 0;
-					l_data_byte = 0;
-					ChangeReaderStatus(TRST_BlockHeader);
-				}
-				break;
+	if(header_block >= 0)
+		load_status = DecodeIndexedBlock(header_block);
 
-				// reading data bits
-				case DST_ReadingData:
-					if(current_phase == l_phase_mode)
-					{
-						l_data_byte = l_data_byte >> 1;
-						if( period_length <= l_middle_period )
-						{
-							l_data_byte |= 0x80;
-							UpdateMiddleFrequency(FREQ_ONE, period_length);
-						}
-						else
-						{
-							UpdateMiddleFrequency(FREQ_ZERO, period_length);
-						}
-
-						l_bit_counter++;
-						if( l_bit_counter >= 8 )
-						{
-							l_bit_counter = 0;
-
-							load_status = StoreByte(l_data_byte);
-						}
-					}
-					break;
+	if(data_block >= 0)
+		load_status = DecodeIndexedBlock(data_block);
+	else
+		load_status = LS_Error;
 
-				// skip sector end signal
-				case DST_SectorEnd:
-					l_sector_end_period_count++;
-					if(l_sector_end_period_count>=SECTOR_END_PERIOD_COUNT)
-						load_status = DecoderRestart();
-					break;
-			}
+	if(load_status == LS_Success)
+	{
+		DisplayMessage(L"\r");
 	}
 	else
 	{
-		// check for signal loss
-		if((high_period_length + low_period_length) > PERIOD_SYNC * (100 + LEADING_FREQUENCY_TOLERANCE) / 100 )
-			load_status = DecoderRestart();
+		DisplayFailedToLoad();
+
+		// save partial file flagged with CRC error
+		load_status = TDKeepPartialProgram(l_tape_decoder) ? LS_Success : LS_Error;
 	}
 
-	l_demod_sample_index++;
+	StoreDecodedProgram();
 
 	return load_status;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Integer absolute value
-static int IntABS(int in_value)
-{
-	if(in_value < 0)
-		return -in_value;
-	else
-		return in_value;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// Stores data byte readed by the decoder
-static LoadStatus StoreByte(uint8_t in_data_byte)
+// Decodes one block of the index until the next indexed block. The decoder starts shortly before the sync with the
+// middle period stored in the index, when the block can't be loaded this way the whole leading is decoded again.
+// Returns LS_Success when the block is loaded, LS_Error when the signal is lost or the header block is invalid.
+static LoadStatus DecodeIndexedBlock(int in_block_index)
 {
+	TIBlockType* block = &l_index_blocks[in_block_index];
 	LoadStatus load_status = LS_Unknown;
+	uint32_t start_position;
+	uint32_t end_position;
+	size_t sample_count;
+	bool block_started;
+	int attempt;
+
+	if(in_block_index + 1 < l_index_block_count)
+		end_position = l_index_blocks[in_block_index + 1].LeadingPosition;
+	else
+		end_position = g_input_wav_file_sample_count + 1;
 
-	switch (l_tape_reader_status)
+	for(attempt = 0; attempt < 2 && load_status != LS_Success; attempt++)
 	{
-		// reading header
-		case TRST_BlockHeader:
-			// store block header
-			if(StoreByteInStruct(in_data_byte, &l_block_header, sizeof(l_block_header), false))
-			{
-				// check block
-				if(TAPEValidateBlockHeader(&l_block_header))
-				{
-					// load sector header
-					ChangeReaderStatus(TRST_SectorHeader);
-
-					// new block header is coming -> invalidate current
-					if(l_block_header.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
-						l_header_block_valid = false;
-
-					// if data block  is coming validata block header
-					if (l_block_header.BlockType == TAPE_BLOCKHDR_TYPE_DATA)
-						l_header_block_valid = true;
-
-					g_db_buffer_index = 0;
-					g_db_crc_error_detected = false;
-					CRCReset(g_checksum_start);
-					CRCAddBlock(((uint8_t*)&l_block_header + 1), sizeof(l_block_header)-1);
-				}
-				else
-				{
-					ChangeReaderStatus(TRST_Idle);
-					load_status = DecoderRestart();
-				}
-			}
-			break;
+		if(attempt == 0)
+			start_position = (block->SyncPosition > INDEX_PREROLL_LENGTH) ? block->SyncPosition - INDEX_PREROLL_LENGTH : 0;
+		else
+			start_position = block->LeadingPosition;
 
-		// Load sector header
-		case TRST_SectorHeader:
-			if(StoreByteInStruct(in_data_byte, &l_sector_header, sizeof(l_sector_header), true))
-			{
-				// check sector header
-				switch(l_block_header.BlockType)
-				{
-					// header block
-					case TAPE_BLOCKHDR_TYPE_HEADER:
-						// in the case of header block the sector number must be zero
-						if(l_sector_header.SectorNumber == 0)
-						{
-							SetSectorLength(l_sector_header.BytesInSector);
-							ChangeReaderStatus(TRST_HeaderFileNameLength);
-						}
-						else
-						{
-							ChangeReaderStatus(TRST_Idle);
-							load_status = DecoderRestart();
-						}
-						break;
-
-					// data block
-					case TAPE_BLOCKHDR_TYPE_DATA:
-						if (g_db_buffer_length == 0)
-							g_db_buffer_length = l_block_header.SectorsInBlock * TAPE_MAX_BLOCK_LENGTH;
-
-						SetSectorLength(l_sector_header.BytesInSector);
-						ChangeReaderStatus(TRST_Data);
-						break;
-
-					// unknown block
-					default:
-						ChangeReaderStatus(TRST_Idle);
-						load_status = DecoderRestart();
-						break;
-				}
-			}
+		// the samples before the start settle the filter and the level control
+		TDSeek(l_tape_decoder, (attempt == 0) ? block->MiddlePeriod : 0);
+		if(!WarmUpDecoder(start_position))
 			break;
 
-		// File name length
-		case TRST_HeaderFileNameLength:
-			if(l_data_byte <= DB_MAX_FILENAME_LENGTH)
-			{
-				l_file_name_length = in_data_byte;
-				CRCAddByte(in_data_byte);
-				if(l_file_name_length == 0)
-				{
-					g_db_file_name[0] = '\0';
-					ChangeReaderStatus(TRST_HeaderProgramHeader);
-				}
-				else
-				{
-					ChangeReaderStatus(TRST_HeaderFileName);
-				}
+		load_status = LS_Unknown;
+		block_started = false;
 
-				l_data_byte_index = 0;
-			}
-			else
+		while(load_status == LS_Unknown && g_input_wav_file_sample_index < end_position)
+		{
+			// read and process next block of samples
+			if(l_tape_decoder->ProcessedBlockPos >= l_tape_decoder->ProcessedBlockLength)
 			{
-				ChangeReaderStatus(TRST_Idle);
-				load_status = DecoderRestart();
-			}
-			break;
+				sample_count = WMReadSamples(l_sample_block, WAVE_SAMPLE_BLOCK_LENGTH);
 
-		// File name
-		case TRST_HeaderFileName:
-			if(l_data_byte_index < DB_MAX_FILENAME_LENGTH)
-			{
-				// replace string terminator character to space
-				if(in_data_byte == '\0')
-					g_db_file_name[l_data_byte_index]  = ' ';
+				if(sample_count > 0)
+					TDFeedSamples(l_tape_decoder, l_sample_block, sample_count);
 				else
-					g_db_file_name[l_data_byte_index] = in_data_byte;
+					sample_count = TDFlush(l_tape_decoder);
 
-				CRCAddByte(in_data_byte);
-
-				l_data_byte_index++;
-				if(l_data_byte_index == l_file_name_length)
-				{
-					g_db_file_name[l_data_byte_index] = '\0';
-
-					ChangeReaderStatus(TRST_HeaderProgramHeader);
-				}
-			}
-			else
-			{
-				ChangeReaderStatus(TRST_Idle);
-				load_status = DecoderRestart();
+				if(sample_count == 0)
+					break;
 			}
-			break;
 
-		// program header
-		case TRST_HeaderProgramHeader:
-			if(StoreByteInStruct(in_data_byte, &l_program_header, sizeof(l_program_header), true))
-			{	
-				ChangeReaderStatus(TRST_SectorEnd);
-				g_db_buffer_length = 0;
-			}
-			break;
+			load_status = TDPoll(l_tape_decoder);
 
-		// read sector end
-		case TRST_SectorEnd:
-			if(StoreByteInStruct(in_data_byte, &l_sector_end, sizeof(l_sector_end), false))
+			// the end of the header block is not reported by the decoder
+			if(load_status == LS_Unknown && block->BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
 			{
-				CRCAddByte(l_sector_end.EOFFlag);
-
-				// check CRC
-				switch(l_block_header.BlockType)
-				{
-					// header block
-					case TAPE_BLOCKHDR_TYPE_HEADER:
-						if(l_sector_end.CRC == CRCGet() || g_checksum_off)
-						{
-							g_db_autostart = (l_program_header.Autorun != 0);
-
-							g_db_buffer_length = l_program_header.FileLength;
-
-							l_header_block_valid = true;
-						}
-						else
-							l_header_block_valid = false;
-
-						// no more sector in the header block
-						ChangeReaderStatus(TRST_Idle);
-						l_decoder_state = DST_Idle;
-						l_sector_end_period_count = 0;
-						break;
-
-					// data block
-					case TAPE_BLOCKHDR_TYPE_DATA:
-						if(l_sector_end.CRC != CRCGet() && !g_checksum_off)
-							g_db_crc_error_detected = true;
-
-						// if there is no more data to read
-						if(g_db_buffer_index >= g_db_buffer_length || l_sector_end.EOFFlag == TAPE_SECTOR_EOF)
-						{
-							ChangeReaderStatus(TRST_Idle);
-							l_decoder_state = DST_Idle;
-							l_sector_end_period_count = 0;
-
-							if(l_header_block_valid)
-							{
-								l_header_block_valid = false;
-								load_status = LS_Success;
-							}
-						}
-						else
-						{
-							// read next sectors
-							ChangeReaderStatus(TRST_SectorHeader);
-							CRCReset(g_checksum_start);
-						}
-						break;
-				}
+				if(l_tape_decoder->Reader.ReaderStatus != TRST_Idle)
+					block_started = true;
+				else if(block_started)
+					load_status = (l_tape_decoder->Reader.HeaderBlockValid) ? LS_Success : LS_Error;
 			}
-			break;
 
-		// read data
-		case TRST_Data:
-			// store data
-			g_db_buffer[g_db_buffer_index++] = in_data_byte;
-			CRCAddByte(in_data_byte);
-			l_data_byte_index++;
-
-			// check sector end
-			if(l_data_byte_index >= l_current_sector_length || g_db_buffer_index >= g_db_buffer_length)
-			{
-				// read sector end
-				ChangeReaderStatus(TRST_SectorEnd);
-			}
-			break;
+			if(load_status == LS_Unknown)
+				DisplayInputDataProgress();
+		}
 	}
 
 	return load_status;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Changes reader status to a new value
-static void ChangeReaderStatus(TapeReaderStatusType in_new_status)
+// Continues decoding from the checkpoint of the input. The complete decoder state of the checkpoint is restored and the
+// input is positioned to the read position of the checkpoint. Returns false (decoding starts from the beginning) when
+// there is no valid checkpoint.
+static bool ResumeFromCheckpoint(void)
 {
-	l_data_byte_index = 0;
-	l_tape_reader_status = in_new_status;
-}
+	TapeDecoderType* decoder_state;
+	TDReaderStateType* inverted_reader_state;
+	WFInputIDType input_id;
+	bool success = false;
+	int i;
 
-///////////////////////////////////////////////////////////////////////////////
-// Stores received byte in a struct
-static bool StoreByteInStruct(uint8_t in_data_byte, void* in_struct, size_t in_size, bool in_add_to_crc)
-{
-	if( l_data_byte_index < in_size)
+	decoder_state = (TapeDecoderType*)malloc(sizeof(TapeDecoderType));
+	inverted_reader_state = (TDReaderStateType*)malloc(sizeof(TDReaderStateType));
+
+	if(decoder_state != NULL && inverted_reader_state != NULL)
 	{
-		// store byte
-		*((uint8_t*)in_struct + l_data_byte_index) = in_data_byte;
-		l_data_byte_index++;
+		WFGetInputID(&input_id);
+		l_saved_programs = TCLoad(g_input_file_name, &input_id, &l_checkpoint, decoder_state, inverted_reader_state);
+		if(l_saved_programs != NULL && l_checkpoint.SampleIndex <= g_input_wav_file_sample_count)
+			success = TDSetState(l_tape_decoder, decoder_state, (l_checkpoint.ReaderStateSize > 0) ? inverted_reader_state : NULL);
+	}
 
-		// add to CRC
-		if(in_add_to_crc)
-			CRCAddByte(in_data_byte);
+	free(decoder_state);
+	free(inverted_reader_state);
 
-		// check if this is the last byte of the struct
-		return l_data_byte_index == in_size;
+	if(!success)
+	{
+		free(l_saved_programs);
+		l_saved_programs = NULL;
+		DisplayMessage(L"No checkpoint found, decoding from the start\n");
+		return false;
 	}
 
+	l_saved_program_count = l_checkpoint.SavedProgramCount;
+	l_saved_program_capacity = l_checkpoint.SavedProgramCount;
+
+	WMSeekInput(l_checkpoint.SampleIndex);
+	l_checkpoint_position = l_checkpoint.SampleIndex;
+	l_checkpoint_program_pending = true;
+
+	DisplayMessage(L"Resuming from checkpoint at %um%02us, %d program(s) already saved\n", l_checkpoint.SampleIndex / SAMPLE_RATE / 60, (l_checkpoint.SampleIndex / SAMPLE_RATE) % 60, l_saved_program_count);
+	for(i = 0; i < l_saved_program_count; i++)
+		DisplayMessage(L"  %s\n", l_saved_programs[i].FileName);
+
 	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Sets sector length
-static void SetSectorLength(uint8_t in_sector_length)
+// Saves the checkpoint of the current input position with the complete decoder state. Checkpoints are disabled when
+// the checkpoint file can't be written.
+static void SaveCheckpoint(void)
 {
-	if(in_sector_length == 0)
-		l_current_sector_length = TAPE_MAX_BLOCK_LENGTH;
+	WFGetInputID(&l_checkpoint.Input);
+	l_checkpoint.SampleIndex = g_input_wav_file_sample_index;
+	l_checkpoint.SavedProgramCount = (uint16_t)l_saved_program_count;
+
+	if(TCSave(g_input_file_name, &l_checkpoint, l_tape_decoder, l_saved_programs))
+		l_checkpoint_position = g_input_wav_file_sample_index;
 	else
-		l_current_sector_length = in_sector_length;
+		l_checkpoint_enabled = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Updates middle frequency period length
-static void UpdateMiddleFrequency(uint32_t in_frequency, uint32_t in_measured_period_length)
+// Releases the checkpoint of the input
+static void FreeCheckpoint(void)
 {
-	int frequency_to_remove = l_middle_period_buffer[l_middle_period_buffer_index];
-	int middle_period_length = (in_measured_period_length * in_frequency + FREQ_MIDDLE / 2) / FREQ_MIDDLE;
+	free(l_saved_programs);
+	l_saved_programs = NULL;
+	l_saved_program_count = 0;
+	l_saved_program_capacity = 0;
+	l_checkpoint_enabled = false;
+	l_checkpoint_position = 0;
+	l_checkpoint_program_pending = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Positions the input to the given sample and settles the signal processing of the decoder by the samples before it.
+// The pre-roll covers the latency of the decoder and one more block (history of the filter and the level control).
+// Returns false when the input can't be positioned.
+static bool WarmUpDecoder(uint32_t in_start_position)
+{
+	uint32_t preroll_length;
+	uint32_t position;
+	size_t sample_count;
+
+	preroll_length = (uint32_t)TDGetLatency(l_tape_decoder) + WAVE_SAMPLE_BLOCK_LENGTH;
+	position = (in_start_position > preroll_length) ? in_start_position - preroll_length : 0;
 
-	l_middle_period_buffer[l_middle_period_buffer_index] = middle_period_length;
+	if(!WMSeekInput(position))
+		return false;
+
+	while(position < in_start_position)
+	{
+		sample_count = in_start_position - position;
+		if(sample_count > WAVE_SAMPLE_BLOCK_LENGTH)
+			sample_count = WAVE_SAMPLE_BLOCK_LENGTH;
 
-	l_middle_period_buffer_index++;
-	if( l_middle_period_buffer_index >= MIDDLE_PERIOD_BUFFER_LENGTH )
-		l_middle_period_buffer_index = 0;
+		sample_count = WMReadSamples(l_sample_block, sample_count);
+		if(sample_count == 0)
+			break;
 
-	l_middle_period_sum = l_middle_period_sum - frequency_to_remove + middle_period_length;
-	l_middle_period = (uint16_t)(l_middle_period_sum / MIDDLE_PERIOD_BUFFER_LENGTH);
+		TDWarmUp(l_tape_decoder, l_sample_block, sample_count);
+		position += (uint32_t)sample_count;
+	}
+
+	return true;
 }
@@ -0,0 +1,126 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Decoder checkpoint file (resumes interrupted wav file decoding)           */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "TapeCheckpoint.h"
+#include "FileUtils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define TEMPORARY_FILE_EXTENSION L"tc$"
+
+///////////////////////////////////////////////////////////////////////////////
+// Loads the checkpoint file of the wav file. Returns NULL when the checkpoint doesn't exist or it is invalid, the
+// returned saved program list must be released by the caller. The checkpoint is valid only for the wav file with the
+// given identification. The inverted reader state is loaded only when the checkpoint contains it (its reader state size is non zero).
+TCSavedProgramType* TCLoad(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, TCCheckpointType* out_checkpoint, TapeDecoderType* out_decoder_state, TDReaderStateType* out_inverted_reader_state)
+{
+	wchar_t checkpoint_file_name[MAX_PATH_LENGTH];
+	TCSavedProgramType* programs = NULL;
+	FILE* checkpoint_file;
+
+	TCGetFileName(checkpoint_file_name, in_wav_file_name);
+
+	checkpoint_file = _wfopen(checkpoint_file_name, L"rb");
+	if(checkpoint_file == NULL)
+		return NULL;
+
+	// check header
+	if(fread(out_checkpoint, sizeof(TCCheckpointType), 1, checkpoint_file) == 1 && out_checkpoint->FileID == TC_FILE_ID && out_checkpoint->Version == TC_FILE_VERSION && memcmp(&out_checkpoint->Input, in_input_id, sizeof(WFInputIDType)) == 0 &&
+		out_checkpoint->DecoderStateSize == sizeof(TapeDecoderType) && (out_checkpoint->ReaderStateSize == 0 || out_checkpoint->ReaderStateSize == sizeof(TDReaderStateType)) &&
+		fread(out_decoder_state, sizeof(TapeDecoderType), 1, checkpoint_file) == 1 &&
+		(out_checkpoint->ReaderStateSize == 0 || fread(out_inverted_reader_state, sizeof(TDReaderStateType), 1, checkpoint_file) == 1))
+	{
+		// load saved programs
+		programs = (TCSavedProgramType*)malloc((out_checkpoint->SavedProgramCount + 1) * sizeof(TCSavedProgramType));
+		if(programs != NULL && fread(programs, sizeof(TCSavedProgramType), out_checkpoint->SavedProgramCount, checkpoint_file) != out_checkpoint->SavedProgramCount)
+		{
+			free(programs);
+			programs = NULL;
+		}
+	}
+
+	fclose(checkpoint_file);
+
+	return programs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Saves the checkpoint file of the wav file with the raw state of the decoder. The file is written under a temporary
+// name and renamed afterwards, an interrupted save keeps the previous checkpoint.
+bool TCSave(wchar_t* in_wav_file_name, TCCheckpointType* inout_checkpoint, const TapeDecoderType* in_decoder, const TCSavedProgramType* in_programs)
+{
+	wchar_t checkpoint_file_name[MAX_PATH_LENGTH];
+	wchar_t temporary_file_name[MAX_PATH_LENGTH];
+	FILE* checkpoint_file;
+	bool success = true;
+
+	TCGetFileName(checkpoint_file_name, in_wav_file_name);
+	wcscpy(temporary_file_name, in_wav_file_name);
+	ChangeFileExtension(temporary_file_name, TEMPORARY_FILE_EXTENSION);
+
+	checkpoint_file = _wfopen(temporary_file_name, L"wb");
+	if(checkpoint_file == NULL)
+		return false;
+
+	inout_checkpoint->FileID = TC_FILE_ID;
+	inout_checkpoint->Version = TC_FILE_VERSION;
+	inout_checkpoint->DecoderStateSize = sizeof(TapeDecoderType);
+	inout_checkpoint->ReaderStateSize = (in_decoder->InvertedReader != NULL) ? sizeof(TDReaderStateType) : 0;
+
+	if(fwrite(inout_checkpoint, sizeof(TCCheckpointType), 1, checkpoint_file) != 1)
+		success = false;
+
+	if(success && fwrite(in_decoder, sizeof(TapeDecoderType), 1, checkpoint_file) != 1)
+		success = false;
+
+	if(success && in_decoder->InvertedReader != NULL && fwrite(in_decoder->InvertedReader, sizeof(TDReaderStateType), 1, checkpoint_file) != 1)
+		success = false;
+
+	if(success && fwrite(in_programs, sizeof(TCSavedProgramType), inout_checkpoint->SavedProgramCount, checkpoint_file) != inout_checkpoint->SavedProgramCount)
+		success = false;
+
+	if(fclose(checkpoint_file) != 0)
+		success = false;
+
+	if(success)
+		success = (MoveFileExW(temporary_file_name, checkpoint_file_name, MOVEFILE_REPLACE_EXISTING) != 0);
+
+	if(!success)
+		_wremove(temporary_file_name);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Deletes the checkpoint file of the wav file (decoding of the wav file is finished)
+void TCDelete(wchar_t* in_wav_file_name)
+{
+	wchar_t checkpoint_file_name[MAX_PATH_LENGTH];
+
+	TCGetFileName(checkpoint_file_name, in_wav_file_name);
+
+	_wremove(checkpoint_file_name);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the name of the checkpoint file (stored beside the wav file)
+void TCGetFileName(wchar_t* out_checkpoint_file_name, wchar_t* in_wav_file_name)
+{
+	wcscpy(out_checkpoint_file_name, in_wav_file_name);
+	ChangeFileExtension(out_checkpoint_file_name, TC_FILE_EXTENSION);
+}
@@ -0,0 +1,1174 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape signal decoder (FSK demodulator and tape block reader)               */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include "CRC.h"
+#include "TapeDecoder.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TD_X86_SIMD
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define SECTOR_END_PERIOD_COUNT 5
+#define SIGNAL_LOSS_PERIOD_LENGTH (PERIOD_SYNC * (100 + LEADING_FREQUENCY_TOLERANCE) / 100)	// signal is lost when the period is longer
+#define SECTOR_BYTE_COUNT (sizeof(TAPESectorHeaderType) + TAPE_MAX_BLOCK_LENGTH + sizeof(TAPESectorEndType))	// bytes of a full sector
+#define DATA_BLOCK_SKIP_MARGIN 10			// skipped part of the data blocks is shortened by this percentage (tape speed variation)
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static LoadStatus DecodeSamplesWithoutCrossing(TDReaderStateType* in_reader, int in_sample_length, size_t* inout_sample_count);
+static LoadStatus DecodeZeroCrossing(TDReaderStateType* in_reader, int in_sample_length, int in_oversampled_length);
+static size_t FindZeroCrossingsInRange(SignalPhaseType* inout_phase, int32_t* inout_previous_sample, const int32_t* in_samples, size_t in_first_sample, size_t in_last_sample, int in_sample_length, TDZeroCrossingType* out_crossings);
+static LoadStatus DecoderRestart(TDReaderStateType* in_reader);
+static void UpdateMiddleFrequency(TDReaderStateType* in_reader, uint32_t in_frequency, uint32_t in_measured_period_length);
+static LoadStatus StoreByte(TDReaderStateType* in_reader, uint8_t in_data_byte);
+static int IntABS(int in_value);
+static bool StoreByteInStruct(TDReaderStateType* in_reader, uint8_t in_data_byte, void* in_struct, size_t in_size, bool in_add_to_crc);
+static void SetSectorLength(TDReaderStateType* in_reader, uint8_t in_sector_length);
+static void ChangeReaderStatus(TDReaderStateType* in_reader, TapeReaderStatusType in_new_status);
+static bool IsDecoderWaiting(TDReaderStateType* in_reader);
+static bool IsSignalBlock(const int32_t* in_samples, size_t in_sample_count);
+static uint32_t GetDataBlockSkipLength(uint8_t in_sector_count, uint16_t in_middle_period);
+static void StartInvertedReader(TapeDecoderType* in_decoder);
+static LoadStatus SelectPolarity(TapeDecoderType* in_decoder, LoadStatus in_load_status, LoadStatus in_inverted_load_status);
+
+///////////////////////////////////////////////////////////////////////////////
+// Global variables
+uint8_t g_decimation_factor = 1;		// sample rate reduction after the band pass filter (1 - decoding at the input sample rate)
+bool g_signal_gate = false;					// skip input blocks without tape signal (new decoders are created with this setting)
+bool g_dual_polarity = false;				// read blocks with both signal polarities (new decoders are created with this setting)
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates decoder instance (filters are designed using the shared filter design cache, create decoders from one thread).
+// When decimation is used the level control and the demodulator run at the reduced sample rate, the period lengths are
+// measured in input sample units.
+TapeDecoderType* TDCreate(FilterTypes in_filter_type, int in_decimation_factor)
+{
+	TapeDecoderType* decoder;
+
+	decoder = (TapeDecoderType*)calloc(1, sizeof(TapeDecoderType));
+	if(decoder == NULL)
+		return NULL;
+
+	if(!DMInit(&decoder->Decimator, in_decimation_factor))
+	{
+		free(decoder);
+		return NULL;
+	}
+
+	WFInit(&decoder->Filter, in_filter_type);
+	WLCInit(&decoder->LevelControl, WLC_DEFAULT_LOOK_AHEAD_LENGTH / in_decimation_factor);
+	WLCSetMode(&decoder->LevelControl, WLCMT_NoiseKiller);
+
+	decoder->SampleLength = OVERSAMPLING_RATE * in_decimation_factor;
+	decoder->GateEnabled = g_signal_gate;
+	decoder->FlushSampleCount = WFGetLatency(&decoder->Filter) + DMGetLatency(&decoder->Decimator);
+
+	decoder->Reader.DecoderState = DST_Idle;
+	decoder->Reader.ReaderStatus = TRST_Idle;
+	decoder->Reader.CurrentPhase = SPT_Low;
+	decoder->Reader.PhaseMode = SPT_Low;
+	decoder->Reader.HeaderBlockValid = false;
+	decoder->Reader.LevelControlMode = WLCMT_NoiseKiller;
+
+	// the inverted reader decodes the signal processed by this instance (its state is copied from the reader at the sync)
+	if(g_dual_polarity)
+	{
+		decoder->InvertedReader = (TDReaderStateType*)malloc(sizeof(TDReaderStateType));
+		if(decoder->InvertedReader == NULL)
+		{
+			TDDestroy(decoder);
+			return NULL;
+		}
+	}
+
+	return decoder;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases decoder instance
+void TDDestroy(TapeDecoderType* in_decoder)
+{
+	if(in_decoder == NULL)
+		return;
+
+	WLCClose(&in_decoder->LevelControl);
+	free(in_decoder->InvertedReader);
+	free(in_decoder);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs samples through the filter, decimator and level control. Samples are accepted only when the previous block is
+// decoded, returns the number of accepted samples (at most WAVE_SAMPLE_BLOCK_LENGTH). When the gate is enabled the
+// blocks without tape signal are skipped (the processed block is empty) while the decoder waits for a block leading.
+size_t TDFeedSamples(TapeDecoderType* in_decoder, const int32_t* in_samples, size_t in_sample_count)
+{
+	SignalPhaseType phase;
+	size_t processed_sample_count;
+
+	if(in_decoder->ProcessedBlockPos < in_decoder->ProcessedBlockLength)
+		return 0;
+
+	if(in_sample_count > WAVE_SAMPLE_BLOCK_LENGTH)
+		in_sample_count = WAVE_SAMPLE_BLOCK_LENGTH;
+
+	if(in_decoder->GateEnabled)
+	{
+		if(IsDecoderWaiting(&in_decoder->Reader) && !IsSignalBlock(in_samples, in_sample_count))
+		{
+			memcpy(in_decoder->GateWarmUpBlock, in_samples, in_sample_count * sizeof(int32_t));
+			in_decoder->GateWarmUpLength = in_sample_count;
+			in_decoder->SkippedSampleCount += (uint32_t)in_sample_count;
+
+			in_decoder->CrossingCount = 0;
+			in_decoder->CrossingIndex = 0;
+			in_decoder->ProcessedBlockLength = 0;
+			in_decoder->ProcessedBlockPos = 0;
+
+			return in_sample_count;
+		}
+
+		// the last skipped block settles the filter and the level control before the signal (its output is dropped)
+		if(in_decoder->GateWarmUpLength > 0)
+		{
+			TDWarmUp(in_decoder, in_decoder->GateWarmUpBlock, in_decoder->GateWarmUpLength);
+			in_decoder->GateWarmUpLength = 0;
+		}
+	}
+
+	WFProcessSamples(&in_decoder->Filter, in_samples, in_decoder->ProcessedBlock, in_sample_count);		// Digital filter
+	processed_sample_count = DMProcessSamples(&in_decoder->Decimator, in_decoder->ProcessedBlock, in_decoder->ProcessedBlock, in_sample_count);	// Decimator
+	WLCProcessSamples(&in_decoder->LevelControl, in_decoder->ProcessedBlock, in_decoder->ProcessedBlock, processed_sample_count);	// Amplitude controller
+
+	// the whole previous block is decoded, so the phase of the decoder is the phase at the end of the previous block
+	phase = in_decoder->Reader.CurrentPhase;
+	in_decoder->CrossingCount = TDFindZeroCrossings(&phase, &in_decoder->PreviousSample, in_decoder->ProcessedBlock, processed_sample_count, in_decoder->SampleLength, in_decoder->Crossings);
+	in_decoder->CrossingIndex = 0;
+
+	in_decoder->ProcessedBlockLength = processed_sample_count;
+	in_decoder->ProcessedBlockPos = 0;
+
+	return in_sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pushes silence through the filter at the end of the input to get its delayed samples,
+// returns the number of processed samples (zero when the filter is empty)
+size_t TDFlush(TapeDecoderType* in_decoder)
+{
+	size_t sample_count;
+
+	if(in_decoder->ProcessedBlockPos < in_decoder->ProcessedBlockLength)
+		return 0;
+
+	sample_count = in_decoder->FlushSampleCount;
+	if(sample_count > WAVE_SAMPLE_BLOCK_LENGTH)
+		sample_count = WAVE_SAMPLE_BLOCK_LENGTH;
+
+	memset(in_decoder->ProcessedBlock, 0, sample_count * sizeof(int32_t));
+	in_decoder->FlushSampleCount -= sample_count;
+
+	return TDFeedSamples(in_decoder, in_decoder->ProcessedBlock, sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs samples through the filter, decimator and level control without decoding them (settles the signal processing
+// before the decoded samples). The phase of the decoder follows the signal. Can be called only when the previous block
+// is decoded.
+void TDWarmUp(TapeDecoderType* in_decoder, const int32_t* in_samples, size_t in_sample_count)
+{
+	SignalPhaseType phase;
+	size_t processed_sample_count;
+
+	if(in_sample_count > WAVE_SAMPLE_BLOCK_LENGTH)
+		in_sample_count = WAVE_SAMPLE_BLOCK_LENGTH;
+
+	WFProcessSamples(&in_decoder->Filter, in_samples, in_decoder->ProcessedBlock, in_sample_count);
+	processed_sample_count = DMProcessSamples(&in_decoder->Decimator, in_decoder->ProcessedBlock, in_decoder->ProcessedBlock, in_sample_count);
+	WLCProcessSamples(&in_decoder->LevelControl, in_decoder->ProcessedBlock, in_decoder->ProcessedBlock, processed_sample_count);
+
+	phase = in_decoder->Reader.CurrentPhase;
+	TDFindZeroCrossings(&phase, &in_decoder->PreviousSample, in_decoder->ProcessedBlock, processed_sample_count, in_decoder->SampleLength, in_decoder->Crossings);
+	in_decoder->Reader.CurrentPhase = phase;
+	in_decoder->CrossingCount = 0;
+	in_decoder->CrossingIndex = 0;
+
+	in_decoder->ProcessedBlockLength = 0;
+	in_decoder->ProcessedBlockPos = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Restarts the decoder after the input was repositioned (the fed samples are dropped). When the middle period of the
+// block leading is known (non zero) the decoder starts inside the leading with the preloaded middle period average,
+// only TD_PRIMED_LEADING_PERIOD_COUNT leading periods are needed before the sync.
+void TDSeek(TapeDecoderType* in_decoder, uint16_t in_middle_period)
+{
+	int i;
+
+	in_decoder->ProcessedBlockLength = 0;
+	in_decoder->ProcessedBlockPos = 0;
+	in_decoder->FlushSampleCount = WFGetLatency(&in_decoder->Filter) + DMGetLatency(&in_decoder->Decimator);
+	in_decoder->CrossingCount = 0;
+	in_decoder->CrossingIndex = 0;
+	in_decoder->GateWarmUpLength = 0;
+	in_decoder->Reader.SkipSampleCount = 0;
+	in_decoder->Reader.PeriodHighLength = 0;
+	in_decoder->Reader.PeriodLowLength = 0;
+	in_decoder->InvertedReaderActive = false;
+
+	DecoderRestart(&in_decoder->Reader);
+	WLCSetMode(&in_decoder->LevelControl, in_decoder->Reader.LevelControlMode);
+
+	if(in_middle_period > 0)
+	{
+		for(i = 0; i < TD_MIDDLE_PERIOD_BUFFER_LENGTH; i++)
+			in_decoder->Reader.MiddlePeriodBuffer[i] = in_middle_period;
+
+		in_decoder->Reader.MiddlePeriodSum = (uint32_t)in_middle_period * TD_MIDDLE_PERIOD_BUFFER_LENGTH;
+		in_decoder->Reader.MiddlePeriod = in_middle_period;
+		in_decoder->Reader.MiddlePeriodBufferIndex = TD_MIDDLE_PERIOD_BUFFER_LENGTH - TD_PRIMED_LEADING_PERIOD_COUNT;
+		in_decoder->Reader.PrimedCrossingCount = 2;
+		in_decoder->Reader.DecoderState = DST_Primed;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the delay of the signal processing (filter, decimator and level control look ahead) in input samples
+size_t TDGetLatency(TapeDecoderType* in_decoder)
+{
+	return WFGetLatency(&in_decoder->Filter) + DMGetLatency(&in_decoder->Decimator) + (size_t)in_decoder->LevelControl.LookAheadLength * in_decoder->Decimator.Factor;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decodes the fed samples, stops after the sample where the decoder status changes. When the inverted reader is active
+// it decodes the same samples and crossings, the polarity which loads a valid sector first is kept.
+// Returns LS_Unknown when all samples are decoded, LS_Success when the program is loaded, LS_Error when the signal is lost.
+LoadStatus TDPoll(TapeDecoderType* in_decoder)
+{
+	TDReaderStateType* inverted_reader = in_decoder->InvertedReader;
+	LoadStatus load_status = LS_Unknown;
+	LoadStatus inverted_load_status;
+	DecoderStateType decoder_state;
+	size_t crossing_pos;
+	size_t sample_count;
+	size_t inverted_sample_count;
+	bool inverted_active;
+
+	while(in_decoder->ProcessedBlockPos < in_decoder->ProcessedBlockLength && load_status == LS_Unknown)
+	{
+		if(in_decoder->CrossingIndex < in_decoder->CrossingCount)
+			crossing_pos = in_decoder->Crossings[in_decoder->CrossingIndex].SamplePos;
+		else
+			crossing_pos = in_decoder->ProcessedBlockLength;
+
+		inverted_active = in_decoder->InvertedReaderActive;
+		inverted_load_status = LS_Unknown;
+		decoder_state = in_decoder->Reader.DecoderState;
+
+		if(in_decoder->ProcessedBlockPos < crossing_pos)
+		{
+			// samples until the next zero crossing
+			sample_count = crossing_pos - in_decoder->ProcessedBlockPos;
+			load_status = DecodeSamplesWithoutCrossing(&in_decoder->Reader, in_decoder->SampleLength, &sample_count);
+
+			if(inverted_active)
+			{
+				inverted_sample_count = sample_count;
+				inverted_load_status = DecodeSamplesWithoutCrossing(inverted_reader, in_decoder->SampleLength, &inverted_sample_count);
+			}
+
+			in_decoder->ProcessedBlockPos += sample_count;
+		}
+		else
+		{
+			// sample where the zero crossing was found
+			load_status = DecodeZeroCrossing(&in_decoder->Reader, in_decoder->SampleLength, in_decoder->Crossings[in_decoder->CrossingIndex].OversampledLength);
+
+			if(inverted_active)
+				inverted_load_status = DecodeZeroCrossing(inverted_reader, in_decoder->SampleLength, in_decoder->Crossings[in_decoder->CrossingIndex].OversampledLength);
+
+			in_decoder->CrossingIndex++;
+			in_decoder->ProcessedBlockPos++;
+		}
+
+		if(inverted_active)
+			load_status = SelectPolarity(in_decoder, load_status, inverted_load_status);
+		else if(inverted_reader != NULL && decoder_state == DST_SyncDetected && in_decoder->Reader.DecoderState == DST_ReadingData)
+			StartInvertedReader(in_decoder);	// the other phase mode is read by the inverted reader until the first valid sector
+	}
+
+	// level control mode is changed by the demodulator of the selected polarity
+	WLCSetMode(&in_decoder->LevelControl, in_decoder->Reader.LevelControlMode);
+
+	return load_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the zero crossings (half period ends) of the samples. A crossing is where the sign of the sample differs from the
+// sign of the last non zero sample (phase). The crossing position is interpolated between the previous and the crossing
+// sample, sample length is the distance of the samples in 1/OVERSAMPLING_RATE input sample units. Phase and previous
+// sample are updated, returns the number of crossings.
+size_t TDFindZeroCrossings(SignalPhaseType* inout_phase, int32_t* inout_previous_sample, const int32_t* in_samples, size_t in_sample_count, int in_sample_length, TDZeroCrossingType* out_crossings)
+{
+	size_t crossing_count = 0;
+	size_t i = 0;
+#ifdef TD_X86_SIMD
+	__m128i zero = _mm_setzero_si128();
+	__m128i first_samples;
+	__m128i second_samples;
+	int positive_mask;
+	int negative_mask;
+#endif
+
+#ifdef TD_X86_SIMD
+	// eight samples at a time: samples having the sign of the current phase (or zero) can be skipped
+	for(; i + 8 <= in_sample_count; i += 8)
+	{
+		first_samples = _mm_loadu_si128((const __m128i*)&in_samples[i]);
+		second_samples = _mm_loadu_si128((const __m128i*)&in_samples[i + 4]);
+
+		if(*inout_phase == SPT_Low)
+		{
+			positive_mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(first_samples, zero))) | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(second_samples, zero)));
+			if(positive_mask == 0)
+				continue;
+		}
+		else
+		{
+			negative_mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(first_samples, zero))) | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(second_samples, zero)));
+			if(negative_mask == 0)
+				continue;
+		}
+
+		// there is at least one crossing
+		if(i > 0)
+			*inout_previous_sample = in_samples[i - 1];
+
+		crossing_count += FindZeroCrossingsInRange(inout_phase, inout_previous_sample, in_samples, i, i + 8, in_sample_length, out_crossings + crossing_count);
+	}
+
+	if(i > 0)
+		*inout_previous_sample = in_samples[i - 1];
+#endif
+
+	crossing_count += FindZeroCrossingsInRange(inout_phase, inout_previous_sample, in_samples, i, in_sample_count, in_sample_length, out_crossings + crossing_count);
+
+	return crossing_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clears the program buffer before loading the next program
+void TDResetProgram(TapeDecoderType* in_decoder)
+{
+	in_decoder->Reader.Program.BufferLength = 0;
+	in_decoder->Reader.Program.BufferIndex = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Keeps the partially loaded program when the signal was lost after a valid header block (remaining part of the buffer
+// is zeroed and the program is flagged with CRC error). Returns true when the program can be saved.
+bool TDKeepPartialProgram(TapeDecoderType* in_decoder)
+{
+	TDProgramType* program = &in_decoder->Reader.Program;
+
+	if(!in_decoder->Reader.HeaderBlockValid)
+		return false;
+
+	// zero remaining part of the buffer
+	while(program->BufferIndex < program->BufferLength)
+		program->Buffer[program->BufferIndex++] = 0;
+
+	// flag as CRC error
+	program->CRCErrorDetected = true;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Restores the complete decoder state (signal processing, demodulator, reader and the inverted reader) saved by a
+// checkpoint. The state must be created with the same filter type, decimation factor and polarity setting, returns
+// false when it doesn't match this decoder.
+bool TDSetState(TapeDecoderType* in_decoder, const TapeDecoderType* in_state, const TDReaderStateType* in_inverted_reader)
+{
+	TDReaderStateType* inverted_reader = in_decoder->InvertedReader;
+	FIRKernelType fir_kernel = in_decoder->Filter.FIRKernel;
+
+	if(in_state->Filter.Type != in_decoder->Filter.Type || in_state->Decimator.Factor != in_decoder->Decimator.Factor || (in_inverted_reader == NULL) != (inverted_reader == NULL))
+		return false;
+
+	*in_decoder = *in_state;
+
+	// the inverted reader and the FIR kernel (selected by the CPU features) belong to this instance
+	in_decoder->InvertedReader = inverted_reader;
+	in_decoder->Filter.FIRKernel = fir_kernel;
+	if(inverted_reader != NULL)
+		*inverted_reader = *in_inverted_reader;
+
+	return true;
+}
+
+/*****************************************************************************/
+/* Local functions                                                           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Restarts decoder
+static LoadStatus DecoderRestart(TDReaderStateType* in_reader)
+{
+	LoadStatus load_status = LS_Unknown;
+
+	if(in_reader->ReaderStatus == TRST_Data)
+	{
+		load_status = LS_Error;
+	}
+
+	// reset decoder
+	in_reader->DecoderState = DST_Idle;
+	in_reader->LevelControlMode = WLCMT_NoiseKiller;
+	in_reader->ReaderStatus = TRST_Idle;
+
+	return load_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process samples without zero crossing (only the signal loss is detected), stops after the sample where the signal is lost
+static LoadStatus DecodeSamplesWithoutCrossing(TDReaderStateType* in_reader, int in_sample_length, size_t* inout_sample_count)
+{
+	size_t sample_count = *inout_sample_count;
+	int64_t period_length = (int64_t)in_reader->PeriodHighLength + in_reader->PeriodLowLength;
+	int64_t loss_pos;
+	LoadStatus load_status = LS_Unknown;
+
+	// index of the first sample where the period is too long (the period of the sample before is checked)
+	if(period_length > SIGNAL_LOSS_PERIOD_LENGTH)
+		loss_pos = 0;
+	else
+		loss_pos = (SIGNAL_LOSS_PERIOD_LENGTH - period_length) / in_sample_length + 1;
+
+	// signal lost (restarting the decoder again on the remaining samples doesn't change anything)
+	if(loss_pos < (int64_t)sample_count)
+	{
+		load_status = DecoderRestart(in_reader);
+		if(load_status != LS_Unknown)
+			sample_count = (size_t)loss_pos + 1;
+	}
+
+	// current half period gets longer
+	if(in_reader->CurrentPhase == SPT_Low)
+		in_reader->PeriodLowLength += (int)(sample_count * in_sample_length);
+	else
+		in_reader->PeriodHighLength += (int)(sample_count * in_sample_length);
+
+	*inout_sample_count = sample_count;
+
+	return load_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process zero crossing (end of the half period). Oversampled length is the position of the crossing from the previous sample.
+static LoadStatus DecodeZeroCrossing(TDReaderStateType* in_reader, int in_sample_length, int in_oversampled_length)
+{
+	uint32_t period_length;
+	int high_period_length;
+	int low_period_length;
+	SignalPhaseType current_phase;
+	LoadStatus load_status = LS_Unknown;
+
+	// cache period length
+	high_period_length = in_reader->PeriodHighLength;
+	low_period_length = in_reader->PeriodLowLength;
+	current_phase = in_reader->CurrentPhase;
+
+	// close the half period
+	switch(current_phase)
+	{
+		// zero crossing in rising direction
+		case SPT_Low:
+			in_reader->PeriodLowLength += in_oversampled_length;
+			period_length = in_reader->PeriodHighLength + in_reader->PeriodLowLength;
+			in_reader->PeriodHighLength = in_sample_length - in_oversampled_length;
+			in_reader->CurrentPhase = SPT_High;
+			break;
+
+		// zero crossing in falling direction
+		case SPT_High:
+			in_reader->PeriodHighLength += in_oversampled_length;
+			period_length = in_reader->PeriodHighLength + in_reader->PeriodLowLength;
+			in_reader->PeriodLowLength = in_sample_length - in_oversampled_length;
+			in_reader->CurrentPhase = SPT_Low;
+			break;
+	}
+
+	switch (in_reader->DecoderState)
+	{
+		// waiting for an apropriate signal
+		case DST_Idle:
+			// looking for leading signal
+			in_reader->MiddlePeriodBufferIndex = 0;
+			in_reader->DecoderState = DST_WaitingForLeading;
+			break;
+
+		// first crossings after seeking into a block leading (the first full period ends at the second crossing)
+		case DST_Primed:
+			in_reader->PrimedCrossingCount--;
+			if(in_reader->PrimedCrossingCount == 0)
+				in_reader->DecoderState = DST_WaitingForLeading;
+			break;
+
+		// waiting for leading signal
+		case DST_WaitingForLeading:
+		{
+			uint32_t leading_min = PERIOD_LEADING - (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
+			uint32_t leading_max = PERIOD_LEADING + (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
+
+			// check for leading frequency
+			if(period_length >= leading_min && period_length <= leading_max)
+			{
+				// frequency is ok, store it for the running average
+				UpdateMiddleFrequency(in_reader, FREQ_LEADING, period_length);
+
+				// we have one buffer of leading frequency data -> averrage is valid
+				if(in_reader->MiddlePeriodBufferIndex == 0)
+				{
+					in_reader->DecoderState = DST_WaitingForSync;
+					in_reader->LevelControlMode = WLCMT_LevelControl;
+				}
+			}
+			else
+			{
+				load_status = DecoderRestart(in_reader);
+			}
+		}
+		break;
+
+		// waiting for sync signal
+		case DST_WaitingForSync:
+			{
+				uint32_t leading_min = PERIOD_LEADING - (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
+				uint32_t leading_max = PERIOD_LEADING + (PERIOD_LEADING * LEADING_FREQUENCY_TOLERANCE + 50) / 100;
+				uint32_t expected_sync_period = (FREQ_MIDDLE * in_reader->MiddlePeriod + FREQ_SYNC / 2) / FREQ_SYNC;
+				uint32_t sync_min = expected_sync_period - (PERIOD_SYNC * SYNC_FREQUENCY_TOLERANCE + 50) / 100;
+				uint32_t sync_max = expected_sync_period + (PERIOD_SYNC * SYNC_FREQUENCY_TOLERANCE + 50) / 100;
+
+				// check for leading frequency
+				if(period_length >= leading_min && period_length <= leading_max)
+				{
+					// frequency is ok, store it for the running average
+					UpdateMiddleFrequency(in_reader, FREQ_LEADING, period_length);	
+				}
+				else
+				{
+					// check for sync frequency
+					if(period_length >= sync_min && period_length <= sync_max)
+					{
+						switch(current_phase)
+						{
+							case SPT_High:
+								in_reader->SyncFirstHalfPeriodLength = high_period_length;
+								in_reader->SyncSecondHalfPeriodLength = low_period_length;
+								in_reader->DecoderState = DST_SyncDetected;
+								break;
+
+							case SPT_Low:
+								in_reader->SyncFirstHalfPeriodLength = high_period_length;
+								in_reader->SyncSecondHalfPeriodLength = low_period_length;
+								in_reader->DecoderState = DST_SyncDetected;
+								break;
+						}
+					}
+					else
+					{
+						if(period_length < leading_min || period_length > sync_max)
+							load_status = DecoderRestart(in_reader);
+					}
+				}
+			}
+			break;
+
+		//	Sync period length detected
+		case DST_SyncDetected:
+			{
+				uint32_t expected_sync_half_period = (FREQ_MIDDLE * in_reader->MiddlePeriod / FREQ_SYNC + 1) / 2;
+				uint32_t expected_leading_half_period = (FREQ_MIDDLE * in_reader->MiddlePeriod / FREQ_LEADING + 1) / 2;
+				uint32_t expected_zero_half_period = (FREQ_MIDDLE * in_reader->MiddlePeriod / FREQ_ZERO + 1) / 2;
+				uint32_t sync_third_half_period_length;
+				uint8_t first_score;
+				uint8_t second_score;
+
+				// determine second and third half period length
+				switch(current_phase)
+				{
+					case SPT_High:
+						sync_third_half_period_length = high_period_length;
+						break;
+
+					case SPT_Low:
+						sync_third_half_period_length = low_period_length;
+						break;
+				}
+
+				//Now we have the length of the three previous half period
+				// determine which two contans a valid sync period. It can be the first two or second two half period.
+				// scoring algorithm will decide
+				first_score = 0;
+				second_score = 0;
+
+				// Score based on half period symmetry sync period is most probable has two simmetrical length half period
+				if(IntABS(in_reader->SyncFirstHalfPeriodLength - in_reader->SyncSecondHalfPeriodLength) < IntABS(in_reader->SyncSecondHalfPeriodLength-sync_third_half_period_length))
+				{
+					first_score++;
+				}
+				else
+				{
+					second_score++;
+				}
+
+				// Score based on the first half period. If its length is closer to leading length, probably it belons to leading signal not to the sync.
+				// If its closer to sync then probably it belongs to sync.
+				if(IntABS(in_reader->SyncFirstHalfPeriodLength - expected_leading_half_period) < IntABS(in_reader->SyncFirstHalfPeriodLength-expected_sync_half_period))
+				{
+					second_score++;
+				}
+				else
+				{
+					first_score++;
+				}
+
+				// Score based on the last (third) period length. If the length is closer to zero period length (the first bit after the sync shoud be zero) then 
+				// sync if located at the first period. If its length is closer to sync length than sync is located at the second half period
+				if(IntABS(sync_third_half_period_length - expected_sync_half_period) < IntABS(sync_third_half_period_length - expected_zero_half_period))
+				{
+					second_score++;
+				}
+				else
+				{
+					first_score++;
+				}
+
+				if(first_score > second_score)
+				{
+					// sync is located at the first half
+					in_reader->PhaseMode = in_reader->CurrentPhase;
+				}
+				else
+				{
+					// sync starts at the second half
+					in_reader->PhaseMode = current_phase;
+				}
+
+				// read block header
+				in_reader->DecoderState = DST_ReadingData;
+				in_reader->BitCounter = 0;
+				in_reader->DataByte = 0;
+				in_reader->ValidSectorCount = 0;
+				ChangeReaderStatus(in_reader, TRST_BlockHeader);
+			}
+			break;
+
+			// reading data bits
+			case DST_ReadingData:
+				if(current_phase == in_reader->PhaseMode)
+				{
+					in_reader->DataByte = in_reader->DataByte >> 1;
+					if( period_length <= in_reader->MiddlePeriod )
+					{
+						in_reader->DataByte |= 0x80;
+						UpdateMiddleFrequency(in_reader, FREQ_ONE, period_length);
+					}
+					else
+					{
+						UpdateMiddleFrequency(in_reader, FREQ_ZERO, period_length);
+					}
+
+					in_reader->BitCounter++;
+					if( in_reader->BitCounter >= 8 )
+					{
+						in_reader->BitCounter = 0;
+
+						load_status = StoreByte(in_reader, in_reader->DataByte);
+					}
+				}
+				break;
+
+			// skip sector end signal
+			case DST_SectorEnd:
+				in_reader->SectorEndPeriodCount++;
+				if(in_reader->SectorEndPeriodCount>=SECTOR_END_PERIOD_COUNT)
+					load_status = DecoderRestart(in_reader);
+				break;
+		}
+
+	return load_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the zero crossings of the samples between the first and last sample index (last is not included)
+static size_t FindZeroCrossingsInRange(SignalPhaseType* inout_phase, int32_t* inout_previous_sample, const int32_t* in_samples, size_t in_first_sample, size_t in_last_sample, int in_sample_length, TDZeroCrossingType* out_crossings)
+{
+	SignalPhaseType phase = *inout_phase;
+	int32_t previous_sample = *inout_previous_sample;
+	int32_t sample;
+	size_t crossing_count = 0;
+	size_t i;
+
+	for(i = in_first_sample; i < in_last_sample; i++)
+	{
+		sample = in_samples[i];
+
+		if((phase == SPT_Low && sample > 0) || (phase == SPT_High && sample < 0))
+		{
+			out_crossings[crossing_count].SamplePos = (uint16_t)i;
+			out_crossings[crossing_count].OversampledLength = (uint16_t)(((int64_t)in_sample_length * previous_sample) / (previous_sample - sample));
+			crossing_count++;
+
+			phase = (phase == SPT_Low) ? SPT_High : SPT_Low;
+		}
+
+		previous_sample = sample;
+	}
+
+	*inout_phase = phase;
+	*inout_previous_sample = previous_sample;
+
+	return crossing_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Integer absolute value
+static int IntABS(int in_value)
+{
+	if(in_value < 0)
+		return -in_value;
+	else
+		return in_value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores data byte readed by the decoder
+static LoadStatus StoreByte(TDReaderStateType* in_reader, uint8_t in_data_byte)
+{
+	LoadStatus load_status = LS_Unknown;
+
+	switch (in_reader->ReaderStatus)
+	{
+		// reading header
+		case TRST_BlockHeader:
+			// store block header
+			if(StoreByteInStruct(in_reader, in_data_byte, &in_reader->BlockHeader, sizeof(in_reader->BlockHeader), false))
+			{
+				// check block
+				if(TAPEValidateBlockHeader(&in_reader->BlockHeader))
+				{
+					// load sector header
+					ChangeReaderStatus(in_reader, TRST_SectorHeader);
+
+					// new block header is coming -> invalidate current
+					if(in_reader->BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
+						in_reader->HeaderBlockValid = false;
+
+					// if data block  is coming validata block header
+					if (in_reader->BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_DATA)
+						in_reader->HeaderBlockValid = true;
+
+					in_reader->Program.BufferIndex = 0;
+					in_reader->Program.CRCErrorDetected = false;
+					in_reader->CRC = g_checksum_start;
+					in_reader->CRC = CRCUpdateBlock(in_reader->CRC, ((uint8_t*)&in_reader->BlockHeader + 1), sizeof(in_reader->BlockHeader)-1);
+
+					// header only mode: data block is reported, the caller skips it and the decoder waits for the next block
+					if(in_reader->HeaderOnly && in_reader->BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_DATA)
+					{
+						in_reader->SkipSampleCount = GetDataBlockSkipLength(in_reader->BlockHeader.SectorsInBlock, in_reader->MiddlePeriod);
+						in_reader->HeaderBlockValid = false;
+						DecoderRestart(in_reader);
+						load_status = LS_Success;
+					}
+				}
+				else
+				{
+					ChangeReaderStatus(in_reader, TRST_Idle);
+					load_status = DecoderRestart(in_reader);
+				}
+			}
+			break;
+
+		// Load sector header
+		case TRST_SectorHeader:
+			if(StoreByteInStruct(in_reader, in_data_byte, &in_reader->SectorHeader, sizeof(in_reader->SectorHeader), true))
+			{
+				// check sector header
+				switch(in_reader->BlockHeader.BlockType)
+				{
+					// header block
+					case TAPE_BLOCKHDR_TYPE_HEADER:
+						// in the case of header block the sector number must be zero
+						if(in_reader->SectorHeader.SectorNumber == 0)
+						{
+							SetSectorLength(in_reader, in_reader->SectorHeader.BytesInSector);
+							ChangeReaderStatus(in_reader, TRST_HeaderFileNameLength);
+						}
+						else
+						{
+							ChangeReaderStatus(in_reader, TRST_Idle);
+							load_status = DecoderRestart(in_reader);
+						}
+						break;
+
+					// data block
+					case TAPE_BLOCKHDR_TYPE_DATA:
+						if (in_reader->Program.BufferLength == 0)
+							in_reader->Program.BufferLength = in_reader->BlockHeader.SectorsInBlock * TAPE_MAX_BLOCK_LENGTH;
+
+						SetSectorLength(in_reader, in_reader->SectorHeader.BytesInSector);
+						ChangeReaderStatus(in_reader, TRST_Data);
+						break;
+
+					// unknown block
+					default:
+						ChangeReaderStatus(in_reader, TRST_Idle);
+						load_status = DecoderRestart(in_reader);
+						break;
+				}
+			}
+			break;
+
+		// File name length
+		case TRST_HeaderFileNameLength:
+			if(in_reader->DataByte <= DB_MAX_FILENAME_LENGTH)
+			{
+				in_reader->FileNameLength = in_data_byte;
+				in_reader->FileNameReceived = true;
+				in_reader->CRC = CRCUpdateByte(in_reader->CRC, in_data_byte);
+				if(in_reader->FileNameLength == 0)
+				{
+					in_reader->Program.FileName[0] = '\0';
+					ChangeReaderStatus(in_reader, TRST_HeaderProgramHeader);
+				}
+				else
+				{
+					ChangeReaderStatus(in_reader, TRST_HeaderFileName);
+				}
+
+				in_reader->DataByteIndex = 0;
+			}
+			else
+			{
+				ChangeReaderStatus(in_reader, TRST_Idle);
+				load_status = DecoderRestart(in_reader);
+			}
+			break;
+
+		// File name
+		case TRST_HeaderFileName:
+			if(in_reader->DataByteIndex < DB_MAX_FILENAME_LENGTH)
+			{
+				// replace string terminator character to space
+				if(in_data_byte == '\0')
+					in_reader->Program.FileName[in_reader->DataByteIndex]  = ' ';
+				else
+					in_reader->Program.FileName[in_reader->DataByteIndex] = in_data_byte;
+
+				in_reader->CRC = CRCUpdateByte(in_reader->CRC, in_data_byte);
+
+				in_reader->DataByteIndex++;
+				if(in_reader->DataByteIndex == in_reader->FileNameLength)
+				{
+					in_reader->Program.FileName[in_reader->DataByteIndex] = '\0';
+
+					ChangeReaderStatus(in_reader, TRST_HeaderProgramHeader);
+				}
+			}
+			else
+			{
+				ChangeReaderStatus(in_reader, TRST_Idle);
+				load_status = DecoderRestart(in_reader);
+			}
+			break;
+
+		// program header
+		case TRST_HeaderProgramHeader:
+			if(StoreByteInStruct(in_reader, in_data_byte, &in_reader->ProgramHeader, sizeof(in_reader->ProgramHeader), true))
+			{	
+				ChangeReaderStatus(in_reader, TRST_SectorEnd);
+				in_reader->Program.BufferLength = 0;
+			}
+			break;
+
+		// read sector end
+		case TRST_SectorEnd:
+			if(StoreByteInStruct(in_reader, in_data_byte, &in_reader->SectorEnd, sizeof(in_reader->SectorEnd), false))
+			{
+				in_reader->CRC = CRCUpdateByte(in_reader->CRC, in_reader->SectorEnd.EOFFlag);
+
+				// check CRC
+				switch(in_reader->BlockHeader.BlockType)
+				{
+					// header block
+					case TAPE_BLOCKHDR_TYPE_HEADER:
+						if(in_reader->SectorEnd.CRC == in_reader->CRC || g_checksum_off)
+						{
+							in_reader->Program.Autostart = (in_reader->ProgramHeader.Autorun != 0);
+							in_reader->AutostartReceived = true;
+
+							in_reader->Program.BufferLength = in_reader->ProgramHeader.FileLength;
+
+							in_reader->HeaderBlockValid = true;
+							in_reader->ValidSectorCount++;
+						}
+						else
+							in_reader->HeaderBlockValid = false;
+
+						// header only mode reports every header block (LS_Error when its CRC is invalid)
+						if(in_reader->HeaderOnly)
+							load_status = (in_reader->HeaderBlockValid) ? LS_Success : LS_Error;
+
+						// no more sector in the header block
+						ChangeReaderStatus(in_reader, TRST_Idle);
+						in_reader->DecoderState = DST_Idle;
+						in_reader->SectorEndPeriodCount = 0;
+						break;
+
+					// data block
+					case TAPE_BLOCKHDR_TYPE_DATA:
+						if(in_reader->SectorEnd.CRC != in_reader->CRC && !g_checksum_off)
+							in_reader->Program.CRCErrorDetected = true;
+						else
+							in_reader->ValidSectorCount++;
+
+						// if there is no more data to read
+						if(in_reader->Program.BufferIndex >= in_reader->Program.BufferLength || in_reader->SectorEnd.EOFFlag == TAPE_SECTOR_EOF)
+						{
+							ChangeReaderStatus(in_reader, TRST_Idle);
+							in_reader->DecoderState = DST_Idle;
+							in_reader->SectorEndPeriodCount = 0;
+
+							if(in_reader->HeaderBlockValid)
+							{
+								in_reader->HeaderBlockValid = false;
+								load_status = LS_Success;
+							}
+						}
+						else
+						{
+							// read next sectors
+							ChangeReaderStatus(in_reader, TRST_SectorHeader);
+							in_reader->CRC = g_checksum_start;
+						}
+						break;
+				}
+			}
+			break;
+
+		// read data
+		case TRST_Data:
+			// store data
+			in_reader->Program.Buffer[in_reader->Program.BufferIndex++] = in_data_byte;
+			in_reader->CRC = CRCUpdateByte(in_reader->CRC, in_data_byte);
+			in_reader->DataByteIndex++;
+
+			// check sector end
+			if(in_reader->DataByteIndex >= in_reader->CurrentSectorLength || in_reader->Program.BufferIndex >= in_reader->Program.BufferLength)
+			{
+				// read sector end
+				ChangeReaderStatus(in_reader, TRST_SectorEnd);
+			}
+			break;
+	}
+
+	return load_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Changes reader status to a new value
+static void ChangeReaderStatus(TDReaderStateType* in_reader, TapeReaderStatusType in_new_status)
+{
+	in_reader->DataByteIndex = 0;
+	in_reader->ReaderStatus = in_new_status;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores received byte in a struct
+static bool StoreByteInStruct(TDReaderStateType* in_reader, uint8_t in_data_byte, void* in_struct, size_t in_size, bool in_add_to_crc)
+{
+	if( in_reader->DataByteIndex < in_size)
+	{
+		// store byte
+		*((uint8_t*)in_struct + in_reader->DataByteIndex) = in_data_byte;
+		in_reader->DataByteIndex++;
+
+		// add to CRC
+		if(in_add_to_crc)
+			in_reader->CRC = CRCUpdateByte(in_reader->CRC, in_data_byte);
+
+		// check if this is the last byte of the struct
+		return in_reader->DataByteIndex == in_size;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sets sector length
+static void SetSectorLength(TDReaderStateType* in_reader, uint8_t in_sector_length)
+{
+	if(in_sector_length == 0)
+		in_reader->CurrentSectorLength = TAPE_MAX_BLOCK_LENGTH;
+	else
+		in_reader->CurrentSectorLength = in_sector_length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Updates middle frequency period length
+static void UpdateMiddleFrequency(TDReaderStateType* in_reader, uint32_t in_frequency, uint32_t in_measured_period_length)
+{
+	int frequency_to_remove = in_reader->MiddlePeriodBuffer[in_reader->MiddlePeriodBufferIndex];
+	int middle_period_length = (in_measured_period_length * in_frequency + FREQ_MIDDLE / 2) / FREQ_MIDDLE;
+
+	in_reader->MiddlePeriodBuffer[in_reader->MiddlePeriodBufferIndex] = middle_period_length;
+
+	in_reader->MiddlePeriodBufferIndex++;
+	if( in_reader->MiddlePeriodBufferIndex >= TD_MIDDLE_PERIOD_BUFFER_LENGTH )
+		in_reader->MiddlePeriodBufferIndex = 0;
+
+	in_reader->MiddlePeriodSum = in_reader->MiddlePeriodSum - frequency_to_remove + middle_period_length;
+	in_reader->MiddlePeriod = (uint16_t)(in_reader->MiddlePeriodSum / TD_MIDDLE_PERIOD_BUFFER_LENGTH);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks if the decoder is waiting for a block leading (no block is being loaded)
+static bool IsDecoderWaiting(TDReaderStateType* in_reader)
+{
+	return (in_reader->DecoderState == DST_Idle || in_reader->DecoderState == DST_WaitingForLeading) && in_reader->ReaderStatus == TRST_Idle;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks if the block of input samples can contain tape signal. The average level of the block (without DC) and the
+// average frequency of its zero crossings must be in the range of the tape signal. Crossings are detected with a
+// hysteresis of the half average level, so low level noise riding on the signal doesn't add crossings.
+static bool IsSignalBlock(const int32_t* in_samples, size_t in_sample_count)
+{
+	int64_t sum;
+	int32_t mean;
+	int32_t level;
+	int32_t sample;
+	uint32_t crossing_count;
+	bool high;
+	size_t i;
+
+	if(in_sample_count == 0)
+		return false;
+
+	// remove DC
+	sum = 0;
+	for(i = 0; i < in_sample_count; i++)
+		sum += in_samples[i];
+	mean = (int32_t)(sum / (int64_t)in_sample_count);
+
+	// average level
+	sum = 0;
+	for(i = 0; i < in_sample_count; i++)
+		sum += IntABS(in_samples[i] - mean);
+	level = (int32_t)(sum / (int64_t)in_sample_count);
+
+	if(level < TD_GATE_MIN_LEVEL)
+		return false;
+
+	// count crossings
+	crossing_count = 0;
+	high = (in_samples[0] >= mean);
+	for(i = 1; i < in_sample_count; i++)
+	{
+		sample = in_samples[i] - mean;
+
+		if(high && sample < -level / 2)
+		{
+			high = false;
+			crossing_count++;
+		}
+		else
+		{
+			if(!high && sample > level / 2)
+			{
+				high = true;
+				crossing_count++;
+			}
+		}
+	}
+
+	// two crossings per period
+	return crossing_count * SAMPLE_RATE >= 2 * TD_GATE_MIN_FREQUENCY * (uint32_t)in_sample_count &&
+		crossing_count * SAMPLE_RATE <= 2 * TD_GATE_MAX_FREQUENCY * (uint32_t)in_sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the number of input samples which can be safely skipped after the block header of a data block. The last
+// (possibly partial) sector is not skipped and the skipped sectors are assumed to contain only one bits (shortest signal).
+// The one bit period is derived from the measured middle period, so the skip follows the speed of frequency shifted
+// tapes, and the skipped part is shortened by a margin, it never reaches the leading of the next block.
+static uint32_t GetDataBlockSkipLength(uint8_t in_sector_count, uint16_t in_middle_period)
+{
+	uint64_t one_period_length;
+
+	if(in_sector_count < 2)
+		return 0;
+
+	// one bit period in 1/OVERSAMPLING_RATE input sample units
+	one_period_length = (uint64_t)in_middle_period * FREQ_MIDDLE / FREQ_ONE;
+
+	return (uint32_t)((uint64_t)(in_sector_count - 1) * SECTOR_BYTE_COUNT * 8 * one_period_length * (100 - DATA_BLOCK_SKIP_MARGIN) / 100 / OVERSAMPLING_RATE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Starts the inverted reader at the sync of the block. It continues from the state of the reader but it reads the
+// bits at the other phase (the phase mode which was not selected by the sync scores).
+static void StartInvertedReader(TapeDecoderType* in_decoder)
+{
+	TDReaderStateType* inverted_reader = in_decoder->InvertedReader;
+
+	*inverted_reader = in_decoder->Reader;
+	inverted_reader->PhaseMode = (in_decoder->Reader.PhaseMode == SPT_High) ? SPT_Low : SPT_High;
+
+	in_decoder->InvertedReaderActive = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Selects the polarity after both readers processed the same samples. A reader is confirmed when it has loaded a valid
+// sector (or reported a block in header only mode). The inverted reader takes over when only it is confirmed or when it
+// still reads the block dropped by the reader, it is stopped when the reader is confirmed or when it stops reading.
+// Returns the load status of the selected polarity.
+static LoadStatus SelectPolarity(TapeDecoderType* in_decoder, LoadStatus in_load_status, LoadStatus in_inverted_load_status)
+{
+	TDReaderStateType* inverted_reader = in_decoder->InvertedReader;
+	bool reading = (in_decoder->Reader.DecoderState == DST_ReadingData);
+	bool inverted_reading = (inverted_reader->DecoderState == DST_ReadingData);
+	bool confirmed = (in_decoder->Reader.ValidSectorCount > 0 || in_load_status == LS_Success);
+	bool inverted_confirmed = (inverted_reader->ValidSectorCount > 0 || in_inverted_load_status == LS_Success);
+
+	if((inverted_confirmed && !confirmed) || (!reading && in_load_status == LS_Unknown && inverted_reading))
+	{
+		// inverted polarity is kept
+		in_decoder->Reader = *inverted_reader;
+		in_decoder->InvertedReaderActive = false;
+
+		return in_inverted_load_status;
+	}
+
+	if(confirmed || !inverted_reading)
+		in_decoder->InvertedReaderActive = false;
+
+	return in_load_status;
+}
@@ -0,0 +1,147 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape index file (block positions of a wav file for random access)         */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "TapeIndex.h"
+#include "FileUtils.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Loads the index file of the wav file. Returns NULL when the index doesn't exist or it was created for a different
+// file (sample count, data length or format differs), the returned block list must be released by the caller.
+TIBlockType* TILoad(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, int* out_block_count)
+{
+	wchar_t index_file_name[MAX_PATH_LENGTH];
+	TIFileHeaderType header;
+	TIBlockType* blocks = NULL;
+	FILE* index_file;
+
+	*out_block_count = 0;
+
+	TIGetFileName(index_file_name, in_wav_file_name);
+
+	index_file = _wfopen(index_file_name, L"rb");
+	if(index_file == NULL)
+		return NULL;
+
+	// check header
+	if(fread(&header, sizeof(header), 1, index_file) == 1 && header.FileID == TI_FILE_ID && header.Version == TI_FILE_VERSION && memcmp(&header.Input, in_input_id, sizeof(WFInputIDType)) == 0)
+	{
+		// load blocks
+		blocks = (TIBlockType*)malloc((header.BlockCount + 1) * sizeof(TIBlockType));
+		if(blocks != NULL && fread(blocks, sizeof(TIBlockType), header.BlockCount, index_file) != header.BlockCount)
+		{
+			free(blocks);
+			blocks = NULL;
+		}
+	}
+
+	fclose(index_file);
+
+	if(blocks != NULL)
+		*out_block_count = header.BlockCount;
+
+	return blocks;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Saves the block list as the index file of the wav file (fails when there are more than TI_MAX_BLOCK_COUNT blocks)
+bool TISave(wchar_t* in_wav_file_name, const WFInputIDType* in_input_id, const TIBlockType* in_blocks, int in_block_count)
+{
+	wchar_t index_file_name[MAX_PATH_LENGTH];
+	TIFileHeaderType header;
+	FILE* index_file;
+	bool success = true;
+
+	if(in_block_count < 0 || in_block_count > TI_MAX_BLOCK_COUNT)
+		return false;
+
+	TIGetFileName(index_file_name, in_wav_file_name);
+
+	index_file = _wfopen(index_file_name, L"wb");
+	if(index_file == NULL)
+		return false;
+
+	header.FileID = TI_FILE_ID;
+	header.Version = TI_FILE_VERSION;
+	header.Input = *in_input_id;
+	header.BlockCount = (uint16_t)in_block_count;
+
+	if(fwrite(&header, sizeof(header), 1, index_file) != 1)
+		success = false;
+
+	if(success && fwrite(in_blocks, sizeof(TIBlockType), in_block_count, index_file) != (size_t)in_block_count)
+		success = false;
+
+	fclose(index_file);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Finds the blocks of the given program (1 based). A header block and the data block behind it form one program,
+// a header without data block and a data block without header are programs as well. The missing block index is -1.
+bool TIFindProgram(const TIBlockType* in_blocks, int in_block_count, int in_program, int* out_header_block, int* out_data_block)
+{
+	int program = 0;
+	int header_block = -1;
+	int i;
+
+	for(i = 0; i < in_block_count; i++)
+	{
+		if(in_blocks[i].BlockHeader.BlockType == TAPE_BLOCKHDR_TYPE_HEADER)
+		{
+			// the previous header without data block is a program
+			if(header_block >= 0 && ++program == in_program)
+			{
+				*out_header_block = header_block;
+				*out_data_block = -1;
+				return true;
+			}
+
+			header_block = i;
+		}
+		else
+		{
+			// data block completes the program
+			if(++program == in_program)
+			{
+				*out_header_block = header_block;
+				*out_data_block = i;
+				return true;
+			}
+
+			header_block = -1;
+		}
+	}
+
+	// last header without data block
+	if(header_block >= 0 && ++program == in_program)
+	{
+		*out_header_block = header_block;
+		*out_data_block = -1;
+		return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the name of the index file (stored beside the wav file)
+void TIGetFileName(wchar_t* out_index_file_name, wchar_t* in_wav_file_name)
+{
+	wcscpy(out_index_file_name, in_wav_file_name);
+	ChangeFileExtension(out_index_file_name, TI_FILE_EXTENSION);
+}
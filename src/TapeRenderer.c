@@ -0,0 +1,413 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Tape renderer (renders a planned tape signal on multiple threads)         */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include "TapeRenderer.h"
+#include "ThreadPool.h"
+#include "DDS.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Render job (continuous part of the planned signal)
+typedef struct
+{
+	const TRPlanType* Plan;
+	int FirstElement;								// first element of the job
+	uint32_t FirstOffset;						// first byte of the first element (data elements only)
+	int EndElement;									// the job ends before the EndOffset byte of this element
+	uint32_t EndOffset;
+	uint32_t Accumulator;						// DDS phase at the start of the job
+	size_t SampleCount;
+	uint8_t* Samples;
+} RenderJobType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static TRElementType* AddElement(TRPlanType* in_plan, TRElementClassType in_class);
+static RenderJobType* CreateJobs(TRPlanType* in_plan, int* out_job_count, uint32_t* out_end_accumulator);
+static bool AddJob(RenderJobType** inout_jobs, int* inout_job_count, int* inout_job_capacity, RenderJobType* in_job);
+static void RenderJob(void* in_job);
+
+///////////////////////////////////////////////////////////////////////////////
+// Creates empty plan
+TRPlanType* TRCreatePlan(void)
+{
+	TRPlanType* plan;
+
+	plan = (TRPlanType*)malloc(sizeof(TRPlanType));
+	if(plan == NULL)
+		return NULL;
+
+	memset(plan, 0, sizeof(TRPlanType));
+
+	return plan;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Releases plan
+void TRDestroyPlan(TRPlanType* in_plan)
+{
+	if(in_plan == NULL)
+		return;
+
+	free(in_plan->Elements);
+	free(in_plan->Data);
+	free(in_plan);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds silence to the plan
+void TRAddSilence(TRPlanType* in_plan, uint16_t in_length_in_ms)
+{
+	TRElementType* element = AddElement(in_plan, TREC_Silence);
+
+	if(element != NULL)
+		element->Length = GetDDSSilenceLength(in_length_in_ms);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds signal periods to the plan
+void TRAddSignal(TRPlanType* in_plan, uint32_t in_frequency, uint32_t in_cycle_count)
+{
+	TRElementType* element = AddElement(in_plan, TREC_Signal);
+
+	if(element != NULL)
+	{
+		element->Frequency = in_frequency;
+		element->Length = in_cycle_count;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds data bytes to the plan (consecutive data is merged into one element)
+void TRAddData(TRPlanType* in_plan, const uint8_t* in_data, int in_length)
+{
+	TRElementType* element;
+	uint8_t* data;
+	size_t capacity;
+
+	if(in_length <= 0 || in_plan->OutOfMemory)
+		return;
+
+	// store data
+	if(in_plan->DataLength + in_length > in_plan->DataCapacity)
+	{
+		capacity = (in_plan->DataCapacity == 0) ? 1024 : in_plan->DataCapacity * 2;
+		while(capacity < in_plan->DataLength + in_length)
+			capacity *= 2;
+
+		data = (uint8_t*)realloc(in_plan->Data, capacity);
+		if(data == NULL)
+		{
+			in_plan->OutOfMemory = true;
+			return;
+		}
+
+		in_plan->Data = data;
+		in_plan->DataCapacity = capacity;
+	}
+
+	memcpy(&in_plan->Data[in_plan->DataLength], in_data, in_length);
+
+	// extend last element or create a new one
+	if(in_plan->ElementCount > 0 && in_plan->Elements[in_plan->ElementCount - 1].Class == TREC_Data)
+	{
+		in_plan->Elements[in_plan->ElementCount - 1].Length += in_length;
+	}
+	else
+	{
+		element = AddElement(in_plan, TREC_Data);
+		if(element == NULL)
+			return;
+
+		element->DataIndex = in_plan->DataLength;
+		element->Length = in_length;
+	}
+
+	in_plan->DataLength += in_length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Calculates the number of samples of the planned signal without rendering it
+uint32_t TRGetSampleCount(const TRPlanType* in_plan)
+{
+	const TRElementType* element;
+	uint32_t accumulator = GetDDSAccumulator();
+	uint32_t sample_count = 0;
+	uint32_t byte_index;
+	int element_index;
+
+	for(element_index = 0; element_index < in_plan->ElementCount; element_index++)
+	{
+		element = &in_plan->Elements[element_index];
+
+		switch(element->Class)
+		{
+			case TREC_Silence:
+				sample_count += element->Length;
+				accumulator = 0;
+				break;
+
+			case TREC_Signal:
+				sample_count += GetDDSSignalLength(&accumulator, GetDDSIncrement(element->Frequency), element->Length);
+				break;
+
+			case TREC_Data:
+				for(byte_index = 0; byte_index < element->Length; byte_index++)
+					sample_count += GetDDSByteLength(&accumulator, in_plan->Data[element->DataIndex + byte_index]);
+				break;
+		}
+	}
+
+	return sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Renders the planned signal and writes it to the wave output. The sample count and the DDS phase is calculated
+// for every job boundary in advance, the jobs are rendered in parallel and written in the original order, so the
+// result is identical to the sequential rendering.
+bool TRRender(TRPlanType* in_plan, int in_thread_count)
+{
+	RenderJobType* jobs;
+	int job_count;
+	int first_job;
+	int window_job_count;
+	int i;
+	uint32_t end_accumulator;
+	size_t sample_size = GetDDSSampleSize();
+	bool success = true;
+
+	if(in_plan->OutOfMemory)
+		return false;
+
+	jobs = CreateJobs(in_plan, &job_count, &end_accumulator);
+	if(jobs == NULL)
+		return (job_count == 0);
+
+	// render a window of jobs at once then write them in order
+	for(first_job = 0; first_job < job_count && success; first_job += window_job_count)
+	{
+		window_job_count = in_thread_count * TR_JOBS_PER_THREAD;
+		if(window_job_count > job_count - first_job)
+			window_job_count = job_count - first_job;
+
+		for(i = first_job; i < first_job + window_job_count; i++)
+		{
+			jobs[i].Samples = (uint8_t*)malloc(jobs[i].SampleCount * sample_size);
+			if(jobs[i].Samples == NULL)
+				success = false;
+		}
+
+		if(success)
+			TPRunJobs(RenderJob, &jobs[first_job], sizeof(RenderJobType), window_job_count, in_thread_count);
+
+		for(i = first_job; i < first_job + window_job_count; i++)
+		{
+			if(success)
+				success = WriteDDSSamples(jobs[i].Samples, jobs[i].SampleCount);
+
+			free(jobs[i].Samples);
+			jobs[i].Samples = NULL;
+		}
+	}
+
+	free(jobs);
+
+	SetDDSAccumulator(end_accumulator);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Adds new element to the plan
+static TRElementType* AddElement(TRPlanType* in_plan, TRElementClassType in_class)
+{
+	TRElementType* elements;
+	int capacity;
+
+	if(in_plan->OutOfMemory)
+		return NULL;
+
+	if(in_plan->ElementCount >= in_plan->ElementCapacity)
+	{
+		capacity = (in_plan->ElementCapacity == 0) ? 64 : in_plan->ElementCapacity * 2;
+		elements = (TRElementType*)realloc(in_plan->Elements, capacity * sizeof(TRElementType));
+		if(elements == NULL)
+		{
+			in_plan->OutOfMemory = true;
+			return NULL;
+		}
+
+		in_plan->Elements = elements;
+		in_plan->ElementCapacity = capacity;
+	}
+
+	elements = &in_plan->Elements[in_plan->ElementCount++];
+	memset(elements, 0, sizeof(TRElementType));
+	elements->Class = in_class;
+
+	return elements;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Splits the plan into jobs of about TR_JOB_SAMPLE_COUNT samples. Signal and silence elements are never split,
+// data elements are split at byte boundaries. The sample count and the DDS phase of the jobs are calculated without
+// rendering the signal.
+static RenderJobType* CreateJobs(TRPlanType* in_plan, int* out_job_count, uint32_t* out_end_accumulator)
+{
+	RenderJobType* jobs = NULL;
+	RenderJobType job;
+	TRElementType* element;
+	int job_capacity = 0;
+	int element_index;
+	uint32_t byte_index;
+	uint32_t accumulator;
+	bool success = true;
+
+	*out_job_count = 0;
+
+	accumulator = GetDDSAccumulator();
+
+	memset(&job, 0, sizeof(job));
+	job.Plan = in_plan;
+	job.Accumulator = accumulator;
+
+	for(element_index = 0; element_index < in_plan->ElementCount && success; element_index++)
+	{
+		element = &in_plan->Elements[element_index];
+
+		switch(element->Class)
+		{
+			case TREC_Silence:
+				job.SampleCount += element->Length;
+				accumulator = 0;
+				break;
+
+			case TREC_Signal:
+				job.SampleCount += GetDDSSignalLength(&accumulator, GetDDSIncrement(element->Frequency), element->Length);
+				break;
+
+			case TREC_Data:
+				for(byte_index = 0; byte_index < element->Length && success; byte_index++)
+				{
+					job.SampleCount += GetDDSByteLength(&accumulator, in_plan->Data[element->DataIndex + byte_index]);
+
+					// split data
+					if(job.SampleCount >= TR_JOB_SAMPLE_COUNT && byte_index + 1 < element->Length)
+					{
+						job.EndElement = element_index;
+						job.EndOffset = byte_index + 1;
+						success = AddJob(&jobs, out_job_count, &job_capacity, &job);
+
+						job.FirstElement = element_index;
+						job.FirstOffset = byte_index + 1;
+						job.Accumulator = accumulator;
+						job.SampleCount = 0;
+					}
+				}
+				break;
+		}
+
+		// close job at the element boundary
+		if(success && (job.SampleCount >= TR_JOB_SAMPLE_COUNT || element_index + 1 == in_plan->ElementCount))
+		{
+			job.EndElement = element_index + 1;
+			job.EndOffset = 0;
+			success = AddJob(&jobs, out_job_count, &job_capacity, &job);
+
+			job.FirstElement = element_index + 1;
+			job.FirstOffset = 0;
+			job.Accumulator = accumulator;
+			job.SampleCount = 0;
+		}
+	}
+
+	*out_end_accumulator = accumulator;
+
+	if(!success)
+	{
+		free(jobs);
+		jobs = NULL;
+		*out_job_count = -1;
+	}
+
+	return jobs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Appends job to the job list
+static bool AddJob(RenderJobType** inout_jobs, int* inout_job_count, int* inout_job_capacity, RenderJobType* in_job)
+{
+	RenderJobType* jobs;
+	int capacity;
+
+	if(*inout_job_count >= *inout_job_capacity)
+	{
+		capacity = (*inout_job_capacity == 0) ? 16 : *inout_job_capacity * 2;
+		jobs = (RenderJobType*)realloc(*inout_jobs, capacity * sizeof(RenderJobType));
+		if(jobs == NULL)
+			return false;
+
+		*inout_jobs = jobs;
+		*inout_job_capacity = capacity;
+	}
+
+	(*inout_jobs)[(*inout_job_count)++] = *in_job;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Renders the samples of one job (called from the worker threads)
+static void RenderJob(void* in_job)
+{
+	RenderJobType* job = (RenderJobType*)in_job;
+	const TRElementType* element;
+	int element_index = job->FirstElement;
+	uint32_t byte_index = job->FirstOffset;
+	uint32_t end_byte_index;
+	uint32_t accumulator = job->Accumulator;
+	uint32_t cycle_count;
+	size_t sample_size = GetDDSSampleSize();
+	size_t pos = 0;
+
+	while(element_index < job->EndElement || (element_index == job->EndElement && byte_index < job->EndOffset))
+	{
+		element = &job->Plan->Elements[element_index];
+
+		switch(element->Class)
+		{
+			case TREC_Silence:
+				RenderDDSSilence(&job->Samples[pos * sample_size], element->Length);
+				pos += element->Length;
+				accumulator = 0;
+				break;
+
+			case TREC_Signal:
+				cycle_count = element->Length;
+				pos += RenderDDSSignal(&accumulator, GetDDSIncrement(element->Frequency), &cycle_count, &job->Samples[pos * sample_size], job->SampleCount - pos);
+				break;
+
+			case TREC_Data:
+				end_byte_index = (element_index == job->EndElement) ? job->EndOffset : element->Length;
+				for(; byte_index < end_byte_index; byte_index++)
+					pos += RenderDDSByte(&accumulator, job->Plan->Data[element->DataIndex + byte_index], &job->Samples[pos * sample_size]);
+				break;
+		}
+
+		element_index++;
+		byte_index = 0;
+	}
+}
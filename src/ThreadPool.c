@@ -0,0 +1,106 @@
+/*****************************************************************************/
+/* TVCTape - Videoton TV Computer Tape Emulator                              */
+/* Worker threads for running independent jobs in parallel                   */
+/*                                                                           */
+/* Copyright (C) 2013 Laszlo Arvai                                           */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* This software may be modified and distributed under the terms             */
+/* of the BSD license.  See the LICENSE file for details.                    */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Includes
+#include <Windows.h>
+#include "ThreadPool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Types
+
+// Job list shared by the worker threads
+typedef struct
+{
+	TPJobFunctionType Function;
+	uint8_t* Jobs;
+	size_t JobSize;
+	LONG JobCount;
+	volatile LONG NextJob;				// index of the next job to run (incremented by the workers)
+} JobListType;
+
+///////////////////////////////////////////////////////////////////////////////
+// Function prototypes
+static DWORD WINAPI WorkerThread(LPVOID in_parameter);
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the number of processors
+int TPGetProcessorCount(void)
+{
+	SYSTEM_INFO system_info;
+
+	GetSystemInfo(&system_info);
+
+	if(system_info.dwNumberOfProcessors < 1)
+		return 1;
+
+	if(system_info.dwNumberOfProcessors > TP_MAX_THREAD_COUNT)
+		return TP_MAX_THREAD_COUNT;
+
+	return (int)system_info.dwNumberOfProcessors;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs all jobs of the array on the given number of threads (the calling thread is one of them) and waits until all
+// of them are finished. Jobs are started in array order. When threads can't be created the jobs run on fewer threads.
+void TPRunJobs(TPJobFunctionType in_function, void* in_jobs, size_t in_job_size, int in_job_count, int in_thread_count)
+{
+	HANDLE threads[TP_MAX_THREAD_COUNT];
+	DWORD thread_count = 0;
+	JobListType job_list;
+
+	job_list.Function = in_function;
+	job_list.Jobs = (uint8_t*)in_jobs;
+	job_list.JobSize = in_job_size;
+	job_list.JobCount = in_job_count;
+	job_list.NextJob = 0;
+
+	if(in_thread_count > in_job_count)
+		in_thread_count = in_job_count;
+
+	if(in_thread_count > TP_MAX_THREAD_COUNT)
+		in_thread_count = TP_MAX_THREAD_COUNT;
+
+	// start worker threads
+	while((int)thread_count + 1 < in_thread_count)
+	{
+		threads[thread_count] = CreateThread(NULL, 0, WorkerThread, &job_list, 0, NULL);
+		if(threads[thread_count] == NULL)
+			break;
+
+		thread_count++;
+	}
+
+	// calling thread works too
+	WorkerThread(&job_list);
+
+	// wait for the workers
+	if(thread_count > 0)
+	{
+		WaitForMultipleObjects(thread_count, threads, TRUE, INFINITE);
+
+		while(thread_count > 0)
+			CloseHandle(threads[--thread_count]);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Worker thread: runs jobs until the job list is empty
+static DWORD WINAPI WorkerThread(LPVOID in_parameter)
+{
+	JobListType* job_list = (JobListType*)in_parameter;
+	LONG job_index;
+
+	while((job_index = InterlockedIncrement(&job_list->NextJob) - 1) < job_list->JobCount)
+		job_list->Function(job_list->Jobs + job_index * job_list->JobSize);
+
+	return 0;
+}
@@ -14,6 +14,7 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
+#include <string.h>
 #include <Windows.h>
 #include "WaveMapper.h"
 #include "Console.h"
@@ -216,6 +217,31 @@ bool WDReadSample(int32_t* out_sample)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Reads block of samples, returns the number of samples read
+size_t WDReadSamples(int32_t* out_samples, size_t in_sample_count)
+{
+	size_t sample_count = 0;
+
+	while(sample_count < in_sample_count)
+	{
+		// switch to the next buffer (single sample read handles buffer change)
+		if(l_wavein_buffer_pos >= WAVEIN_BUFFER_LENGTH)
+		{
+			if(!WDReadSample(&out_samples[sample_count]))
+				break;
+
+			sample_count++;
+		}
+
+		// copy samples from the current buffer
+		while(sample_count < in_sample_count && l_wavein_buffer_pos < WAVEIN_BUFFER_LENGTH)
+			out_samples[sample_count++] = l_wavein_buffer[l_wavein_buffer_index].Buffer[l_wavein_buffer_pos++];
+	}
+
+	return sample_count;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave input
 void WDCloseInput(void)
@@ -332,6 +358,47 @@ bool WDWriteSample(uint8_t in_sample)
 	return success;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of samples to the wave output device
+bool WDWriteSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	size_t length;
+
+	while(in_sample_count > 0)
+	{
+		// get new free buffer
+		if(l_waveout_buffer_index < 0)
+		{
+			l_waveout_buffer_index = GetFreeWaveOutBufferIndex();
+			l_waveout_buffer_length = 0;
+
+			if(l_waveout_buffer_index < 0)
+				return false;
+		}
+
+		// copy samples
+		length = WAVEOUT_BUFFER_LENGTH - l_waveout_buffer_length;
+		if(length > in_sample_count)
+			length = in_sample_count;
+
+		memcpy(&l_waveout_buffer[l_waveout_buffer_index].Buffer[l_waveout_buffer_length], in_samples, length);
+		l_waveout_buffer_length += (int)length;
+		in_samples += length;
+		in_sample_count -= length;
+
+		// if the buffer is full add to the playback queue
+		if(l_waveout_buffer_length >= WAVEOUT_BUFFER_LENGTH)
+		{
+			PlayWaveOutBuffer(l_waveout_buffer_index);
+
+			l_waveout_buffer_index = -1;
+			l_waveout_buffer_length = 0;
+		}
+	}
+
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave output devoce
 void WDCloseOutput(bool in_force_close)
@@ -482,6 +549,13 @@ int WDWriteSample(uint8_t in_sample)
 {
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of samples to the wave output device
+bool WDWriteSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave output devoce
 void WDCloseOutput(bool in_force_close)
@@ -502,6 +576,13 @@ bool WDReadSample(int32_t* out_sample)
 	return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Reads block of samples
+size_t WDReadSamples(int32_t* out_samples, size_t in_sample_count)
+{
+	return 0;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave input
 void WDCloseInput(void)
@@ -12,15 +12,23 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include <stdio.h>
+#include <string.h>
 #include <wchar.h>
+#include <io.h>
 #include "Main.h"
 #include "WaveFile.h"
 #include "WaveMapper.h"
 #include "Console.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WF_X86_SIMD
+#include <emmintrin.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // Constants
 #define SILENCE_SAMPLE_COUNT_TO_APPEND 32
+#define WAVE_HEADER_LENGTH (sizeof(RIFFHeaderType) + sizeof(ChunkHeaderType) + sizeof(FormatChunkType) + sizeof(ChunkHeaderType))
 
 ///////////////////////////////////////////////////////////////////////////////
 // Module global variables
@@ -28,22 +36,47 @@ static FILE* l_input_wave_file = NULL;
 static uint8_t g_input_wave_file_channel_count;
 uint32_t g_input_wav_file_sample_count;
 uint32_t g_input_wav_file_sample_index;
+uint32_t g_input_wav_start_sample = 0;			// first sample of the decoded window
+uint32_t g_input_wav_end_sample = 0;				// sample behind the decoded window (0 - end of the file)
 static uint16_t l_input_wav_file_bits_per_sample;
-static uint8_t l_input_wav_file_sample_buffer;
+static FormatChunkType l_input_wav_file_format_chunk;
+static uint32_t l_input_wav_file_data_length;		// length of the data chunk (limited to the file size, not to the decoded window)
 static uint8_t l_input_wav_file_sample_bit_pos = 0;
+static HANDLE l_input_wav_file_mapping = NULL;
+static uint8_t* l_input_wav_file_view = NULL;
+static uint8_t* l_input_wav_data;						// current data window (mapped data chunk or read buffer)
+static uint32_t l_input_wav_data_length;		// number of valid bytes in the data window
+static uint32_t l_input_wav_data_pos;				// read position in the data window
+static uint32_t l_input_wav_data_remaining;	// number of data chunk bytes not loaded into the window yet
+static uint32_t l_input_wav_data_offset;		// file position of the data chunk
+static uint32_t l_input_wav_data_chunk_length;	// length of the data chunk (limited to the file size)
+static uint32_t l_input_wav_read_buffer[WAVE_BLOCK_LENGTH / sizeof(uint32_t)];
 static FILE* l_output_wav_file = NULL;
 static FormatChunkType l_output_wav_file_format_chunk;
 static uint32_t l_output_wav_file_sample_count;
+static uint32_t l_output_wav_file_header_sample_count;		// sample count stored in the headers of the file
 static uint32_t l_output_wav_file_sample_index;
 static uint16_t l_output_wav_file_bits_per_sample;
 static uint8_t l_output_wav_file_sample_buffer;
 static uint8_t l_output_wav_file_sample_bit_pos = 0;
+static uint8_t l_output_wav_file_write_buffer[WAVE_BLOCK_LENGTH];	// output data is collected here before writing to the file
+static size_t l_output_wav_file_write_buffer_length = 0;
 static uint16_t l_append_silence = 0;
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-static void WriteRIFFHeader(void);
+static void WriteRIFFHeader(uint32_t in_sample_count);
+static void UpdateHeaders(uint32_t in_sample_count);
+static uint32_t GetOutputDataLength(uint32_t in_sample_count);
+static void WriteOutputData(const void* in_data, size_t in_data_length);
+static void FlushOutputData(void);
+static size_t PackOneBitSamples(const uint8_t* in_samples, size_t in_sample_count, uint8_t* out_data, size_t in_data_length);
+static bool MapInputData(uint32_t in_data_offset, uint32_t in_data_length);
+static uint32_t GetSampleDataOffset(uint32_t in_sample_index, uint8_t* out_bit_pos);
+static bool LoadInputData(void);
+static size_t ConvertInputSamples(int32_t* out_samples, size_t in_sample_count);
+static size_t ConvertSamples(const uint8_t** inout_data, size_t in_data_length, uint8_t* inout_bit_pos, int in_channel, int32_t* out_samples, size_t in_sample_count);
 
 /*****************************************************************************/
 /* Wave input functions                                                      */
@@ -58,6 +91,9 @@ bool WFOpenInput(wchar_t* in_file_name)
 	ChunkHeaderType chunk_header;
 	FormatChunkType format_chunk;
 	uint32_t pos;
+	uint32_t data_length = 0;
+	uint32_t file_length;
+	uint8_t bit_pos;
 	bool data_chunk_found;
 
 	l_append_silence = 0;
@@ -110,9 +146,9 @@ bool WFOpenInput(wchar_t* in_file_name)
 						success = false;
 					}
 
-					if((format_chunk.NumChannels != 1) && (format_chunk.NumChannels != 2))
+					if((format_chunk.NumChannels < 1) || (format_chunk.NumChannels > WF_MAX_CHANNEL_COUNT))
 					{
-						DisplayError(L"Error: Only mono or stereo format is supported.\n");
+						DisplayError(L"Error: Only wav files with 1-%d channels are supported.\n", WF_MAX_CHANNEL_COUNT);
 						success = false;
 					}
 					g_input_wave_file_channel_count = (uint8_t)format_chunk.NumChannels;
@@ -124,13 +160,14 @@ bool WFOpenInput(wchar_t* in_file_name)
 					}
 
 					l_input_wav_file_bits_per_sample = format_chunk.BitsPerSample;
+					l_input_wav_file_format_chunk = format_chunk;
 					
 					break;
 
 				// Data 'data' chunk
 				case CHUNK_ID_DATA:
 					data_chunk_found = true;
-					g_input_wav_file_sample_count = chunk_header.ChunkSize * 8 / l_input_wav_file_bits_per_sample / g_input_wave_file_channel_count;
+					data_length = chunk_header.ChunkSize;
 					break;
 			}
 
@@ -141,7 +178,62 @@ bool WFOpenInput(wchar_t* in_file_name)
 	}
 
 	g_input_wav_file_sample_index = 0;
+	g_input_wav_file_sample_count = 0;
 	l_input_wav_file_sample_bit_pos = 0;
+	l_input_wav_data = (uint8_t*)l_input_wav_read_buffer;
+	l_input_wav_data_length = 0;
+	l_input_wav_data_pos = 0;
+	l_input_wav_data_remaining = 0;
+	l_input_wav_data_offset = 0;
+	l_input_wav_data_chunk_length = 0;
+	l_input_wav_file_data_length = 0;
+
+	// prepare data chunk for reading
+	if(success && data_chunk_found)
+	{
+		// limit data length to the file size (unfinished recordings may contain invalid chunk size)
+		fseek(l_input_wave_file, 0, SEEK_END);
+		file_length = (uint32_t)ftell(l_input_wave_file);
+		if(data_length > file_length - pos)
+			data_length = file_length - pos;
+
+		l_input_wav_file_data_length = data_length;
+		g_input_wav_file_sample_count = (uint32_t)((uint64_t)data_length * 8 / l_input_wav_file_bits_per_sample / g_input_wave_file_channel_count);
+
+		// the input ends at the end of the decoded window
+		if(g_input_wav_end_sample > 0 && g_input_wav_end_sample < g_input_wav_file_sample_count)
+		{
+			data_length = GetSampleDataOffset(g_input_wav_end_sample, &bit_pos);
+			if(bit_pos > 0)
+				data_length++;
+
+			g_input_wav_file_sample_count = g_input_wav_end_sample;
+		}
+
+		l_input_wav_data_offset = pos;
+		l_input_wav_data_chunk_length = data_length;
+
+		// map the whole data chunk into the memory, or use block reads if the mapping is not possible
+		if(!MapInputData(pos, data_length))
+		{
+			fseek(l_input_wave_file, pos, SEEK_SET);
+			l_input_wav_data_remaining = data_length;
+		}
+
+		// the input starts at the beginning of the decoded window
+		if(g_input_wav_start_sample > 0)
+		{
+			if(g_input_wav_start_sample < g_input_wav_file_sample_count)
+			{
+				WFSeekInput(g_input_wav_start_sample);
+			}
+			else
+			{
+				DisplayError(L"Error: Start position is behind the end of the file.\n");
+				success = false;
+			}
+		}
+	}
 
 	return success;
 }
@@ -150,126 +242,164 @@ bool WFOpenInput(wchar_t* in_file_name)
 // Reads sample
 bool WFReadSample(int32_t* out_sample)
 {
-	uint16_t buffer;
-	uint16_t buffer2;
-	size_t read_count;
-	bool success = false;
+	return WFReadSamples(out_sample, 1) == 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reads block of samples, returns the number of samples stored in the output buffer.
+// Silence is appended after the last sample of the file, zero is returned when
+// there are no more samples to read.
+size_t WFReadSamples(int32_t* out_samples, size_t in_sample_count)
+{
+	size_t sample_count = 0;
+	size_t converted_sample_count;
 
-	if (l_append_silence > 0)
+	while(sample_count < in_sample_count)
 	{
-		// append silence sample
-		if (l_append_silence < SILENCE_SAMPLE_COUNT_TO_APPEND)
+		if(l_append_silence > 0)
 		{
-			*out_sample = 0;
-			success = true;
+			// append silence sample
+			if(l_append_silence > SILENCE_SAMPLE_COUNT_TO_APPEND)
+				break;
+
+			out_samples[sample_count++] = 0;
 			l_append_silence++;
 		}
 		else
 		{
-			success = false;
+			// convert samples from the data window
+			converted_sample_count = ConvertInputSamples(out_samples + sample_count, in_sample_count - sample_count);
+			sample_count += converted_sample_count;
+			g_input_wav_file_sample_index += (uint32_t)converted_sample_count;
+
+			// load next data block when the window is empty
+			if(converted_sample_count == 0 && !LoadInputData())
+				l_append_silence = 1;
 		}
 	}
-	else
-	{
-		// read sample
-		switch (l_input_wav_file_bits_per_sample)
-		{
-			case 1:
-				if (l_input_wav_file_sample_bit_pos == 0)
-				{
-					// read data if buffer is empty
-					read_count = fread(&l_input_wav_file_sample_buffer, sizeof(uint8_t), 1, l_input_wave_file);
-					if (read_count == 1)
-					{
-						success = true;
-					}
-					else
-					{
-						*out_sample = 0;
-						success = true;
-						l_append_silence = 1;
-						break;
-					}
-				}
-				else
-				{
-					// there is data in the buffer
-					success = true;
-				}
 
-				if (success)
-				{
-					// get sample
-					*out_sample = ((l_input_wav_file_sample_buffer >> (7 - l_input_wav_file_sample_bit_pos) & 0x01) != 0) ? MAXINT16 : MININT16;
+	return sample_count;
+}
 
-					// next bit
-					l_input_wav_file_sample_bit_pos++;
-					if (l_input_wav_file_sample_bit_pos == 8)
-						l_input_wav_file_sample_bit_pos = 0;
-				}
-				break;
+///////////////////////////////////////////////////////////////////////////////
+// Reads block of samples from the given sample position without changing the read position of WFReadSamples.
+// Works only when the data chunk is mapped into the memory (can be called from multiple threads). The same
+// silence is appended after the last sample as by WFReadSamples, returns the number of samples stored. The samples
+// of the given channel (1 based) or the average of the channels (WF_MIXED_CHANNELS) are read.
+size_t WFReadSamplesAt(uint32_t in_sample_index, int in_channel, int32_t* out_samples, size_t in_sample_count)
+{
+	const uint8_t* data;
+	uint32_t data_offset;
+	uint8_t bit_pos;
+	size_t sample_count = 0;
 
-			case 8:
-				buffer = 0;
-				read_count = fread(&buffer, sizeof(uint8_t), 1, l_input_wave_file);
+	if(l_input_wav_file_view == NULL)
+		return 0;
 
-				if ((read_count == 1) && (g_input_wave_file_channel_count == 2))
-				{
-					// read sample in stereo mode
-					read_count = fread(&buffer2, sizeof(uint8_t), 1, l_input_wave_file);
+	// convert samples of the data chunk
+	if(in_sample_index < g_input_wav_file_sample_count)
+	{
+		data_offset = GetSampleDataOffset(in_sample_index, &bit_pos);
 
-					buffer = (uint16_t)((buffer + buffer2) / 2);
-				}
+		sample_count = g_input_wav_file_sample_count - in_sample_index;
+		if(sample_count > in_sample_count)
+			sample_count = in_sample_count;
 
-				if (read_count == 1)
-				{
-					*out_sample = (INT16)(((buffer & 255) - BYTE_SAMPLE_ZERO_VALUE) * 256u);
-					success = true;
-				}
-				else
-				{
-					*out_sample = 0;
-					success = true;
-					l_append_silence = 1;
-				}
-				break;
+		data = l_input_wav_data + data_offset;
+		sample_count = ConvertSamples(&data, l_input_wav_data_length - data_offset, &bit_pos, in_channel, out_samples, sample_count);
+		in_sample_index += (uint32_t)sample_count;
+	}
 
-			case 16:
-				// read sample
-				read_count = fread(&buffer, sizeof(uint16_t), 1, l_input_wave_file);
+	// append silence
+	while(sample_count < in_sample_count && in_sample_index < g_input_wav_file_sample_count + SILENCE_SAMPLE_COUNT_TO_APPEND)
+	{
+		out_samples[sample_count++] = 0;
+		in_sample_index++;
+	}
 
-				if ((read_count == 1) && (g_input_wave_file_channel_count == 2))
-				{
-					// read sample in stereo mode
-					read_count = fread(&buffer2, sizeof(uint16_t), 1, l_input_wave_file);
+	return sample_count;
+}
 
-					buffer = (uint16_t)(((uint32_t)buffer + buffer2) / 2);
-				}
+///////////////////////////////////////////////////////////////////////////////
+// Moves the read position of WFReadSamples to the given sample index (the silence after the last sample is appended
+// again). Returns false when the position is behind the end of the data chunk.
+bool WFSeekInput(uint32_t in_sample_index)
+{
+	uint32_t data_offset;
 
-				if (read_count == 1)
-				{
-					*out_sample = (INT16)buffer;
-					success = true;
-				}
-				else
-				{
-					*out_sample = 0;
-					success = true;
-					l_append_silence = 1;
-				}
-				break;
-		}
+	if(l_input_wave_file == NULL || in_sample_index > g_input_wav_file_sample_count)
+		return false;
 
-		g_input_wav_file_sample_index++;
+	data_offset = GetSampleDataOffset(in_sample_index, &l_input_wav_file_sample_bit_pos);
+
+	if(l_input_wav_file_view != NULL)
+	{
+		// the whole data chunk is in the window
+		l_input_wav_data_pos = data_offset;
+	}
+	else
+	{
+		// the window is loaded again from the new position
+		fseek(l_input_wave_file, l_input_wav_data_offset + data_offset, SEEK_SET);
+		l_input_wav_data_length = 0;
+		l_input_wav_data_pos = 0;
+		l_input_wav_data_remaining = l_input_wav_data_chunk_length - data_offset;
 	}
 
-	return success;
+	g_input_wav_file_sample_index = in_sample_index;
+	l_append_silence = 0;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns true when the data chunk of the input file is mapped into the memory (WFReadSamplesAt can be used)
+bool WFIsInputMapped(void)
+{
+	return l_input_wav_file_view != NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the number of channels of the input file (single bit files are always read as one channel)
+int WFGetInputChannelCount(void)
+{
+	if(l_input_wav_file_bits_per_sample == 1)
+		return 1;
+
+	return g_input_wave_file_channel_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the identification of the input file (sample count is the sample count of the whole file)
+void WFGetInputID(WFInputIDType* out_id)
+{
+	memset(out_id, 0, sizeof(WFInputIDType));
+
+	if(l_input_wav_file_bits_per_sample == 0 || g_input_wave_file_channel_count == 0)
+		return;
+
+	out_id->SampleCount = (uint32_t)((uint64_t)l_input_wav_file_data_length * 8 / l_input_wav_file_bits_per_sample / g_input_wave_file_channel_count);
+	out_id->DataLength = l_input_wav_file_data_length;
+	out_id->Format = l_input_wav_file_format_chunk;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave input
 void WFCloseInput(void)
 {
+	// release memory mapping
+	if(l_input_wav_file_view != NULL)
+	{
+		UnmapViewOfFile(l_input_wav_file_view);
+		l_input_wav_file_view = NULL;
+	}
+
+	if(l_input_wav_file_mapping != NULL)
+	{
+		CloseHandle(l_input_wav_file_mapping);
+		l_input_wav_file_mapping = NULL;
+	}
+
 	// close wave file
 	if(l_input_wave_file != NULL)
 	{
@@ -284,24 +414,26 @@ void WFCloseInput(void)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Creates wave file
-bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample)
+bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample, uint32_t in_sample_rate)
 {
 	ChunkHeaderType chunk_header;
 
 	if (CheckFileExists(in_file_name))
-		return WFOpenAppend(in_file_name, in_bits_per_sample);
+		return WFOpenAppend(in_file_name, in_bits_per_sample, in_sample_rate);
 
 	// create file
 	l_output_wav_file_sample_bit_pos = 0;
 	l_output_wav_file_sample_buffer = 0;
 	l_output_wav_file_sample_count = 0;
+	l_output_wav_file_header_sample_count = 0;
+	l_output_wav_file_write_buffer_length = 0;
 	l_output_wav_file = _wfopen( in_file_name, L"w+b" );
 
 	if( l_output_wav_file == NULL )
 		return false;
 
 	// write RIFF header
-	WriteRIFFHeader();
+	WriteRIFFHeader(0);
 
 	// write format chunk header
 	chunk_header.ChunkID = CHUNK_ID_FORMAT;
@@ -311,10 +443,10 @@ bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 
 	// write format chunk
 	l_output_wav_file_format_chunk.AudioFormat		= 1;
-	l_output_wav_file_format_chunk.SampleRate			= SAMPLE_RATE;
+	l_output_wav_file_format_chunk.SampleRate			= in_sample_rate;
 	l_output_wav_file_format_chunk.NumChannels		= 1;
 	l_output_wav_file_format_chunk.BitsPerSample	= in_bits_per_sample;
-	l_output_wav_file_format_chunk.BlockAlign			= 1;
+	l_output_wav_file_format_chunk.BlockAlign			= (in_bits_per_sample + 7) / 8;
 	l_output_wav_file_format_chunk.ByteRate				= l_output_wav_file_format_chunk.SampleRate * l_output_wav_file_format_chunk.NumChannels * l_output_wav_file_format_chunk.BitsPerSample / 8;
 
 	fwrite( &l_output_wav_file_format_chunk, sizeof(l_output_wav_file_format_chunk), 1, l_output_wav_file );
@@ -330,7 +462,7 @@ bool WFOpenOutput(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Appends new samples to the file
-bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample)
+bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample, uint32_t in_sample_rate)
 {
 	bool success = true;
 	RIFFHeaderType riff_header;
@@ -339,6 +471,7 @@ bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 
 	l_output_wav_file_sample_bit_pos = 0;
 	l_output_wav_file_sample_buffer = 0;
+	l_output_wav_file_write_buffer_length = 0;
 
 	l_output_wav_file = _wfopen(in_file_name, L"r+b");
 	if (l_output_wav_file == NULL)
@@ -374,9 +507,9 @@ bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 					success = false;
 				}
 
-				if (l_output_wav_file_format_chunk.SampleRate != 44100)
+				if (l_output_wav_file_format_chunk.SampleRate != in_sample_rate)
 				{
-					DisplayError(L"Error: Wav file sample rate is not 44100Hz.\n");
+					DisplayError(L"Error: Wav file sample rate is not %dHz.\n", in_sample_rate);
 					success = false;
 				}
 
@@ -412,13 +545,14 @@ bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 			if (chunk_header.ChunkID == CHUNK_ID_DATA)
 			{
 				l_output_wav_file_sample_count = chunk_header.ChunkSize * 8 / l_output_wav_file_format_chunk.BitsPerSample;
+				l_output_wav_file_header_sample_count = l_output_wav_file_sample_count;
 				fseek(l_output_wav_file, 0, SEEK_END);
 				long f = ftell(l_output_wav_file);
 
 				// write one seconds silence
 				for(sample_count = 0; sample_count < l_output_wav_file_format_chunk.SampleRate; sample_count++)
 				{
-					WMWriteSample(BYTE_SAMPLE_ZERO_VALUE);
+					WFWriteSample((in_bits_per_sample == 16) ? 0 : BYTE_SAMPLE_ZERO_VALUE);
 				}
 			}
 			else
@@ -438,6 +572,31 @@ bool WFOpenAppend(wchar_t* in_file_name, uint8_t in_bits_per_sample)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Reserves space for the given number of new samples. The final headers are written and the file is extended in
+// advance, the samples are streamed into place and the headers are updated at closing only if the sample count differs.
+bool WFReserveOutput(uint32_t in_sample_count)
+{
+	long pos;
+	bool success;
+
+	if(l_output_wav_file == NULL)
+		return false;
+
+	FlushOutputData();
+	pos = ftell(l_output_wav_file);
+
+	l_output_wav_file_header_sample_count = l_output_wav_file_sample_count + in_sample_count;
+	UpdateHeaders(l_output_wav_file_header_sample_count);
+
+	fflush(l_output_wav_file);
+	success = (_chsize_s(_fileno(l_output_wav_file), WAVE_HEADER_LENGTH + GetOutputDataLength(l_output_wav_file_header_sample_count)) == 0);
+
+	fseek(l_output_wav_file, pos, SEEK_SET);
+
+	return success;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Write sample to the output wave file
 void WFWriteSample(int32_t in_sample)
@@ -455,7 +614,7 @@ void WFWriteSample(int32_t in_sample)
 			l_output_wav_file_sample_bit_pos++;
 			if(l_output_wav_file_sample_bit_pos > 7)
 			{
-				fwrite(&l_output_wav_file_sample_buffer, sizeof(uint8_t), 1, l_output_wav_file );
+				WriteOutputData(&l_output_wav_file_sample_buffer, sizeof(uint8_t));
 				l_output_wav_file_sample_bit_pos = 0;
 				l_output_wav_file_sample_buffer = 0;
 			}
@@ -463,24 +622,124 @@ void WFWriteSample(int32_t in_sample)
 			break;
 
 		case 8:
-			fwrite(&in_sample, sizeof(uint8_t), 1, l_output_wav_file );
+			WriteOutputData(&in_sample, sizeof(uint8_t));
 			break;
 
 		case 16:
-			fwrite(&in_sample, sizeof(INT16), 1, l_output_wav_file);
+			WriteOutputData(&in_sample, sizeof(INT16));
 			break;
 	}
 
 	l_output_wav_file_sample_count++;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of samples
+void WFWriteSamples(const int32_t* in_samples, size_t in_sample_count)
+{
+	size_t i;
+
+	if(l_output_wav_file == NULL)
+		return;
+
+	for(i = 0; i < in_sample_count; i++)
+		WFWriteSample(in_samples[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of 8 bit unsigned samples (8 bit samples are copied, 1 bit samples are packed eight at a time)
+void WFWriteByteSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	size_t length;
+	size_t packed_sample_count;
+
+	if(l_output_wav_file == NULL)
+		return;
+
+	switch(l_output_wav_file_format_chunk.BitsPerSample)
+	{
+		case 1:
+			// complete partially filled byte
+			while(in_sample_count > 0 && l_output_wav_file_sample_bit_pos != 0)
+			{
+				WFWriteSample(*in_samples);
+				in_samples++;
+				in_sample_count--;
+			}
+
+			// pack whole bytes directly into the write buffer
+			while(in_sample_count >= 8)
+			{
+				if(l_output_wav_file_write_buffer_length >= WAVE_BLOCK_LENGTH)
+					FlushOutputData();
+
+				packed_sample_count = PackOneBitSamples(in_samples, in_sample_count, &l_output_wav_file_write_buffer[l_output_wav_file_write_buffer_length], WAVE_BLOCK_LENGTH - l_output_wav_file_write_buffer_length);
+
+				l_output_wav_file_write_buffer_length += packed_sample_count / 8;
+				l_output_wav_file_sample_count += (uint32_t)packed_sample_count;
+				in_samples += packed_sample_count;
+				in_sample_count -= packed_sample_count;
+			}
+			break;
+
+		case 8:
+			while(in_sample_count > 0)
+			{
+				if(l_output_wav_file_write_buffer_length >= WAVE_BLOCK_LENGTH)
+					FlushOutputData();
+
+				length = WAVE_BLOCK_LENGTH - l_output_wav_file_write_buffer_length;
+				if(length > in_sample_count)
+					length = in_sample_count;
+
+				WriteOutputData(in_samples, length);
+
+				l_output_wav_file_sample_count += (uint32_t)length;
+				in_samples += length;
+				in_sample_count -= length;
+			}
+			break;
+	}
+
+	// remaining samples
+	while(in_sample_count > 0)
+	{
+		WFWriteSample(*in_samples);
+		in_samples++;
+		in_sample_count--;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of 16 bit signed samples (only 16 bit files are supported)
+void WFWriteWordSamples(const int16_t* in_samples, size_t in_sample_count)
+{
+	size_t length;
+
+	if(l_output_wav_file == NULL || l_output_wav_file_format_chunk.BitsPerSample != 16)
+		return;
+
+	while(in_sample_count > 0)
+	{
+		if(l_output_wav_file_write_buffer_length + sizeof(int16_t) > WAVE_BLOCK_LENGTH)
+			FlushOutputData();
+
+		length = (WAVE_BLOCK_LENGTH - l_output_wav_file_write_buffer_length) / sizeof(int16_t);
+		if(length > in_sample_count)
+			length = in_sample_count;
+
+		WriteOutputData(in_samples, length * sizeof(int16_t));
+
+		l_output_wav_file_sample_count += (uint32_t)length;
+		in_samples += length;
+		in_sample_count -= length;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave output file
 void WFCloseOutput(bool in_force_close)
 {
-	ChunkHeaderType chunk_header;
-	long pos;
-
 	if( l_output_wav_file == NULL )
 		return;
 
@@ -488,22 +747,19 @@ void WFCloseOutput(bool in_force_close)
 	if(l_output_wav_file_format_chunk.BitsPerSample == 1 && l_output_wav_file_sample_bit_pos > 0)
 	{
 		l_output_wav_file_sample_buffer <<= (8-l_output_wav_file_sample_bit_pos);
-		fwrite(&l_output_wav_file_sample_buffer, sizeof(uint8_t), 1, l_output_wav_file );
+		WriteOutputData(&l_output_wav_file_sample_buffer, sizeof(uint8_t));
 	}
 
-	// update riff header
-	fseek( l_output_wav_file, 0, SEEK_SET );
-
-	WriteRIFFHeader();
-
-	// update data header
-	pos = sizeof(RIFFHeaderType) + sizeof(ChunkHeaderType) + sizeof(FormatChunkType);
-	fseek( l_output_wav_file, pos, SEEK_SET );
+	FlushOutputData();
 
-	chunk_header.ChunkID = CHUNK_ID_DATA;
-	chunk_header.ChunkSize = l_output_wav_file_sample_count * l_output_wav_file_format_chunk.BitsPerSample / 8;
+	// update headers and release unused reserved space when the length is different from the reserved length
+	if(l_output_wav_file_sample_count != l_output_wav_file_header_sample_count)
+	{
+		UpdateHeaders(l_output_wav_file_sample_count);
 
-	fwrite( &chunk_header, sizeof(chunk_header), 1, l_output_wav_file );
+		fflush(l_output_wav_file);
+		_chsize_s(_fileno(l_output_wav_file), WAVE_HEADER_LENGTH + GetOutputDataLength(l_output_wav_file_sample_count));
+	}
 
 	fclose(l_output_wav_file);
 
@@ -512,11 +768,11 @@ void WFCloseOutput(bool in_force_close)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Writes (or updates) riff file header
-static void WriteRIFFHeader(void)
+static void WriteRIFFHeader(uint32_t in_sample_count)
 {
 	RIFFHeaderType riff_header;
 	//                 RIFF FORMAT		 fmt chunk header          format chunk content			 data chunk header				 data chunk content
-	uint32_t chunk_size = sizeof(uint32_t) + sizeof(ChunkHeaderType) + sizeof(FormatChunkType) + sizeof(ChunkHeaderType) + l_output_wav_file_sample_count;
+	uint32_t chunk_size = sizeof(uint32_t) + sizeof(ChunkHeaderType) + sizeof(FormatChunkType) + sizeof(ChunkHeaderType) + GetOutputDataLength(in_sample_count);
 
 	// write header
 	riff_header.ChunkID		=	RIFF_HEADER_CHUNK_ID;
@@ -526,3 +782,320 @@ static void WriteRIFFHeader(void)
 	fwrite( &riff_header, sizeof(riff_header), 1, l_output_wav_file );
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Updates riff header and data chunk header
+static void UpdateHeaders(uint32_t in_sample_count)
+{
+	ChunkHeaderType chunk_header;
+	long pos;
+
+	// update riff header
+	fseek( l_output_wav_file, 0, SEEK_SET );
+
+	WriteRIFFHeader(in_sample_count);
+
+	// update data header
+	pos = sizeof(RIFFHeaderType) + sizeof(ChunkHeaderType) + sizeof(FormatChunkType);
+	fseek( l_output_wav_file, pos, SEEK_SET );
+
+	chunk_header.ChunkID = CHUNK_ID_DATA;
+	chunk_header.ChunkSize = GetOutputDataLength(in_sample_count);
+
+	fwrite( &chunk_header, sizeof(chunk_header), 1, l_output_wav_file );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets length of the sample data in bytes (the last byte of a single bit file may be partial)
+static uint32_t GetOutputDataLength(uint32_t in_sample_count)
+{
+	return (uint32_t)(((uint64_t)in_sample_count * l_output_wav_file_format_chunk.BitsPerSample + 7) / 8);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stores data in the output write buffer (writes the buffer to the file when it is full)
+static void WriteOutputData(const void* in_data, size_t in_data_length)
+{
+	if(l_output_wav_file_write_buffer_length + in_data_length > WAVE_BLOCK_LENGTH)
+		FlushOutputData();
+
+	memcpy(&l_output_wav_file_write_buffer[l_output_wav_file_write_buffer_length], in_data, in_data_length);
+	l_output_wav_file_write_buffer_length += in_data_length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes content of the output buffer to the file
+static void FlushOutputData(void)
+{
+	if(l_output_wav_file_write_buffer_length > 0)
+		fwrite(l_output_wav_file_write_buffer, sizeof(uint8_t), l_output_wav_file_write_buffer_length, l_output_wav_file);
+
+	l_output_wav_file_write_buffer_length = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Packs groups of eight 8 bit samples into bytes (first sample goes to the MSB, bit is set when the sample is above
+// 128). Returns the number of packed samples (multiple of 8).
+static size_t PackOneBitSamples(const uint8_t* in_samples, size_t in_sample_count, uint8_t* out_data, size_t in_data_length)
+{
+	size_t sample_index = 0;
+	size_t data_index = 0;
+	uint8_t data;
+	int i;
+#ifdef WF_X86_SIMD
+	__m128i sign = _mm_set1_epi8((char)0x80);
+	__m128i zero = _mm_setzero_si128();
+	__m128i samples;
+	int mask;
+
+	// sixteen samples at a time: reverse the sample order inside the 8 byte halves (the first sample must go to the
+	// MSB) and collect the comparison results by movemask
+	for(; sample_index + 16 <= in_sample_count && data_index + 2 <= in_data_length; sample_index += 16, data_index += 2)
+	{
+		samples = _mm_loadu_si128((const __m128i*)&in_samples[sample_index]);
+		samples = _mm_shufflehi_epi16(_mm_shufflelo_epi16(samples, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+		samples = _mm_or_si128(_mm_slli_epi16(samples, 8), _mm_srli_epi16(samples, 8));
+		mask = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_xor_si128(samples, sign), zero));
+
+		out_data[data_index] = (uint8_t)mask;
+		out_data[data_index + 1] = (uint8_t)(mask >> 8);
+	}
+#endif
+
+	for(; sample_index + 8 <= in_sample_count && data_index < in_data_length; sample_index += 8, data_index++)
+	{
+		data = 0;
+		for(i = 0; i < 8; i++)
+		{
+			data <<= 1;
+			if(in_samples[sample_index + i] > 128)
+				data |= 1;
+		}
+
+		out_data[data_index] = data;
+	}
+
+	return sample_index;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Maps data chunk of the input file into the memory
+static bool MapInputData(uint32_t in_data_offset, uint32_t in_data_length)
+{
+	HANDLE file_handle;
+
+	file_handle = (HANDLE)_get_osfhandle(_fileno(l_input_wave_file));
+	if(file_handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	l_input_wav_file_mapping = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(l_input_wav_file_mapping == NULL)
+		return false;
+
+	l_input_wav_file_view = (uint8_t*)MapViewOfFile(l_input_wav_file_mapping, FILE_MAP_READ, 0, 0, 0);
+	if(l_input_wav_file_view == NULL)
+	{
+		CloseHandle(l_input_wav_file_mapping);
+		l_input_wav_file_mapping = NULL;
+		return false;
+	}
+
+	// the whole data chunk is available in the window
+	l_input_wav_data = l_input_wav_file_view + in_data_offset;
+	l_input_wav_data_length = in_data_length;
+	l_input_wav_data_pos = 0;
+	l_input_wav_data_remaining = 0;
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the offset of the sample in the data chunk (and its bit position for single bit samples)
+static uint32_t GetSampleDataOffset(uint32_t in_sample_index, uint8_t* out_bit_pos)
+{
+	if(l_input_wav_file_bits_per_sample == 1)
+	{
+		*out_bit_pos = (uint8_t)(in_sample_index % 8);
+		return in_sample_index / 8;
+	}
+	else
+	{
+		*out_bit_pos = 0;
+		return in_sample_index * (l_input_wav_file_bits_per_sample / 8) * g_input_wave_file_channel_count;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Loads next block of the data chunk into the read buffer (keeps unprocessed bytes)
+static bool LoadInputData(void)
+{
+	uint32_t unprocessed_length;
+	uint32_t load_length;
+	size_t read_length;
+
+	if(l_input_wav_data_remaining == 0)
+		return false;
+
+	// move unprocessed bytes (partial sample frame) to the beginning of the buffer
+	unprocessed_length = l_input_wav_data_length - l_input_wav_data_pos;
+	memmove(l_input_wav_data, l_input_wav_data + l_input_wav_data_pos, unprocessed_length);
+
+	// load data
+	load_length = WAVE_BLOCK_LENGTH - unprocessed_length;
+	if(load_length > l_input_wav_data_remaining)
+		load_length = l_input_wav_data_remaining;
+
+	read_length = fread(l_input_wav_data + unprocessed_length, sizeof(uint8_t), load_length, l_input_wave_file);
+	if(read_length < load_length)
+		l_input_wav_data_remaining = 0;
+	else
+		l_input_wav_data_remaining -= load_length;
+
+	l_input_wav_data_length = unprocessed_length + (uint32_t)read_length;
+	l_input_wav_data_pos = 0;
+
+	return read_length > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts samples of the data window to 16 bit signed mono samples
+static size_t ConvertInputSamples(int32_t* out_samples, size_t in_sample_count)
+{
+	const uint8_t* data = l_input_wav_data + l_input_wav_data_pos;
+	size_t sample_count;
+
+	sample_count = ConvertSamples(&data, l_input_wav_data_length - l_input_wav_data_pos, &l_input_wav_file_sample_bit_pos, WF_MIXED_CHANNELS, out_samples, in_sample_count);
+
+	l_input_wav_data_pos = (uint32_t)(data - l_input_wav_data);
+
+	return sample_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Converts wave data to 16 bit signed mono samples (advances the data pointer and bit position of 1 bit samples). The
+// given channel (1 based) or the average of the channels (WF_MIXED_CHANNELS) is converted.
+static size_t ConvertSamples(const uint8_t** inout_data, size_t in_data_length, uint8_t* inout_bit_pos, int in_channel, int32_t* out_samples, size_t in_sample_count)
+{
+	const uint8_t* data = *inout_data;
+	size_t available_length = in_data_length;
+	uint8_t bit_pos = *inout_bit_pos;
+	int channel_count = g_input_wave_file_channel_count;
+	size_t sample_count = 0;
+	size_t byte_count;
+	size_t i;
+	int32_t sum;
+	int channel;
+	int bit;
+
+	switch (l_input_wav_file_bits_per_sample)
+	{
+		case 1:
+			// remaining bits of the partially processed byte
+			while(available_length > 0 && sample_count < in_sample_count && bit_pos != 0)
+			{
+				out_samples[sample_count++] = ((*data >> (7 - bit_pos) & 0x01) != 0) ? MAXINT16 : MININT16;
+				
+				bit_pos++;
+				if(bit_pos == 8)
+				{
+					bit_pos = 0;
+					data++;
+					available_length--;
+				}
+			}
+
+			// whole bytes
+			byte_count = (in_sample_count - sample_count) / 8;
+			if(byte_count > available_length)
+				byte_count = available_length;
+
+			for(i = 0; i < byte_count; i++)
+			{
+				for(bit = 0; bit < 8; bit++)
+					out_samples[sample_count + bit] = ((data[i] >> (7 - bit) & 0x01) != 0) ? MAXINT16 : MININT16;
+
+				sample_count += 8;
+			}
+			data += byte_count;
+			available_length -= byte_count;
+
+			// first bits of the next byte
+			while(available_length > 0 && sample_count < in_sample_count)
+			{
+				out_samples[sample_count++] = ((*data >> (7 - bit_pos) & 0x01) != 0) ? MAXINT16 : MININT16;
+				bit_pos++;
+			}
+			break;
+
+		case 8:
+			sample_count = available_length / channel_count;
+			if(sample_count > in_sample_count)
+				sample_count = in_sample_count;
+
+			if(channel_count == 1)
+			{
+				// mono
+				for(i = 0; i < sample_count; i++)
+					out_samples[i] = ((int32_t)data[i] - BYTE_SAMPLE_ZERO_VALUE) * 256;
+			}
+			else if(in_channel == WF_MIXED_CHANNELS)
+			{
+				// average of the channels
+				for(i = 0; i < sample_count; i++)
+				{
+					sum = 0;
+					for(channel = 0; channel < channel_count; channel++)
+						sum += data[i * channel_count + channel];
+
+					out_samples[i] = ((sum / channel_count) - BYTE_SAMPLE_ZERO_VALUE) * 256;
+				}
+			}
+			else
+			{
+				// one channel
+				for(i = 0; i < sample_count; i++)
+					out_samples[i] = ((int32_t)data[i * channel_count + in_channel - 1] - BYTE_SAMPLE_ZERO_VALUE) * 256;
+			}
+
+			data += sample_count * channel_count;
+			break;
+
+		case 16:
+			sample_count = available_length / (2 * channel_count);
+			if(sample_count > in_sample_count)
+				sample_count = in_sample_count;
+
+			if(channel_count == 1)
+			{
+				// mono
+				for(i = 0; i < sample_count; i++)
+					out_samples[i] = (int16_t)(data[2 * i] | (data[2 * i + 1] << 8));
+			}
+			else if(in_channel == WF_MIXED_CHANNELS)
+			{
+				// average of the channels
+				for(i = 0; i < sample_count; i++)
+				{
+					sum = 0;
+					for(channel = 0; channel < channel_count; channel++)
+						sum += (int16_t)(data[2 * (i * channel_count + channel)] | (data[2 * (i * channel_count + channel) + 1] << 8));
+
+					out_samples[i] = sum / channel_count;
+				}
+			}
+			else
+			{
+				// one channel
+				for(i = 0; i < sample_count; i++)
+					out_samples[i] = (int16_t)(data[2 * (i * channel_count + in_channel - 1)] | (data[2 * (i * channel_count + in_channel - 1) + 1] << 8));
+			}
+
+			data += sample_count * 2 * channel_count;
+			break;
+	}
+
+	*inout_data = data;
+	*inout_bit_pos = bit_pos;
+
+	return sample_count;
+}
@@ -11,34 +11,351 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <Windows.h>
+#include "Main.h"
 #include "WaveFilter.h"
+#include "FFT.h"
+#include "FilterDesign.h"
+#include "IIRFilter.h"
+#include "Console.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WF_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants
+#define FAST_FILTER_PROTOTYPE_ORDER 2				// order of the Butterworth low pass prototype (number of sections)
+#define FAST_FILTER_BUILT_IN_GAIN (10231.0 / 4096 / 128)	// gain of the built-in fast filter (A0 / B0 / DCgain of the WinFilter table)
+#define FAST_FILTER_ARITHMETIC IIRA_FixedPoint
+#define STRONG_FILTER_DC_GAIN_SHIFT 18				// log2 of the DC gain of the built-in coefficients
+#define SHARP_FILTER_LOW_CUTOFF_FREQUENCY 700		// default pass band of the sharp filter (Hz)
+#define SHARP_FILTER_HIGH_CUTOFF_FREQUENCY 4000
+#define SHARP_FILTER_MIN_FFT_LENGTH 1024
+#define BENCHMARK_SAMPLE_COUNT (1024 * 1024)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-int32_t FilterStrong(int32_t in_new_sample);
-int32_t FilterFast(int32_t in_new_sample);
+static void FilterStrong(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static void FilterStrongReference(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static void FilterFast(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static void FastFilterInit(WFFilterType* out_filter, IIRArithmeticType in_arithmetic);
+static void FastFilterBuiltInSections(FDSectionType* out_sections);
+static void FilterFastReference(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static void StrongFilterInit(WFFilterType* out_filter);
+static void FilterSharp(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count);
+static int SharpFilterFFTLength(int in_tap_count);
+static void SharpFilterInit(WFFilterType* out_filter, int in_tap_count);
+static void SharpFilterProcessFrame(WFFilterType* in_filter);
+static void FIRInit(WFFilterType* out_filter);
+static bool FIRKernelSupported(FIRKernelType in_kernel);
+static void FIRProcessBlock(WFFilterType* in_filter, size_t in_sample_count, int32_t* out_samples);
+static int32_t FIRScaleOutput(const WFFilterType* in_filter, int64_t in_accumulator);
+static void FIRKernelScalar(const WFFilterType* in_filter, const int32_t* in_data, int32_t* out_samples, size_t in_sample_count);
+#ifdef WF_X86_SIMD
+static void FIRKernelSSE2(const WFFilterType* in_filter, const int16_t* in_data, int32_t* out_samples, size_t in_sample_count);
+TARGET_AVX2 static void FIRKernelAVX2(const WFFilterType* in_filter, const int16_t* in_data, int32_t* out_samples, size_t in_sample_count);
+#endif
+static double BenchmarkFilter(void (*in_function)(WFFilterType*, const int32_t*, int32_t*, size_t), WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples);
+static int32_t GetMaxDifference(const int32_t* in_samples1, const int32_t* in_samples2, size_t in_sample_count);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
 FilterTypes g_filter_type = FT_Auto;
+uint16_t g_sharp_filter_tap_count = WF_SHARP_FILTER_DEFAULT_TAP_COUNT;
+uint16_t g_filter_low_cutoff_frequency = 0;			// pass band of the filters (0 - default band of the selected filter)
+uint16_t g_filter_high_cutoff_frequency = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes filter instance (designs the selected filter for the pass band set by the global filter parameters)
+void WFInit(WFFilterType* out_filter, FilterTypes in_type)
+{
+	out_filter->Type = in_type;
+
+	switch(in_type)
+	{
+		case FT_Fast:
+			FastFilterInit(out_filter, FAST_FILTER_ARITHMETIC);
+			break;
+
+		case FT_Strong:
+			FIRInit(out_filter);
+			break;
+
+		case FT_Sharp:
+			SharpFilterInit(out_filter, g_sharp_filter_tap_count);
+			break;
+
+		default:
+			break;
+	}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-// Filters sample
-int32_t WFProcessSample(int32_t in_new_sample)
+// Filters a block of samples (in_samples and out_samples may be the same buffer)
+void WFProcessSamples(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
 {
-	switch(g_filter_type)
+	switch(in_filter->Type)
 	{
 		case FT_Fast:
-			return FilterFast(in_new_sample);
+			FilterFast(in_filter, in_samples, out_samples, in_sample_count);
+			break;
 
 		case FT_Strong:
-			return FilterStrong(in_new_sample);
+			FilterStrong(in_filter, in_samples, out_samples, in_sample_count);
+			break;
+
+		case FT_Sharp:
+			FilterSharp(in_filter, in_samples, out_samples, in_sample_count);
+			break;
 
 		default:
-			return in_new_sample;
+			if(in_samples != out_samples)
+				memcpy(out_samples, in_samples, in_sample_count * sizeof(int32_t));
+			break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets the number of samples the input must be extended with (silence) to get all samples through the filter
+size_t WFGetLatency(const WFFilterType* in_filter)
+{
+	switch(in_filter->Type)
+	{
+		case FT_Sharp:
+			// one frame is buffered plus the group delay of the filter
+			return in_filter->SharpFilterHopLength + in_filter->SharpFilterTapCount / 2;
+
+		default:
+			// short filters are flushed by the silence appended by the wave reader
+			return 0;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Measures the speed of the strong filter implementations and checks that all of them give the same output
+bool WFBenchmark(void)
+{
+	static const wchar_t* kernel_names[] = { L"", L"scalar", L"SSE2", L"AVX2" };
+	static const wchar_t* arithmetic_names[] = { L"fixed", L"float" };
+	int32_t* samples;
+	int32_t* reference_output;
+	int32_t* output;
+	int32_t* float_output;
+	uint32_t random;
+	size_t i;
+	double samples_per_sec;
+	WFFilterType* filter;
+	FIRKernelType kernel;
+	IIRArithmeticType arithmetic;
+	int tap_count;
+	bool success = true;
+
+	samples = (int32_t*)malloc(BENCHMARK_SAMPLE_COUNT * sizeof(int32_t));
+	reference_output = (int32_t*)malloc(BENCHMARK_SAMPLE_COUNT * sizeof(int32_t));
+	output = (int32_t*)malloc(BENCHMARK_SAMPLE_COUNT * sizeof(int32_t));
+	float_output = (int32_t*)malloc(BENCHMARK_SAMPLE_COUNT * sizeof(int32_t));
+	filter = (WFFilterType*)malloc(sizeof(WFFilterType));
+
+	if(samples == NULL || reference_output == NULL || output == NULL || float_output == NULL || filter == NULL)
+	{
+		free(samples);
+		free(reference_output);
+		free(output);
+		free(float_output);
+		free(filter);
+		return false;
+	}
+
+	// generate full scale pseudo random test signal
+	random = 1;
+	for(i = 0; i < BENCHMARK_SAMPLE_COUNT; i++)
+	{
+		random = random * 1103515245 + 12345;
+		samples[i] = (int16_t)(random >> 16);
+	}
+
+	FIRInit(filter);
+
+	DisplayMessage(L"Strong filter benchmark (%d tap FIR, %d samples)\n", WF_STRONG_FILTER_TAP_COUNT, BENCHMARK_SAMPLE_COUNT);
+
+	// original implementation
+	memset(filter->StrongFilterReferenceHistory, 0, sizeof(filter->StrongFilterReferenceHistory));
+	samples_per_sec = BenchmarkFilter(FilterStrongReference, filter, samples, reference_output);
+	DisplayMessage(L"  %-10s %12.0f samples/sec\n", L"reference", samples_per_sec);
+
+	// block FIR kernels
+	for(kernel = FIRK_Scalar; kernel <= FIRK_AVX2; kernel++)
+	{
+		if(!FIRKernelSupported(kernel))
+		{
+			DisplayMessage(L"  %-10s not supported\n", kernel_names[kernel]);
+			continue;
+		}
+
+		filter->FIRKernel = kernel;
+		memset(filter->StrongFilterHistory, 0, sizeof(filter->StrongFilterHistory));
+		samples_per_sec = BenchmarkFilter(FilterStrong, filter, samples, output);
+
+		if(memcmp(output, reference_output, BENCHMARK_SAMPLE_COUNT * sizeof(int32_t)) == 0)
+		{
+			DisplayMessage(L"  %-10s %12.0f samples/sec\n", kernel_names[kernel], samples_per_sec);
+		}
+		else
+		{
+			DisplayMessage(L"  %-10s %12.0f samples/sec (output mismatch)\n", kernel_names[kernel], samples_per_sec);
+			success = false;
+		}
+	}
+
+	// IIR engine
+	DisplayMessage(L"Fast filter benchmark (%d section IIR)\n", FAST_FILTER_PROTOTYPE_ORDER);
+
+	memset(filter->FastFilterReferenceX, 0, sizeof(filter->FastFilterReferenceX));
+	memset(filter->FastFilterReferenceY, 0, sizeof(filter->FastFilterReferenceY));
+	samples_per_sec = BenchmarkFilter(FilterFastReference, filter, samples, reference_output);
+	DisplayMessage(L"  %-10s %12.0f samples/sec\n", L"reference", samples_per_sec);
+
+	for(arithmetic = IIRA_FixedPoint; arithmetic <= IIRA_FloatingPoint; arithmetic++)
+	{
+		FastFilterInit(filter, arithmetic);
+		samples_per_sec = BenchmarkFilter(FilterFast, filter, samples, (arithmetic == IIRA_FixedPoint) ? output : float_output);
+		DisplayMessage(L"  %-10s %12.0f samples/sec\n", arithmetic_names[arithmetic], samples_per_sec);
+	}
+
+	// fixed point result is compared to the original implementation and to the floating point one
+	DisplayMessage(L"  max. difference of fixed point and reference output: %d\n", GetMaxDifference(output, reference_output, BENCHMARK_SAMPLE_COUNT));
+	DisplayMessage(L"  max. difference of fixed and floating point output: %d\n", GetMaxDifference(output, float_output, BENCHMARK_SAMPLE_COUNT));
+
+	// FFT filter
+	DisplayMessage(L"Sharp filter benchmark (FFT overlap-save)\n");
+	for(tap_count = WF_SHARP_FILTER_MIN_TAP_COUNT; tap_count <= WF_SHARP_FILTER_MAX_TAP_COUNT; tap_count *= 2)
+	{
+		SharpFilterInit(filter, tap_count);
+		samples_per_sec = BenchmarkFilter(FilterSharp, filter, samples, output);
+		DisplayMessage(L"  %4d taps  %12.0f samples/sec\n", tap_count, samples_per_sec);
+	}
+
+	free(samples);
+	free(reference_output);
+	free(output);
+	free(float_output);
+	free(filter);
+
+	return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Runs filter on the benchmark samples in WAVE_SAMPLE_BLOCK_LENGTH blocks, returns samples/sec
+static double BenchmarkFilter(void (*in_function)(WFFilterType*, const int32_t*, int32_t*, size_t), WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples)
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER start_time;
+	LARGE_INTEGER end_time;
+	size_t pos;
+	size_t length;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start_time);
+
+	for(pos = 0; pos < BENCHMARK_SAMPLE_COUNT; pos += length)
+	{
+		length = BENCHMARK_SAMPLE_COUNT - pos;
+		if(length > WAVE_SAMPLE_BLOCK_LENGTH)
+			length = WAVE_SAMPLE_BLOCK_LENGTH;
+
+		in_function(in_filter, &in_samples[pos], &out_samples[pos], length);
+	}
+
+	QueryPerformanceCounter(&end_time);
+
+	if(end_time.QuadPart == start_time.QuadPart)
+		return 0;
+
+	return (double)BENCHMARK_SAMPLE_COUNT * frequency.QuadPart / (end_time.QuadPart - start_time.QuadPart);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Returns the largest absolute difference of two sample buffers
+static int32_t GetMaxDifference(const int32_t* in_samples1, const int32_t* in_samples2, size_t in_sample_count)
+{
+	int32_t difference;
+	int32_t max_difference = 0;
+	size_t i;
+
+	for(i = 0; i < in_sample_count; i++)
+	{
+		difference = abs(in_samples1[i] - in_samples2[i]);
+		if(difference > max_difference)
+			max_difference = difference;
+	}
+
+	return max_difference;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fast filter (2nd order Butterworth band pass) using the IIR engine
+static void FilterFast(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	IIRProcessSamples(&in_filter->FastFilter, in_samples, out_samples, in_sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes fast filter: designed for the selected pass band, the built-in WinFilter filter is used without band
+static void FastFilterInit(WFFilterType* out_filter, IIRArithmeticType in_arithmetic)
+{
+	const FDIIRDesignType* design = NULL;
+	FDSectionType sections[FAST_FILTER_PROTOTYPE_ORDER];
+
+	if(g_filter_low_cutoff_frequency != 0 && g_filter_high_cutoff_frequency != 0)
+		design = FDDesignIIRBandPass(FDM_Butterworth, SAMPLE_RATE, g_filter_low_cutoff_frequency, g_filter_high_cutoff_frequency, FAST_FILTER_PROTOTYPE_ORDER);
+
+	if(design != NULL)
+	{
+		IIRInit(&out_filter->FastFilter, design->Sections, design->Order, in_arithmetic);
+	}
+	else
+	{
+		FastFilterBuiltInSections(sections);
+		IIRInit(&out_filter->FastFilter, sections, FAST_FILTER_PROTOTYPE_ORDER, in_arithmetic);
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Builds the sections of the built-in fast filter from the poles and zeros of the WinFilter design (see the reference
+// implementation below). Each section has one complex conjugate pole pair and zeros at z=1 and z=-1, the gain of the
+// original filter is distributed evenly.
+static void FastFilterBuiltInSections(FDSectionType* out_sections)
+{
+	static const double poles[FAST_FILTER_PROTOTYPE_ORDER][2] = {
+		{ 0.928828, 0.135679 },
+		{ 0.816778, 0.302049 }
+	};
+	double gain = sqrt(FAST_FILTER_BUILT_IN_GAIN);
+	int i;
+
+	for(i = 0; i < FAST_FILTER_PROTOTYPE_ORDER; i++)
+	{
+		out_sections[i].B0 = gain;
+		out_sections[i].B1 = 0;
+		out_sections[i].B2 = -gain;
+		out_sections[i].A1 = -2 * poles[i][0];
+		out_sections[i].A2 = poles[i][0] * poles[i][0] + poles[i][1] * poles[i][1];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Original direct form fast filter implementation (used as reference for benchmark)
 /**************************************************************
 WinFilter version 0.8
 http://www.winfilter.20m.com
@@ -66,7 +383,7 @@ z = 0.816778 + j 0.302049
 #define NCoef 4
 #define DCgain 128
 
-int32_t FilterFast(int32_t NewSample)
+static void FilterFastReference(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
 {
     int16_t ACoef[NCoef+1] = {
         10231,
@@ -84,27 +401,30 @@ int32_t FilterFast(int32_t NewSample)
          2737
     };
 
-    static int64_t y[NCoef+1]; //output samples
+    int64_t* y = in_filter->FastFilterReferenceY; //output samples
     //Warning!!!!!! This variable should be signed (input sample width + Coefs width + 4 )-bit width to avoid saturation.
 
-		static int32_t x[NCoef+1]; //input samples
+		int32_t* x = in_filter->FastFilterReferenceX; //input samples
     int n;
+    size_t i;
 
-    //shift the old samples
-    for(n=NCoef; n>0; n--) {
-       x[n] = x[n-1];
-       y[n] = y[n-1];
-    }
+    for(i=0; i<in_sample_count; i++) {
+      //shift the old samples
+      for(n=NCoef; n>0; n--) {
+         x[n] = x[n-1];
+         y[n] = y[n-1];
+      }
 
-    //Calculate the new output
-    x[0] = NewSample;
-    y[0] = (int64_t)ACoef[0] * x[0];
-    for(n=1; n<=NCoef; n++)
-        y[0] += (int64_t)ACoef[n] * x[n] - BCoef[n] * y[n];
+      //Calculate the new output
+      x[0] = in_samples[i];
+      y[0] = (int64_t)ACoef[0] * x[0];
+      for(n=1; n<=NCoef; n++)
+          y[0] += (int64_t)ACoef[n] * x[n] - BCoef[n] * y[n];
 
-    y[0] /= BCoef[0];
-    
-    return (int32_t)(y[0] / DCgain);
+      y[0] /= BCoef[0];
+
+      out_samples[i] = (int32_t)(y[0] / DCgain);
+    }
 }
 #undef NCoef
 #undef DCgain
@@ -146,12 +466,7 @@ z = 0.983451 + j 0.141538
 z = 0.894087 + j -0.404846
 z = 0.894087 + j 0.404846
 ***************************************************************/
-#define Ntap 64
-#define DCgain 262144
-
-int32_t FilterStrong(int32_t in_new_sample)
-{
-	static int16_t FIRCoef[Ntap] = { 
+static const int16_t l_strong_filter_built_in_coefficients[WF_STRONG_FILTER_TAP_COUNT] = {
          4354,
          3860,
          2932,
@@ -216,25 +531,395 @@ int32_t FilterStrong(int32_t in_new_sample)
          3860,
          4354,
          4383
-    };
+};
 
-		static int32_t x[Ntap]; //input samples
-    int64_t y=0;            //output sample
-    int n;
+///////////////////////////////////////////////////////////////////////////////
+// Loads strong filter coefficients (built-in for the default pass band, designed Kaiser windowed FIR otherwise)
+static void StrongFilterInit(WFFilterType* out_filter)
+{
+	const FDFIRDesignType* design = NULL;
+	int i;
 
-    //shift the old samples
-    for(n=Ntap-1; n>0; n--)
-       x[n] = x[n-1];
+	if(g_filter_low_cutoff_frequency != 0 && g_filter_high_cutoff_frequency != 0)
+		design = FDDesignFIRBandPass(FDW_Kaiser, SAMPLE_RATE, g_filter_low_cutoff_frequency, g_filter_high_cutoff_frequency, WF_STRONG_FILTER_TAP_COUNT);
 
-    //Calculate the new output
-    x[0] = in_new_sample;
-    for(n=0; n<Ntap; n++)
-        y += FIRCoef[n] * x[n];
-    
-    return (int32_t)(y / DCgain);
+	// kernels use the coefficients in reversed order (oldest sample first)
+	if(design != NULL)
+	{
+		for(i = 0; i < WF_STRONG_FILTER_TAP_COUNT; i++)
+			out_filter->StrongFilterReversedCoefficients[i] = design->QuantizedCoefficients[WF_STRONG_FILTER_TAP_COUNT - 1 - i];
+
+		out_filter->StrongFilterDCGainShift = design->QuantizedDCGainShift;
+	}
+	else
+	{
+		for(i = 0; i < WF_STRONG_FILTER_TAP_COUNT; i++)
+			out_filter->StrongFilterReversedCoefficients[i] = l_strong_filter_built_in_coefficients[WF_STRONG_FILTER_TAP_COUNT - 1 - i];
+
+		out_filter->StrongFilterDCGainShift = STRONG_FILTER_DC_GAIN_SHIFT;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Strong filter (64 tap FIR) using the block FIR engine
+static void FilterStrong(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t chunk_length;
+
+	while(in_sample_count > 0)
+	{
+		chunk_length = in_sample_count;
+		if(chunk_length > WF_FIR_BLOCK_LENGTH)
+			chunk_length = WF_FIR_BLOCK_LENGTH;
+
+		// append new samples behind the history
+		memcpy(&in_filter->StrongFilterHistory[WF_STRONG_FILTER_TAP_COUNT - 1], in_samples, chunk_length * sizeof(int32_t));
+
+		FIRProcessBlock(in_filter, chunk_length, out_samples);
+
+		// keep the last samples as history for the next block
+		memmove(in_filter->StrongFilterHistory, &in_filter->StrongFilterHistory[chunk_length], (WF_STRONG_FILTER_TAP_COUNT - 1) * sizeof(int32_t));
+
+		in_samples += chunk_length;
+		out_samples += chunk_length;
+		in_sample_count -= chunk_length;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Original sample-by-sample strong filter implementation (used as reference for benchmark)
+static void FilterStrongReference(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	int32_t* x = in_filter->StrongFilterReferenceHistory; //input samples
+	int64_t y;              //output sample
+	int n;
+	size_t i;
+
+	for(i=0; i<in_sample_count; i++)
+	{
+		//shift the old samples
+		for(n=WF_STRONG_FILTER_TAP_COUNT-1; n>0; n--)
+			x[n] = x[n-1];
+
+		//Calculate the new output
+		x[0] = in_samples[i];
+		y = 0;
+		for(n=0; n<WF_STRONG_FILTER_TAP_COUNT; n++)
+			y += in_filter->StrongFilterReversedCoefficients[WF_STRONG_FILTER_TAP_COUNT - 1 - n] * x[n];
+
+		out_samples[i] = (int32_t)(y / ((int64_t)1 << in_filter->StrongFilterDCGainShift));
+	}
+}
+
+/*****************************************************************************/
+/* Block FIR engine                                                          */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Initializes FIR engine (loads coefficients, clears history and selects the fastest kernel supported by the CPU)
+static void FIRInit(WFFilterType* out_filter)
+{
+	StrongFilterInit(out_filter);
+
+	memset(out_filter->StrongFilterHistory, 0, sizeof(out_filter->StrongFilterHistory));
+
+	out_filter->FIRKernel = FIRK_Scalar;
+
+#ifdef WF_X86_SIMD
+	if(FIRKernelSupported(FIRK_AVX2))
+		out_filter->FIRKernel = FIRK_AVX2;
+	else
+		if(FIRKernelSupported(FIRK_SSE2))
+			out_filter->FIRKernel = FIRK_SSE2;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks if the given kernel can be used on this CPU
+static bool FIRKernelSupported(FIRKernelType in_kernel)
+{
+#ifdef WF_X86_SIMD
+#ifdef _MSC_VER
+	int cpu_info[4];
+	int max_function_id;
+
+	__cpuid(cpu_info, 0);
+	max_function_id = cpu_info[0];
+	__cpuid(cpu_info, 1);
+
+	switch(in_kernel)
+	{
+		case FIRK_Scalar:
+			return true;
+
+		case FIRK_SSE2:
+			return (cpu_info[3] & (1 << 26)) != 0;
+
+		case FIRK_AVX2:
+			// OS must save YMM registers (OSXSAVE + AVX enabled in XCR0)
+			if((cpu_info[2] & (1 << 27)) == 0 || (cpu_info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6 || max_function_id < 7)
+				return false;
+
+			__cpuidex(cpu_info, 7, 0);
+			return (cpu_info[1] & (1 << 5)) != 0;
+
+		default:
+			return false;
+	}
+#else
+	switch(in_kernel)
+	{
+		case FIRK_Scalar:
+			return true;
+
+		case FIRK_SSE2:
+			return __builtin_cpu_supports("sse2") != 0;
+
+		case FIRK_AVX2:
+			return __builtin_cpu_supports("avx2") != 0;
+
+		default:
+			return false;
+	}
+#endif
+#else
+	return in_kernel == FIRK_Scalar;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Filters one block of samples stored behind the history in StrongFilterHistory
+static void FIRProcessBlock(WFFilterType* in_filter, size_t in_sample_count, int32_t* out_samples)
+{
+	size_t i;
+	size_t data_length = WF_STRONG_FILTER_TAP_COUNT - 1 + in_sample_count;
+
+#ifdef WF_X86_SIMD
+	if(in_filter->FIRKernel == FIRK_SSE2 || in_filter->FIRKernel == FIRK_AVX2)
+	{
+		// SIMD kernels work on 16 bit samples, fall back to scalar code when a sample doesn't fit
+		for(i = 0; i < data_length; i++)
+		{
+			if(in_filter->StrongFilterHistory[i] < INT16_MIN || in_filter->StrongFilterHistory[i] > INT16_MAX)
+				break;
+
+			in_filter->StrongFilterHistory16[i] = (int16_t)in_filter->StrongFilterHistory[i];
+		}
+
+		if(i == data_length)
+		{
+			if(in_filter->FIRKernel == FIRK_AVX2)
+				FIRKernelAVX2(in_filter, in_filter->StrongFilterHistory16, out_samples, in_sample_count);
+			else
+				FIRKernelSSE2(in_filter, in_filter->StrongFilterHistory16, out_samples, in_sample_count);
+
+			return;
+		}
+	}
+#endif
+
+	FIRKernelScalar(in_filter, in_filter->StrongFilterHistory, out_samples, in_sample_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Divides the accumulator with the DC gain (rounds toward zero as the original division)
+static int32_t FIRScaleOutput(const WFFilterType* in_filter, int64_t in_accumulator)
+{
+	if(in_accumulator < 0)
+		in_accumulator += ((int64_t)1 << in_filter->StrongFilterDCGainShift) - 1;
+
+	return (int32_t)(in_accumulator >> in_filter->StrongFilterDCGainShift);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Portable FIR kernel
+static void FIRKernelScalar(const WFFilterType* in_filter, const int32_t* in_data, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t i;
+	int n;
+	int64_t y;
+
+	for(i = 0; i < in_sample_count; i++)
+	{
+		y = 0;
+		for(n = 0; n < WF_STRONG_FILTER_TAP_COUNT; n++)
+			y += in_filter->StrongFilterReversedCoefficients[n] * in_data[i + n];
+
+		out_samples[i] = FIRScaleOutput(in_filter, y);
+	}
+}
+
+#ifdef WF_X86_SIMD
+///////////////////////////////////////////////////////////////////////////////
+// SSE2 FIR kernel
+// Products of two neighbouring taps are summed by pmaddwd (fits into 32 bit as coefficients are less than 32768),
+// then sign extended and accumulated on 64 bit, so the result is identical to the scalar code.
+static void FIRKernelSSE2(const WFFilterType* in_filter, const int16_t* in_data, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t i;
+	int n;
+	__m128i product;
+	__m128i sign;
+	__m128i accumulator;
+	int64_t sum[2];
+
+	for(i = 0; i < in_sample_count; i++)
+	{
+		accumulator = _mm_setzero_si128();
+
+		for(n = 0; n < WF_STRONG_FILTER_TAP_COUNT; n += 8)
+		{
+			product = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)&in_data[i + n]), _mm_loadu_si128((const __m128i*)&in_filter->StrongFilterReversedCoefficients[n]));
+			sign = _mm_srai_epi32(product, 31);
+			accumulator = _mm_add_epi64(accumulator, _mm_unpacklo_epi32(product, sign));
+			accumulator = _mm_add_epi64(accumulator, _mm_unpackhi_epi32(product, sign));
+		}
+
+		_mm_storeu_si128((__m128i*)sum, accumulator);
+		out_samples[i] = FIRScaleOutput(in_filter, sum[0] + sum[1]);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 FIR kernel (same arithmetic as the SSE2 kernel on 16 taps per step)
+TARGET_AVX2 static void FIRKernelAVX2(const WFFilterType* in_filter, const int16_t* in_data, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t i;
+	int n;
+	__m256i product;
+	__m256i accumulator;
+	__m128i sum128;
+	int64_t sum[2];
+
+	for(i = 0; i < in_sample_count; i++)
+	{
+		accumulator = _mm256_setzero_si256();
+
+		for(n = 0; n < WF_STRONG_FILTER_TAP_COUNT; n += 16)
+		{
+			product = _mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)&in_data[i + n]), _mm256_loadu_si256((const __m256i*)&in_filter->StrongFilterReversedCoefficients[n]));
+			accumulator = _mm256_add_epi64(accumulator, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(product)));
+			accumulator = _mm256_add_epi64(accumulator, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(product, 1)));
+		}
+
+		sum128 = _mm_add_epi64(_mm256_castsi256_si128(accumulator), _mm256_extracti128_si256(accumulator, 1));
+		_mm_storeu_si128((__m128i*)sum, sum128);
+		out_samples[i] = FIRScaleOutput(in_filter, sum[0] + sum[1]);
+	}
+}
+#endif
+
+/*****************************************************************************/
+/* Sharp filter (long FIR band pass filter using FFT overlap-save)           */
+/*****************************************************************************/
+
+///////////////////////////////////////////////////////////////////////////////
+// Sharp filter
+static void FilterSharp(WFFilterType* in_filter, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t i;
+	int history_length;
+
+	history_length = in_filter->SharpFilterTapCount - 1;
+
+	// output is delayed by one frame: samples of the previous frame are returned while the current frame is collected
+	for(i = 0; i < in_sample_count; i++)
+	{
+		in_filter->SharpFilterFrame[history_length + in_filter->SharpFilterFramePos] = in_samples[i];
+		out_samples[i] = in_filter->SharpFilterOutput[in_filter->SharpFilterFramePos];
+
+		in_filter->SharpFilterFramePos++;
+		if(in_filter->SharpFilterFramePos >= in_filter->SharpFilterHopLength)
+		{
+			SharpFilterProcessFrame(in_filter);
+			in_filter->SharpFilterFramePos = 0;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Gets FFT length used for the given tap count (at least four times the filter length)
+static int SharpFilterFFTLength(int in_tap_count)
+{
+	int fft_length = SHARP_FILTER_MIN_FFT_LENGTH;
+
+	while(fft_length < 4 * in_tap_count && fft_length < FFT_MAX_LENGTH)
+		fft_length *= 2;
+
+	return fft_length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Designs filter (Blackman windowed sinc band pass) and calculates its frequency response
+static void SharpFilterInit(WFFilterType* out_filter, int in_tap_count)
+{
+	const FDFIRDesignType* design = NULL;
+	int fft_length;
+	int i;
+
+	if(in_tap_count < WF_SHARP_FILTER_MIN_TAP_COUNT)
+		in_tap_count = WF_SHARP_FILTER_MIN_TAP_COUNT;
+
+	if(in_tap_count > WF_SHARP_FILTER_MAX_TAP_COUNT)
+		in_tap_count = WF_SHARP_FILTER_MAX_TAP_COUNT;
+
+	if(g_filter_low_cutoff_frequency != 0 && g_filter_high_cutoff_frequency != 0)
+		design = FDDesignFIRBandPass(FDW_Blackman, SAMPLE_RATE, g_filter_low_cutoff_frequency, g_filter_high_cutoff_frequency, (uint16_t)in_tap_count);
+
+	if(design == NULL)
+		design = FDDesignFIRBandPass(FDW_Blackman, SAMPLE_RATE, SHARP_FILTER_LOW_CUTOFF_FREQUENCY, SHARP_FILTER_HIGH_CUTOFF_FREQUENCY, (uint16_t)in_tap_count);
+
+	fft_length = SharpFilterFFTLength(in_tap_count);
+	FFTInit(&out_filter->SharpFilterFFT, fft_length);
+
+	// impulse response zero padded to the FFT length
+	for(i = 0; i < fft_length; i++)
+	{
+		if(i < in_tap_count)
+			out_filter->SharpFilterFrame[i] = design->Coefficients[i];
+		else
+			out_filter->SharpFilterFrame[i] = 0;
+	}
+
+	FFTForwardReal(&out_filter->SharpFilterFFT, out_filter->SharpFilterFrame, out_filter->SharpFilterResponse);
+
+	// clear state
+	memset(out_filter->SharpFilterFrame, 0, sizeof(out_filter->SharpFilterFrame));
+	memset(out_filter->SharpFilterOutput, 0, sizeof(out_filter->SharpFilterOutput));
+
+	out_filter->SharpFilterTapCount = in_tap_count;
+	out_filter->SharpFilterHopLength = fft_length - in_tap_count + 1;
+	out_filter->SharpFilterFramePos = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Filters one frame: multiplies its spectrum with the filter response and keeps the valid (not wrapped around) part
+static void SharpFilterProcessFrame(WFFilterType* in_filter)
+{
+	int i;
+	int history_length = in_filter->SharpFilterTapCount - 1;
+	double re;
+	double im;
+
+	FFTForwardReal(&in_filter->SharpFilterFFT, in_filter->SharpFilterFrame, in_filter->SharpFilterSpectrum);
+
+	for(i = 0; i <= in_filter->SharpFilterFFT.Length / 2; i++)
+	{
+		re = in_filter->SharpFilterSpectrum[i].Re * in_filter->SharpFilterResponse[i].Re - in_filter->SharpFilterSpectrum[i].Im * in_filter->SharpFilterResponse[i].Im;
+		im = in_filter->SharpFilterSpectrum[i].Re * in_filter->SharpFilterResponse[i].Im + in_filter->SharpFilterSpectrum[i].Im * in_filter->SharpFilterResponse[i].Re;
+		in_filter->SharpFilterSpectrum[i].Re = re;
+		in_filter->SharpFilterSpectrum[i].Im = im;
+	}
+
+	FFTInverseReal(&in_filter->SharpFilterFFT, in_filter->SharpFilterSpectrum, in_filter->SharpFilterResult);
+
+	// the first (tap count - 1) results are corrupted by the circular convolution
+	for(i = 0; i < in_filter->SharpFilterHopLength; i++)
+		in_filter->SharpFilterOutput[i] = (int32_t)floor(in_filter->SharpFilterResult[history_length + i] + 0.5);
+
+	// last samples of the frame are the history of the next frame
+	memmove(in_filter->SharpFilterFrame, &in_filter->SharpFilterFrame[in_filter->SharpFilterHopLength], history_length * sizeof(double));
 }
-#undef Ntap
-#undef DCgain
 
 #if 0
 /**************************************************************
@@ -12,44 +12,35 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Includes
 #include <stdio.h>
+#include <string.h>
 #include "WaveLevelControl.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define WLC_X86_SIMD
+#include <emmintrin.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // Consts
-#define	LOOK_AHEAD_BUFFER_LENGTH  64
 #define INPUT_SAMPLE_AMPLITUDE 32000
 #define TARGET_SAMPLE_AMPLITUDE 32000
 #define HIGH_THRESHOLD 4096
 #define LOW_THRESHOLD 2
 #define NOISE_KILLER_SILENCE_MAX_LENGTH 5
+#define CLASSIFY_BLOCK_LENGTH 256			// number of samples classified at once by the vectorized pre-pass
+#define RECIPROCAL_SHIFT 32						// reciprocals are 2^RECIPROCAL_SHIFT / envelope
+#define RECIPROCAL_TABLE_LENGTH 65536		// reciprocals are stored for the envelopes below this value
+#define RECIPROCAL_MAX_SAMPLE (UINT32_MAX / TARGET_SAMPLE_AMPLITUDE)	// the reciprocal is exact when the dividend fits in 32 bit
 //#define DEBUG_CSV
 
-///////////////////////////////////////////////////////////////////////////////
-// Types
-typedef enum 
-{
-	SST_Unknown,
-	SST_Rising,
-	SST_Falling,
-	SST_Constant
-} SignalSlopeType;
-
 ///////////////////////////////////////////////////////////////////////////////
 // Module global variables
-static int32_t l_envelope[LOOK_AHEAD_BUFFER_LENGTH];
-static int32_t l_look_ahead_buffer[LOOK_AHEAD_BUFFER_LENGTH];
-static uint8_t l_look_ahead_buffer_index = 0;
-static uint8_t l_last_peak_index;
-static SignalSlopeType l_prev_slope;
-static int32_t l_prev_sample;
-static int32_t l_peak_threshold = 10;
-static WaveLevelControlModeType l_mode = WLCMT_NoiseKiller;
-static int32_t l_noise_killer_silence_length = 0;
-
 #ifdef DEBUG_CSV
 static int l_sample_counter;
 static FILE* l_debug_output;
 #endif
+static uint32_t l_reciprocals[RECIPROCAL_TABLE_LENGTH];		// reciprocal of the envelope values (shared by all contexts)
+static bool l_reciprocals_ready = false;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Global variables
@@ -57,29 +48,48 @@ uint8_t g_wave_level_control_mode = 1;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function prototypes
-static void DetectEnvelope(int32_t in_sample);
-static void CalculateEnvelope(int32_t in_peak_level, uint8_t in_peak_level_index);
+static void ClassifySamples(int32_t in_prev_sample, const int32_t* in_samples, size_t in_sample_count, uint8_t* out_slopes, int32_t* out_abs_samples);
+static void ProcessSample(WLCContextType* in_context, int32_t in_sample, WLCSlopeType in_slope, int32_t in_sample_abs, int32_t* out_sample, int32_t* out_envelope);
+static void ApplyGain(const int32_t* in_samples, const int32_t* in_envelopes, int32_t* out_samples, size_t in_sample_count);
+static int32_t ApplySampleGain(int32_t in_sample, int32_t in_envelope);
+static void InitReciprocals(void);
+static void DetectEnvelope(WLCContextType* in_context, int32_t in_sample, WLCSlopeType in_actual_slope, int32_t in_sample_abs);
+static void CalculateEnvelope(WLCContextType* in_context, int32_t in_peak_level, int in_peak_level_index);
 static int32_t SampleABS(int32_t in_value);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Initializes level control system
-void WLCInit(void)
+// (a new context must be zero initialized, the envelope is kept when an existing context is reinitialized)
+// The first call fills the shared reciprocal table, contexts must be initialized from one thread.
+void WLCInit(WLCContextType* in_context, int in_look_ahead_length)
 {
-	uint8_t i;
+	int i;
 
 	// initialize
-	for(i = 0;i < LOOK_AHEAD_BUFFER_LENGTH; i++)
+	if(in_look_ahead_length < 2)
+		in_look_ahead_length = 2;
+
+	if(in_look_ahead_length > WLC_MAX_LOOK_AHEAD_LENGTH)
+		in_look_ahead_length = WLC_MAX_LOOK_AHEAD_LENGTH;
+
+	in_context->LookAheadLength = in_look_ahead_length;
+
+	for(i = 0;i < WLC_MAX_LOOK_AHEAD_LENGTH; i++)
 	{
-		l_look_ahead_buffer[i] = 0;
+		in_context->LookAheadBuffer[i] = 0;
+		in_context->LookAheadBufferABS[i] = 0;
 	}
 
-	l_look_ahead_buffer_index = 0;
-	l_last_peak_index = 0;
+	in_context->LookAheadBufferIndex = 0;
+	in_context->LastPeakIndex = 0;
 
-	l_prev_slope = SST_Unknown;
-	l_prev_sample = 0;
+	in_context->PrevSlope = WLCST_Unknown;
+	in_context->PrevSample = 0;
 
-	l_mode = WLCMT_NoiseKiller;
+	in_context->Mode = WLCMT_NoiseKiller;
+	in_context->PeakThreshold = HIGH_THRESHOLD;
+
+	InitReciprocals();
 
 #ifdef DEBUG_CSV	
 	l_sample_counter = 0;
@@ -88,54 +98,48 @@ void WLCInit(void)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Process sampke (apply envelope control)
-int32_t WLCProcessSample(int32_t in_sample)
+// Process a block of samples (in_samples and out_samples may be the same buffer)
+void WLCProcessSamples(WLCContextType* in_context, const int32_t* in_samples, int32_t* out_samples, size_t in_sample_count)
 {
-	// get old sample
-	int32_t sample;
+	uint8_t slopes[CLASSIFY_BLOCK_LENGTH];
+	int32_t abs_samples[CLASSIFY_BLOCK_LENGTH];
+	int32_t delayed_samples[CLASSIFY_BLOCK_LENGTH];
+	int32_t envelopes[CLASSIFY_BLOCK_LENGTH];
+	size_t block_length;
+	size_t i;
 
 	if(g_wave_level_control_mode != 1)
-		return in_sample;
-
-#ifdef DEBUG_CSV
-	wchar_t buffer[1024];
+	{
+		if(in_samples != out_samples)
+			memcpy(out_samples, in_samples, in_sample_count * sizeof(int32_t));
 
-	l_sample_counter++;
-#endif
+		return;
+	}
 
-	// apply gain
-	sample = l_look_ahead_buffer[l_look_ahead_buffer_index];
-	if(l_envelope[l_look_ahead_buffer_index] == 0)
-		sample = 0;
-	else
-		sample = (int16_t)((int64_t)sample * TARGET_SAMPLE_AMPLITUDE / l_envelope[l_look_ahead_buffer_index]);
+	while(in_sample_count > 0)
+	{
+		block_length = in_sample_count;
+		if(block_length > CLASSIFY_BLOCK_LENGTH)
+			block_length = CLASSIFY_BLOCK_LENGTH;
 
-#ifdef DEBUG_CSV
-	sprintf(buffer,"%d;%d\n",l_look_ahead_buffer[l_look_ahead_buffer_index], l_envelope[l_look_ahead_buffer_index]);
-	fputs(buffer,l_debug_output);
-#endif
+		// slope and absolute value of all samples of the block are calculated in advance
+		ClassifySamples(in_context->PrevSample, in_samples, block_length, slopes, abs_samples);
 
-	// deteck and update peak value and sample gain multiplier
-	DetectEnvelope(in_sample);
+		// delayed samples leaving the look ahead buffer are collected with their envelope, then the gain is applied to the whole block
+		for(i = 0; i < block_length; i++)
+			ProcessSample(in_context, in_samples[i], (WLCSlopeType)slopes[i], abs_samples[i], &delayed_samples[i], &envelopes[i]);
 
-	// handle look ahead buffer
-	l_look_ahead_buffer[l_look_ahead_buffer_index] = in_sample;
+		ApplyGain(delayed_samples, envelopes, out_samples, block_length);
 
-	if(l_look_ahead_buffer_index >= LOOK_AHEAD_BUFFER_LENGTH - 1)
-	{
-		l_look_ahead_buffer_index = 0;
-	}
-	else
-	{
-		l_look_ahead_buffer_index++;
+		in_samples += block_length;
+		out_samples += block_length;
+		in_sample_count -= block_length;
 	}
-
-	return sample;
- }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // Closes level control
-void WLCClose(void)
+void WLCClose(WLCContextType* in_context)
 {
 #ifdef DEBUG_CSV
 	if(l_debug_output!=NULL)
@@ -145,20 +149,20 @@ void WLCClose(void)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Sets wave level control mode
-void WLCSetMode(WaveLevelControlModeType in_mode)
+void WLCSetMode(WLCContextType* in_context, WaveLevelControlModeType in_mode)
 {
 	// store mode
-	l_mode = in_mode;
+	in_context->Mode = in_mode;
 
 	// update peak threshold
 	switch (in_mode)
 	{
 		case WLCMT_LevelControl:
-			l_peak_threshold = LOW_THRESHOLD;
+			in_context->PeakThreshold = LOW_THRESHOLD;
 			break;
 
 		case WLCMT_NoiseKiller:
-			l_peak_threshold = HIGH_THRESHOLD;
+			in_context->PeakThreshold = HIGH_THRESHOLD;
 			break;
 	}
 }
@@ -168,61 +172,269 @@ void WLCSetMode(WaveLevelControlModeType in_mode)
 /*****************************************************************************/
 
 ///////////////////////////////////////////////////////////////////////////////
-// Detect envelope corner points
-static void DetectEnvelope(int32_t in_sample)
+// Calculates slope (compared to the previous sample) and absolute value of the samples
+static void ClassifySamples(int32_t in_prev_sample, const int32_t* in_samples, size_t in_sample_count, uint8_t* out_slopes, int32_t* out_abs_samples)
 {
-	uint8_t next_look_ahead_buffer_index;
-	SignalSlopeType actual_slope;
-	uint8_t peak_index;
-	int32_t peak_sample;
-	bool peak_found = false;
+	size_t i;
+	int32_t prev_sample = in_prev_sample;
+#ifdef WLC_X86_SIMD
+	__m128i current;
+	__m128i previous;
+	__m128i slope;
+	__m128i sign;
+	int32_t packed_slopes;
+#endif
 
-	// peak element index calculation
-	if(l_look_ahead_buffer_index == 0)
-		peak_index = LOOK_AHEAD_BUFFER_LENGTH - 1;
-	else
-		peak_index = l_look_ahead_buffer_index - 1;
+	i = 0;
+
+#ifdef WLC_X86_SIMD
+	// the first sample is compared to the last sample of the previous block, the rest is processed four at a time
+	if(in_sample_count > 4)
+	{
+		out_slopes[0] = (uint8_t)((prev_sample > in_samples[0]) ? WLCST_Falling : ((prev_sample < in_samples[0]) ? WLCST_Rising : WLCST_Constant));
+		out_abs_samples[0] = SampleABS(in_samples[0]);
+
+		for(i = 1; i + 4 <= in_sample_count; i += 4)
+		{
+			current = _mm_loadu_si128((const __m128i*)&in_samples[i]);
+			previous = _mm_loadu_si128((const __m128i*)&in_samples[i - 1]);
+
+			// constant (3) - 2 if rising - 1 if falling (compare results are -1)
+			slope = _mm_add_epi32(_mm_set1_epi32(WLCST_Constant), _mm_add_epi32(_mm_slli_epi32(_mm_cmpgt_epi32(current, previous), 1), _mm_cmpgt_epi32(previous, current)));
+			slope = _mm_packs_epi32(slope, slope);
+			slope = _mm_packus_epi16(slope, slope);
+			packed_slopes = _mm_cvtsi128_si32(slope);
+			memcpy(&out_slopes[i], &packed_slopes, sizeof(packed_slopes));
+
+			sign = _mm_srai_epi32(current, 31);
+			_mm_storeu_si128((__m128i*)&out_abs_samples[i], _mm_sub_epi32(_mm_xor_si128(current, sign), sign));
+		}
 
-	// current slope
-	actual_slope = SST_Constant;
-	if(l_prev_sample > in_sample)
+		prev_sample = in_samples[i - 1];
+	}
+#endif
+
+	for(; i < in_sample_count; i++)
 	{
-		actual_slope = SST_Falling;
+		if(prev_sample > in_samples[i])
+			out_slopes[i] = WLCST_Falling;
+		else
+			if(prev_sample < in_samples[i])
+				out_slopes[i] = WLCST_Rising;
+			else
+				out_slopes[i] = WLCST_Constant;
+
+		out_abs_samples[i] = SampleABS(in_samples[i]);
+		prev_sample = in_samples[i];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Process sample (returns the delayed sample and its envelope, updates envelope using the new sample)
+static void ProcessSample(WLCContextType* in_context, int32_t in_sample, WLCSlopeType in_slope, int32_t in_sample_abs, int32_t* out_sample, int32_t* out_envelope)
+{
+	int index = in_context->LookAheadBufferIndex;
+
+#ifdef DEBUG_CSV
+	wchar_t buffer[1024];
+
+	l_sample_counter++;
+#endif
+
+	// get old sample
+	*out_sample = in_context->LookAheadBuffer[index];
+	*out_envelope = in_context->Envelope[index];
+
+#ifdef DEBUG_CSV
+	sprintf(buffer,"%d;%d\n",in_context->LookAheadBuffer[index], in_context->Envelope[index]);
+	fputs(buffer,l_debug_output);
+#endif
+
+	// deteck and update peak value and sample gain multiplier
+	DetectEnvelope(in_context, in_sample, in_slope, in_sample_abs);
+
+	// handle look ahead buffer
+	in_context->LookAheadBuffer[index] = in_sample;
+	in_context->LookAheadBufferABS[index] = in_sample_abs;
+
+	if(index >= in_context->LookAheadLength - 1)
+	{
+		in_context->LookAheadBufferIndex = 0;
 	}
 	else
 	{
-		if(l_prev_sample < in_sample)
+		in_context->LookAheadBufferIndex++;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Applies gain to a block of samples: sample * TARGET_SAMPLE_AMPLITUDE / envelope truncated to 16 bit (0 if the envelope is zero)
+// Four samples are processed at once using the reciprocal of their envelope (see ApplySampleGain).
+static void ApplyGain(const int32_t* in_samples, const int32_t* in_envelopes, int32_t* out_samples, size_t in_sample_count)
+{
+	size_t i;
+#ifdef WLC_X86_SIMD
+	__m128i samples;
+	__m128i envelopes;
+	__m128i signs;
+	__m128i abs_samples;
+	__m128i reciprocals;
+	__m128i dividends;
+	__m128i even_quotients;
+	__m128i odd_quotients;
+	__m128i even_remainders;
+	__m128i odd_remainders;
+	__m128i result;
+	__m128i invalid;
+	__m128i one = _mm_set1_epi32(1);
+	__m128i low_mask = _mm_set_epi32(0, -1, 0, -1);
+	int32_t sample_values[4];
+	int32_t envelope_values[4];
+	uint32_t reciprocal_values[4];
+	int invalid_mask;
+	int lane;
+#endif
+
+	i = 0;
+
+#ifdef WLC_X86_SIMD
+	for(; i + 4 <= in_sample_count; i += 4)
+	{
+		samples = _mm_loadu_si128((const __m128i*)&in_samples[i]);
+		envelopes = _mm_loadu_si128((const __m128i*)&in_envelopes[i]);
+		_mm_storeu_si128((__m128i*)sample_values, samples);
+		_mm_storeu_si128((__m128i*)envelope_values, envelopes);
+
+		signs = _mm_srai_epi32(samples, 31);
+		abs_samples = _mm_sub_epi32(_mm_xor_si128(samples, signs), signs);
+
+		// envelopes and samples out of the range of the reciprocal table are handled by the scalar code
+		invalid = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(envelopes, one), _mm_cmplt_epi32(envelopes, _mm_setzero_si128())),
+			_mm_or_si128(_mm_cmpgt_epi32(envelopes, _mm_set1_epi32(RECIPROCAL_TABLE_LENGTH - 1)), _mm_cmpgt_epi32(abs_samples, _mm_set1_epi32(RECIPROCAL_MAX_SAMPLE))));
+		invalid = _mm_or_si128(invalid, _mm_cmplt_epi32(abs_samples, _mm_setzero_si128()));
+		invalid_mask = _mm_movemask_ps(_mm_castsi128_ps(invalid));
+
+		for(lane = 0; lane < 4; lane++)
+			reciprocal_values[lane] = l_reciprocals[envelope_values[lane] & (RECIPROCAL_TABLE_LENGTH - 1)];
+		reciprocals = _mm_loadu_si128((const __m128i*)reciprocal_values);
+
+		// dividends fit in 32 bit, the quotient estimate is the high half of the dividend * reciprocal product
+		dividends = _mm_or_si128(_mm_and_si128(_mm_mul_epu32(abs_samples, _mm_set1_epi32(TARGET_SAMPLE_AMPLITUDE)), low_mask), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(abs_samples, 32), _mm_set1_epi32(TARGET_SAMPLE_AMPLITUDE)), 32));
+		even_quotients = _mm_srli_epi64(_mm_mul_epu32(dividends, reciprocals), 32);
+		odd_quotients = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(dividends, 32), _mm_srli_epi64(reciprocals, 32)), 32);
+
+		// remainders are below two times the envelope, the estimate is corrected when the remainder is not less than the envelope
+		even_remainders = _mm_sub_epi32(dividends, _mm_mul_epu32(even_quotients, envelopes));
+		odd_remainders = _mm_sub_epi32(_mm_srli_epi64(dividends, 32), _mm_mul_epu32(odd_quotients, _mm_srli_epi64(envelopes, 32)));
+		result = _mm_or_si128(_mm_and_si128(even_quotients, low_mask), _mm_slli_epi64(odd_quotients, 32));
+		result = _mm_add_epi32(result, _mm_andnot_si128(_mm_cmpgt_epi32(envelopes, _mm_or_si128(_mm_and_si128(even_remainders, low_mask), _mm_slli_epi64(odd_remainders, 32))), one));
+
+		// sign of the sample, zero envelope and truncation to 16 bit
+		result = _mm_sub_epi32(_mm_xor_si128(result, signs), signs);
+		result = _mm_andnot_si128(_mm_cmpeq_epi32(envelopes, _mm_setzero_si128()), result);
+		result = _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+
+		_mm_storeu_si128((__m128i*)&out_samples[i], result);
+
+		// input may be overwritten by the output
+		if(invalid_mask != 0)
 		{
-			actual_slope = SST_Rising;
+			for(lane = 0; lane < 4; lane++)
+			{
+				if((invalid_mask & (1 << lane)) != 0)
+					out_samples[i + lane] = ApplySampleGain(sample_values[lane], envelope_values[lane]);
+			}
 		}
 	}
+#endif
+
+	for(; i < in_sample_count; i++)
+		out_samples[i] = ApplySampleGain(in_samples[i], in_envelopes[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Applies gain to one sample. The quotient is calculated by multiplying with the reciprocal of the envelope, the
+// estimate is at most one less than the exact quotient and it is corrected by one step. Envelopes and samples out of
+// the range of the reciprocal table are divided.
+static int32_t ApplySampleGain(int32_t in_sample, int32_t in_envelope)
+{
+	uint64_t dividend;
+	uint32_t quotient;
+
+	if(in_envelope == 0)
+		return 0;
+
+	if(in_envelope < 2 || in_envelope >= RECIPROCAL_TABLE_LENGTH || in_sample == INT32_MIN || SampleABS(in_sample) > RECIPROCAL_MAX_SAMPLE)
+		return (int16_t)((int64_t)in_sample * TARGET_SAMPLE_AMPLITUDE / in_envelope);
+
+	dividend = (uint64_t)SampleABS(in_sample) * TARGET_SAMPLE_AMPLITUDE;
+	quotient = (uint32_t)((dividend * l_reciprocals[in_envelope]) >> RECIPROCAL_SHIFT);
+	if((uint64_t)(quotient + 1) * (uint32_t)in_envelope <= dividend)
+		quotient++;
+
+	if(in_sample < 0)
+		return (int16_t)(-(int32_t)quotient);
+	else
+		return (int16_t)quotient;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fills the reciprocal table used by the gain calculation (only once, the table is shared by all contexts)
+static void InitReciprocals(void)
+{
+	uint32_t envelope;
+
+	if(l_reciprocals_ready)
+		return;
+
+	for(envelope = 2; envelope < RECIPROCAL_TABLE_LENGTH; envelope++)
+		l_reciprocals[envelope] = (uint32_t)(((uint64_t)1 << RECIPROCAL_SHIFT) / envelope);
+
+	l_reciprocals_ready = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Detect envelope corner points
+static void DetectEnvelope(WLCContextType* in_context, int32_t in_sample, WLCSlopeType in_actual_slope, int32_t in_sample_abs)
+{
+	int next_look_ahead_buffer_index;
+	int peak_index;
+	int32_t prev_sample = in_context->PrevSample;
+	int32_t peak_sample;
+	bool peak_found = false;
+
+	// peak element index calculation
+	if(in_context->LookAheadBufferIndex == 0)
+		peak_index = in_context->LookAheadLength - 1;
+	else
+		peak_index = in_context->LookAheadBufferIndex - 1;
 
 	// check for positive peak
-	if(l_prev_sample > 0 && l_prev_slope == SST_Rising && actual_slope == SST_Falling && l_prev_sample > l_peak_threshold)
+	if(prev_sample > 0 && in_context->PrevSlope == WLCST_Rising && in_actual_slope == WLCST_Falling && prev_sample > in_context->PeakThreshold)
 	{
 		peak_found = true;
-		peak_sample = l_prev_sample;
+		peak_sample = prev_sample;
 	}
 
 	// check for negative peak
-	if(l_prev_sample < 0 && l_prev_slope == SST_Falling && actual_slope == SST_Rising && -l_prev_sample > l_peak_threshold)
+	if(prev_sample < 0 && in_context->PrevSlope == WLCST_Falling && in_actual_slope == WLCST_Rising && -prev_sample > in_context->PeakThreshold)
 	{
 		peak_found = true;
-		peak_sample = -l_prev_sample;
+		peak_sample = -prev_sample;
 	}
 
 	// check operation mode
-	switch (l_mode)
+	switch (in_context->Mode)
 	{
 		// automatic level control mode
 		case WLCMT_LevelControl:
 			if(peak_found)
 			{
 				// generate envelope
-				CalculateEnvelope(peak_sample, peak_index);
+				CalculateEnvelope(in_context, peak_sample, peak_index);
 
 				// store peak position
-				l_last_peak_index = peak_index;
+				in_context->LastPeakIndex = peak_index;
 			}
 			break;
 
@@ -231,34 +443,34 @@ static void DetectEnvelope(int32_t in_sample)
 		{
 			if(peak_found)
 			{
-				if(peak_sample < l_peak_threshold)
+				if(peak_sample < in_context->PeakThreshold)
 					peak_sample = 0;
 				else
 				{
 					if(peak_sample < INPUT_SAMPLE_AMPLITUDE)
 						peak_sample = INPUT_SAMPLE_AMPLITUDE;
 
-					l_noise_killer_silence_length = 0;
+					in_context->NoiseKillerSilenceLength = 0;
 				}
 
-				CalculateEnvelope(peak_sample, peak_index);
-				l_last_peak_index = peak_index;
+				CalculateEnvelope(in_context, peak_sample, peak_index);
+				in_context->LastPeakIndex = peak_index;
 			}
 			else
 			{
-				if( SampleABS(in_sample) < l_peak_threshold)
+				if(in_sample_abs < in_context->PeakThreshold)
 				{
-					l_noise_killer_silence_length++;
-					if(l_noise_killer_silence_length == NOISE_KILLER_SILENCE_MAX_LENGTH)
+					in_context->NoiseKillerSilenceLength++;
+					if(in_context->NoiseKillerSilenceLength == NOISE_KILLER_SILENCE_MAX_LENGTH)
 					{
-						CalculateEnvelope(0, peak_index);
-						l_last_peak_index = peak_index;
+						CalculateEnvelope(in_context, 0, peak_index);
+						in_context->LastPeakIndex = peak_index;
 					}
 
-					if(l_noise_killer_silence_length > NOISE_KILLER_SILENCE_MAX_LENGTH)
+					if(in_context->NoiseKillerSilenceLength > NOISE_KILLER_SILENCE_MAX_LENGTH)
 					{
-						l_envelope[peak_index] = 0;
-						l_last_peak_index = peak_index;
+						in_context->Envelope[peak_index] = 0;
+						in_context->LastPeakIndex = peak_index;
 					}
 				}
 			}
@@ -267,68 +479,89 @@ static void DetectEnvelope(int32_t in_sample)
 	}
 
 	// calculate next index in the look ahead buffer
-	next_look_ahead_buffer_index = l_look_ahead_buffer_index + 1;
-	if(next_look_ahead_buffer_index >= LOOK_AHEAD_BUFFER_LENGTH)
+	next_look_ahead_buffer_index = in_context->LookAheadBufferIndex + 1;
+	if(next_look_ahead_buffer_index >= in_context->LookAheadLength)
 		next_look_ahead_buffer_index = 0;
 
 	// if there was no peak	for a while
-	if(l_last_peak_index == next_look_ahead_buffer_index)
+	if(in_context->LastPeakIndex == next_look_ahead_buffer_index)
 	{
 		// set gain to zero
-		CalculateEnvelope(0, peak_index);
+		CalculateEnvelope(in_context, 0, peak_index);
 
 		// store peak position
-		l_last_peak_index = peak_index;
+		in_context->LastPeakIndex = peak_index;
 	}
 
 	// update prev state
-	l_prev_sample = in_sample;
-	if(actual_slope == SST_Rising || actual_slope == SST_Falling)
-		l_prev_slope = actual_slope;
+	in_context->PrevSample = in_sample;
+	if(in_actual_slope == WLCST_Rising || in_actual_slope == WLCST_Falling)
+		in_context->PrevSlope = in_actual_slope;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Generates envelope values using linear interpolation between corner points
-static void CalculateEnvelope(int32_t in_peak_level, uint8_t in_peak_level_index)
+// The ramp is stepped by the quotient and remainder of the level difference divided by the step count, which gives
+// the same values as dividing at every step.
+static void CalculateEnvelope(WLCContextType* in_context, int32_t in_peak_level, int in_peak_level_index)
 {
-	uint8_t envelope_step_count;
-	uint8_t envelope_step_index;
-	uint8_t envelope_index;
+	int envelope_step_count;
+	int envelope_index;
 	int32_t start_peak_level;
+	int32_t level_difference;
+	int32_t step_quotient;
+	int32_t step_remainder;
+	int32_t ramp_quotient;
+	int32_t ramp_remainder;
+	int32_t carry;
 	int32_t envelope;
 	int32_t sample_abs;
+	int last_peak_index = in_context->LastPeakIndex;
 
 	// number of envelope steps
-	if(l_last_peak_index < in_peak_level_index)
-		envelope_step_count = in_peak_level_index - l_last_peak_index;
+	if(last_peak_index < in_peak_level_index)
+		envelope_step_count = in_peak_level_index - last_peak_index;
 	else
-		envelope_step_count = LOOK_AHEAD_BUFFER_LENGTH - l_last_peak_index + in_peak_level_index;
+		envelope_step_count = in_context->LookAheadLength - last_peak_index + in_peak_level_index;
 
 	// calculate envelope values (envelope ramp)
-	envelope_index = l_last_peak_index;
-	envelope_step_index = 0;
-	start_peak_level = l_envelope[l_last_peak_index];
+	envelope_index = last_peak_index;
+	start_peak_level = in_context->Envelope[last_peak_index];
 	if(start_peak_level == 0)
 		start_peak_level = 32767;
 
+	level_difference = in_peak_level - start_peak_level;
+	step_quotient = SampleABS(level_difference) / envelope_step_count;
+	step_remainder = SampleABS(level_difference) % envelope_step_count;
+	ramp_quotient = 0;
+	ramp_remainder = 0;
+
 	while(envelope_index != in_peak_level_index)
 	{
-		envelope = (int32_t)start_peak_level + (in_peak_level - start_peak_level) * envelope_step_index / envelope_step_count;
-		sample_abs = SampleABS(l_look_ahead_buffer[envelope_index]);
+		if(level_difference < 0)
+			envelope = start_peak_level - ramp_quotient;
+		else
+			envelope = start_peak_level + ramp_quotient;
+
+		sample_abs = in_context->LookAheadBufferABS[envelope_index];
 
-		if(sample_abs > l_peak_threshold && envelope < sample_abs)
+		if(sample_abs > in_context->PeakThreshold && envelope < sample_abs)
 			envelope = sample_abs;
 
-		l_envelope[envelope_index] = envelope;
+		in_context->Envelope[envelope_index] = envelope;
 
 		envelope_index++;
-		if(envelope_index >= LOOK_AHEAD_BUFFER_LENGTH)
+		if(envelope_index >= in_context->LookAheadLength)
 			envelope_index = 0;
 
-		envelope_step_index++;
+		// next ramp step (carry of the remainder is added without branching as it is unpredictable)
+		ramp_remainder += step_remainder;
+		carry = (ramp_remainder >= envelope_step_count) ? 1 : 0;
+		ramp_quotient += step_quotient + carry;
+		ramp_remainder -= carry * envelope_step_count;
 	}
 
-	l_envelope[envelope_index] = in_peak_level;
+	in_context->Envelope[envelope_index] = in_peak_level;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
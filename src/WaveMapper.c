@@ -56,6 +56,38 @@ bool WMReadSample(int32_t* out_sample)
 	return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Reads block of samples, returns the number of samples read
+size_t WMReadSamples(int32_t* out_samples, size_t in_sample_count)
+{
+	switch(g_input_file_type)
+	{
+		// open wave input
+		case FT_WaveInOut:
+			return WDReadSamples(out_samples, in_sample_count);
+
+		// open wave file
+		case FT_WAV:
+			return WFReadSamples(out_samples, in_sample_count);
+	}
+
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Moves the read position to the given sample index (only wave files can be positioned)
+bool WMSeekInput(uint32_t in_sample_index)
+{
+	switch(g_input_file_type)
+	{
+		// open wave file
+		case FT_WAV:
+			return WFSeekInput(in_sample_index);
+	}
+
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave input
 void WMCloseInput(void)
@@ -90,13 +122,28 @@ bool WMOpenOutput(wchar_t* in_file_name)
 
 		// create wave file
 		case FT_WAV:
-			return WFOpenOutput(in_file_name, g_one_bit_wave_file ? 1 : 8);
+			return WFOpenOutput(in_file_name, g_one_bit_wave_file ? 1 : g_wave_bits_per_sample, g_wave_sample_rate);
 
 		default:
 			return false;
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Reserves space for the given number of samples (only wave files are preallocated)
+bool WMReserveOutput(uint32_t in_sample_count)
+{
+	switch(g_output_file_type)
+	{
+		// create wave file
+		case FT_WAV:
+			return WFReserveOutput(in_sample_count);
+
+		default:
+			return true;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Write output sample
 bool WMWriteSample(uint8_t in_sample)
@@ -116,6 +163,40 @@ bool WMWriteSample(uint8_t in_sample)
 	return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of samples to the wave output
+bool WMWriteSamples(const uint8_t* in_samples, size_t in_sample_count)
+{
+	switch(g_output_file_type)
+	{
+		// wave output
+		case FT_WaveInOut:
+			return WDWriteSamples(in_samples, in_sample_count);
+
+		// wave file
+		case FT_WAV:
+			WFWriteByteSamples(in_samples, in_sample_count);
+			return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Writes a block of 16 bit samples to the wave output (only 16 bit wave files are supported)
+bool WMWriteWordSamples(const int16_t* in_samples, size_t in_sample_count)
+{
+	switch(g_output_file_type)
+	{
+		// wave file
+		case FT_WAV:
+			WFWriteWordSamples(in_samples, in_sample_count);
+			return true;
+	}
+
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Closes wave output
 void WMCloseOutput(bool in_force_close)